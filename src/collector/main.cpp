@@ -23,19 +23,94 @@
 #include <fstream>
 #endif // HAS_CAPTURE
 #include "logger.h"
+#include "sfbench.h"
 #include "sysflow_config.h"
 #include "sysflowlibs.hpp"
 #include "utils.h"
 #include <csignal>
 #include <cstdio>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <unistd.h>
+#ifdef SF_BENCH
+#include <atomic>
+#include <fstream>
+#include <new>
+#include <sys/resource.h>
+#endif
 
 SysFlowConfig *g_config;
 sysflowlibscpp::SysFlowDriver *g_driver;
 void signal_handler(int /*i*/) { g_driver->exit(); }
 
+#ifdef SF_BENCH
+// count heap allocations so that the benchmark can report allocations/event
+static std::atomic<uint64_t> g_numAllocs{0};
+
+void *operator new(std::size_t size) {
+  g_numAllocs.fetch_add(1, std::memory_order_relaxed);
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+static int writeBenchReport(const std::string &path, uint64_t wallNs,
+                            uint64_t numAllocs) {
+  const sfbench::BenchStats &stats = sfbench::g_stats;
+  struct rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  double wallSec = wallNs / 1e9;
+  uint64_t loopNs = stats.stageNs[sfbench::StageNext] +
+                    stats.stageNs[sfbench::StageDispatch];
+  uint64_t writerNs = stats.stageNs[sfbench::StageEncode] +
+                      stats.stageNs[sfbench::StageCompress];
+  uint64_t dispatchNs = stats.stageNs[sfbench::StageDispatch];
+  // writer time is nested in the dispatch stage
+  dispatchNs = (dispatchNs > writerNs) ? dispatchNs - writerNs : 0;
+  auto share = [loopNs](uint64_t ns) {
+    return (loopNs > 0) ? static_cast<double>(ns) / loopNs : 0.0;
+  };
+
+  std::ofstream out(path);
+  if (!out.is_open()) {
+    std::cerr << "Unable to open benchmark report file " << path << std::endl;
+    return -1;
+  }
+  out << "{\n"
+      << "  \"trace\": \"" << g_config->scapInputPath << "\",\n"
+      << "  \"wall_sec\": " << wallSec << ",\n"
+      << "  \"events\": " << stats.numEvents << ",\n"
+      << "  \"records\": " << stats.numRecords << ",\n"
+      << "  \"events_per_sec\": "
+      << ((wallSec > 0) ? stats.numEvents / wallSec : 0) << ",\n"
+      << "  \"records_per_sec\": "
+      << ((wallSec > 0) ? stats.numRecords / wallSec : 0) << ",\n"
+      << "  \"peak_rss_kb\": " << usage.ru_maxrss << ",\n"
+      << "  \"allocations\": " << numAllocs << ",\n"
+      << "  \"allocs_per_event\": "
+      << ((stats.numEvents > 0)
+              ? static_cast<double>(numAllocs) / stats.numEvents
+              : 0)
+      << ",\n"
+      << "  \"stage_share\": {\n"
+      << "    \"next\": " << share(stats.stageNs[sfbench::StageNext]) << ",\n"
+      << "    \"dispatch\": " << share(dispatchNs) << ",\n"
+      << "    \"encode\": " << share(stats.stageNs[sfbench::StageEncode])
+      << ",\n"
+      << "    \"compress\": " << share(stats.stageNs[sfbench::StageCompress])
+      << "\n"
+      << "  }\n"
+      << "}" << std::endl;
+  return 0;
+}
+#endif
+
 int str2int(int &i, char const *s, int base = 0) {
   char *end;
   long l;
@@ -54,6 +129,133 @@ int str2int(int &i, char const *s, int base = 0) {
   return 0;
 }
 
+// parses a comma separated list of table options: proc=<n>, cont=<n>,
+// pod=<n>, file=<n>, flow=<n>, load=<factor>, shrink and auto
+static int parseTableOptions(const std::string &spec) {
+  std::istringstream in(spec);
+  std::string opt;
+  while (std::getline(in, opt, ',')) {
+    std::string key = opt.substr(0, opt.find('='));
+    std::string val =
+        (opt.find('=') != std::string::npos) ? opt.substr(key.size() + 1) : "";
+    int *size = nullptr;
+    if (key == "proc") {
+      size = &g_config->procTableSize;
+    } else if (key == "cont") {
+      size = &g_config->contTableSize;
+    } else if (key == "pod") {
+      size = &g_config->podTableSize;
+    } else if (key == "file") {
+      size = &g_config->fileTableSize;
+    } else if (key == "flow") {
+      size = &g_config->flowTableSize;
+    }
+    if (size != nullptr) {
+      if (str2int(*size, val.c_str(), 10) || *size < 0) {
+        return -1;
+      }
+    } else if (key == "load") {
+      char *end;
+      g_config->tableMaxLoad = strtof(val.c_str(), &end);
+      if (val.empty() || *end != '\0') {
+        return -1;
+      }
+    } else if (key == "shrink" && val.empty()) {
+      g_config->shrinkTables = true;
+    } else if (key == "auto" && val.empty()) {
+      g_config->autoSizeTables = true;
+    } else {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// parses an export policy (full, keepalive, heartbeat or suppress) with an
+// optional keep-alive count after a colon
+static int parseExportPolicy(const std::string &spec, SFExportPolicy &policy,
+                             int &keepAlive) {
+  std::string name = spec.substr(0, spec.find(':'));
+  if (name == "full") {
+    policy = SFExportPolicy::SFExportFull;
+  } else if (name == "keepalive") {
+    policy = SFExportPolicy::SFExportKeepAlive;
+  } else if (name == "heartbeat") {
+    policy = SFExportPolicy::SFExportHeartbeat;
+  } else if (name == "suppress") {
+    policy = SFExportPolicy::SFExportSuppress;
+  } else {
+    return -1;
+  }
+  if (name.size() < spec.size()) {
+    std::string val = spec.substr(name.size() + 1);
+    if (str2int(keepAlive, val.c_str(), 10) || keepAlive <= 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// parses a comma separated list of flow export options:
+// net=<policy>[:<n>], file=<policy>[:<n>], export=<secs> and expire=<secs>
+static int parseExportOptions(const std::string &spec) {
+  std::istringstream in(spec);
+  std::string opt;
+  while (std::getline(in, opt, ',')) {
+    std::string key = opt.substr(0, opt.find('='));
+    std::string val =
+        (opt.find('=') != std::string::npos) ? opt.substr(key.size() + 1) : "";
+    if (key == "net") {
+      if (parseExportPolicy(val, g_config->netFlowExport,
+                            g_config->netFlowKeepAlive)) {
+        return -1;
+      }
+    } else if (key == "file") {
+      if (parseExportPolicy(val, g_config->fileFlowExport,
+                            g_config->fileFlowKeepAlive)) {
+        return -1;
+      }
+    } else if (key == "export") {
+      if (str2int(g_config->flowExportInterval, val.c_str(), 10) ||
+          g_config->flowExportInterval <= 0) {
+        return -1;
+      }
+    } else if (key == "expire") {
+      if (str2int(g_config->flowExpireInterval, val.c_str(), 10) ||
+          g_config->flowExpireInterval <= 0) {
+        return -1;
+      }
+    } else {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// parses rate limit options: <events/s>[,<burst>][,container]
+static int parseRateLimit(const std::string &spec) {
+  std::istringstream in(spec);
+  std::string opt;
+  int i = 0;
+  while (std::getline(in, opt, ',')) {
+    if (i == 0) {
+      if (str2int(g_config->rateLimit, opt.c_str(), 10) ||
+          g_config->rateLimit <= 0) {
+        return -1;
+      }
+    } else if (opt == "container") {
+      g_config->rateLimitScope = SFRateLimitScope::SFRateLimitContainer;
+    } else if (opt == "process") {
+      g_config->rateLimitScope = SFRateLimitScope::SFRateLimitProcess;
+    } else if (i > 1 || str2int(g_config->rateLimitBurst, opt.c_str(), 10) ||
+               g_config->rateLimitBurst <= 0) {
+      return -1;
+    }
+    i++;
+  }
+  return (i == 0) ? -1 : 0;
+}
+
 static void usage(const std::string &name) {
   std::cerr
       << "Usage: " << name << " [options] {-u|-w} <path>\n"
@@ -91,6 +293,61 @@ static void usage(const std::string &name) {
       << "\t-k driver type\t\tThe driver type to load. Can be ebpf, ebpf-core, "
          "or kmod\n"
       << "\t-d\t\t\tPrint debug stats (not debug logging) of all caches\n"
+      << "\t-x drop filter file\tPath to a rules file of events to drop "
+         "before processing (one '<exe|container|path|port|uid> <value>' "
+         "rule per line)\n"
+      << "\t-A max sampling ratio\tAdapt the sampling ratio of dropping mode "
+         "between -s and this ratio to the drop rate and processing lag "
+         "(powers of 2 up to 128)\n"
+      << "\t-T table options\tComma separated table sizing options: initial "
+         "capacities (proc=<n>, cont=<n>, pod=<n>, file=<n>, flow=<n>), max "
+         "load factor (load=<0.1-0.95>), shrink (compact tables after "
+         "rotations) and auto (size tables from /proc at startup)\n"
+      << "\t-a flow aggregation\tAggregate network flows per thread "
+         "(default), socket (merge threads sharing a socket) or process "
+         "(merge all sockets of a process with the same endpoints)\n"
+      << "\t-N max summaries\tFold completed network flows of a process to "
+         "the same destination ip, port and protocol into one summary per "
+         "export interval, up to the given number of summaries. An optional "
+         "per process limit follows a comma (e.g., 10000,100)\n"
+      << "\t-F max coalesced\tMerge completed file flows of a process on "
+         "the same file and open flags into one flow per export interval, up "
+         "to the given number of files per process\n"
+      << "\t-I\t\t\tDeduplicate mmap file flows: write the first map of "
+         "each file per output file, and only count later maps\n"
+      << "\t-C fork threshold\tChildren per parent per second above which "
+         "the clone, exec and exit events of new children are counted in fork "
+         "summary records of the parent\n"
+      << "\t-E export options\tComma separated flow export options: "
+         "net=<policy>[:<n>], file=<policy>[:<n>], export=<secs> (default "
+         "30) and expire=<secs> (default 60). A policy is one of full "
+         "(default), keepalive (a record every n export intervals, default "
+         "4), heartbeat (records without capabilities) or suppress (no "
+         "records for idle intervals)\n"
+      << "\t-R\t\t\tWrite per container (and per pod, with k8s) rollups of "
+         "network and file I/O and process activity every export interval, as "
+         "summary records\n"
+      << "\t-H k[,records]\t\tTrack the top k files, destination endpoints, "
+         "executables and containers by events per export interval, exported "
+         "as metrics and logged with drop filter suggestions. With ,records "
+         "they are also written as summary records\n"
+      << "\t-Y\t\t\tEstimate the distinct remote IPs, remote ports and file "
+         "paths of each process (and container, with -R), written as summary "
+         "records when they change\n"
+      << "\t-L rate[,burst][,container]\tSuppress data events of a process "
+         "(or of all processes of a container) beyond rate events per second "
+         "with bursts of up to burst events (default rate). Open, "
+         "accept, connect, close and shutdown events are never suppressed. "
+         "Suppressed events are counted in summary records\n"
+      << "\t-M metrics file\t\tPeriodically rewrite the given file with "
+         "collector metrics in Prometheus text format (e.g., for the node "
+         "exporter textfile collector)\n"
+      << "\t-S summary file\t\tWrite summary records (JSON lines) to the "
+         "given file instead of next to the output file (-w). Required for "
+         "summaries with socket output\n"
+      << "\t-j bench report file\tWrite a JSON benchmark report (events/s, "
+         "records/s, peak RSS, allocations and stage breakdown) on exit. "
+         "Requires a build with BENCH=1\n"
       << "\t-v\t\t\tPrint the version of " << name << " and exit.\n"
       << std::endl;
 }
@@ -118,13 +375,16 @@ int main(int argc, char **argv) {
   bool breakout = false;
   DriverType driver = NO_DRIVER;
   std::string logProps;
+  std::string benchFile;
 
   sigaction(SIGINT, &sigHandler, nullptr);
   sigaction(SIGTERM, &sigHandler, nullptr);
 
   g_config = sysflowlibscpp::InitializeSysFlowConfig();
   while ((c = static_cast<char>(
-              getopt(argc, argv, "hcr:w:G:s:e:l:vf:p:t:du:m:k:"))) != -1) {
+              getopt(argc, argv,
+                     "hcr:w:G:s:e:l:vf:p:t:du:m:k:x:j:M:A:T:"
+                     "a:N:F:IC:E:RH:YL:S:"))) != -1) {
     switch (c) {
     case 'm':
       if (strcmp(optarg, "consume") == 0) {
@@ -198,6 +458,115 @@ int main(int argc, char **argv) {
     case 'p':
       g_config->criPath = optarg;
       break;
+    case 'x':
+      g_config->dropFilterPath = optarg;
+      break;
+    case 'A':
+      if (str2int(g_config->maxSamplingRatio, optarg, 10)) {
+        std::cout << "Unable to parse max sampling ratio " << optarg
+                  << std::endl;
+        exit(1);
+      }
+      break;
+    case 'M':
+      g_config->metricsFile = optarg;
+      break;
+    case 'S':
+      g_config->summaryFile = optarg;
+      break;
+    case 'T':
+      if (parseTableOptions(optarg)) {
+        std::cout << "Unable to parse table options " << optarg << std::endl;
+        exit(1);
+      }
+      break;
+    case 'a':
+      if (strcasecmp(optarg, "thread") == 0) {
+        g_config->flowAggregation = SFFlowAggregation::SFThreadFlows;
+      } else if (strcasecmp(optarg, "socket") == 0) {
+        g_config->flowAggregation = SFFlowAggregation::SFSocketFlows;
+      } else if (strcasecmp(optarg, "process") == 0) {
+        g_config->flowAggregation = SFFlowAggregation::SFProcessFlows;
+      } else {
+        std::cout << "-a must be set to one of thread, socket, or process"
+                  << std::endl;
+        exit(1);
+      }
+      break;
+    case 'N': {
+      std::string limits(optarg);
+      std::string perProc = (limits.find(',') != std::string::npos)
+                                ? limits.substr(limits.find(',') + 1)
+                                : "0";
+      limits = limits.substr(0, limits.find(','));
+      if (str2int(g_config->connSummaryMaxKeys, limits.c_str(), 10) ||
+          str2int(g_config->connSummaryMaxPerProc, perProc.c_str(), 10)) {
+        std::cout << "Unable to parse connection summary limits " << optarg
+                  << std::endl;
+        exit(1);
+      }
+      break;
+    }
+    case 'F':
+      if (str2int(g_config->fileCoalesceMax, optarg, 10)) {
+        std::cout << "Unable to parse file coalescing limit " << optarg
+                  << std::endl;
+        exit(1);
+      }
+      break;
+    case 'I':
+      g_config->mmapDedup = true;
+      break;
+    case 'C':
+      if (str2int(g_config->forkStormThreshold, optarg, 10)) {
+        std::cout << "Unable to parse fork storm threshold " << optarg
+                  << std::endl;
+        exit(1);
+      }
+      break;
+    case 'E':
+      if (parseExportOptions(optarg)) {
+        std::cout << "Unable to parse export options " << optarg << std::endl;
+        exit(1);
+      }
+      break;
+    case 'R':
+      g_config->containerRollup = true;
+      break;
+    case 'Y':
+      g_config->fanOut = true;
+      break;
+    case 'H': {
+      std::string k(optarg);
+      std::string records = (k.find(',') != std::string::npos)
+                                ? k.substr(k.find(',') + 1)
+                                : "";
+      k = k.substr(0, k.find(','));
+      if (str2int(g_config->heavyHitterK, k.c_str(), 10) ||
+          (!records.empty() && records != "records")) {
+        std::cout << "Unable to parse heavy hitter options " << optarg
+                  << std::endl;
+        exit(1);
+      }
+      g_config->heavyHitterRecords = !records.empty();
+      break;
+    }
+    case 'L':
+      if (parseRateLimit(optarg)) {
+        std::cout << "Unable to parse rate limit options " << optarg
+                  << std::endl;
+        exit(1);
+      }
+      break;
+    case 'j':
+#ifdef SF_BENCH
+      benchFile = optarg;
+#else
+      std::cout << "Benchmark reports require a build with BENCH=1"
+                << std::endl;
+      exit(1);
+#endif
+      break;
     case 'k':
       if (strcasecmp(optarg, "ebpf") == 0) {
         driver = EBPF;
@@ -231,7 +600,11 @@ int main(int argc, char **argv) {
     case '?':
       if (optopt == 'r' || optopt == 's' || optopt == 'f' || optopt == 'w' ||
           optopt == 'u' || optopt == 'G' || optopt == 'l' || optopt == 'p' ||
-          optopt == 't' || optopt == 'k') {
+          optopt == 't' || optopt == 'k' || optopt == 'x' || optopt == 'j' ||
+          optopt == 'M' || optopt == 'A' || optopt == 'T' ||
+          optopt == 'a' || optopt == 'N' || optopt == 'F' ||
+          optopt == 'C' || optopt == 'E' || optopt == 'H' ||
+          optopt == 'L') {
         fprintf(stderr, "Option -%c requires an argument.\n", optopt);
       } else if (isprint(optopt)) {
         fprintf(stderr, "Unknown option `-%c'.\n", optopt);
@@ -274,8 +647,22 @@ int main(int argc, char **argv) {
     g_config->appName = std::string(argv[0]);
     g_driver = new sysflowlibscpp::SysFlowDriver(g_config);
     SF_INFO(logger, "Starting the SysFlow Collector...");
+#ifdef SF_BENCH
+    uint64_t allocs = g_numAllocs.load();
+    uint64_t start = sfbench::getTimeNs();
+#endif
     int ret = g_driver->run();
+#ifdef SF_BENCH
+    uint64_t wallNs = sfbench::getTimeNs() - start;
+    allocs = g_numAllocs.load() - allocs;
+#endif
     delete g_driver;
+#ifdef SF_BENCH
+    if (!benchFile.empty() &&
+        writeBenchReport(benchFile, wallNs, allocs) != 0) {
+      return 1;
+    }
+#endif
     return ret;
   } catch (sfexception::SysFlowException &ex) {
     SF_ERROR(logger, "Runtime exception caught in main loop: "
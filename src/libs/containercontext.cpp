@@ -18,30 +18,72 @@
  **/
 
 #include "containercontext.h"
+#include "sfmetrics.h"
+#include "utils.h"
+#include <algorithm>
+#include <map>
 
 using container::ContainerContext;
 using sysflow::ContainerType;
 
 void ContainerContext::setContainer(ContainerObj **cont,
-                                    sinsp_container_info::ptr_t container) {
-  SF_DEBUG(m_logger, "Setting container info. Name: " << container->m_name)
-  (*cont)->cont.name = container->m_name;
-  (*cont)->cont.image = container->m_image + ":" + container->m_imagetag;
-  (*cont)->cont.id = container->m_id;
-  (*cont)->cont.imageid = container->m_imageid;
-  (*cont)->cont.type = static_cast<ContainerType>(container->m_type);
-  (*cont)->cont.privileged = container->m_privileged;
+                                    const sinsp_container_info &container) {
+  SF_DEBUG(m_logger, "Setting container info. Name: " << container.m_name)
+  (*cont)->cont.name = container.m_name;
+  (*cont)->cont.image = container.m_image + ":" + container.m_imagetag;
+  (*cont)->cont.id = container.m_id;
+  (*cont)->cont.imageid = container.m_imageid;
+  (*cont)->cont.type = static_cast<ContainerType>(container.m_type);
+  (*cont)->cont.privileged = container.m_privileged;
+}
+
+bool ContainerContext::isIncomplete(const sinsp_container_info &container) {
+  return container.m_name.compare(INCOMPLETE) == 0 ||
+         container.m_image.compare(INCOMPLETE) == 0;
+}
+
+void ContainerContext::scheduleRetry(ContainerObj *cont) {
+  if (cont->retryBackoff == 0) {
+    cont->retryBackoff = CONT_RETRY_MIN_NS;
+  } else if (cont->retryBackoff < CONT_RETRY_MAX_NS) {
+    cont->retryBackoff =
+        std::min<uint64_t>(cont->retryBackoff * 2, CONT_RETRY_MAX_NS);
+  }
+  cont->nextRetry = m_cxt->timeStamp + cont->retryBackoff;
+}
+
+void ContainerContext::onNewContainer(const sinsp_container_info &container) {
+  ContainerTable::iterator cont = m_containers.find(container.m_id);
+  if (cont == m_containers.end() || !cont->second->incomplete ||
+      isIncomplete(container)) {
+    return;
+  }
+  SF_DEBUG(m_logger, "Container metadata now available. ID: "
+                         << container.m_id << " Name: " << container.m_name)
+  ContainerObj *ct = cont->second;
+  setContainer(&ct, container);
+  sfmemory::account(sfmemory::MemContainer, ct);
+  ct->incomplete = false;
+  ct->retryBackoff = 0;
+  // re-emit the completed container on its next reference
+  ct->generation = 0;
 }
 
 ContainerContext::ContainerContext(context::SysFlowContext *cxt,
                                    writer::SysFlowWriter *writer,
                                    sfk8s::K8sContext *k8sCxt)
-    : m_containers(CONT_TABLE_SIZE) {
+    : m_containers(cxt->getContTableSize()) {
   m_cxt = cxt;
   m_writer = writer;
   m_k8sCxt = k8sCxt;
   m_containers.set_empty_key("0");
   m_containers.set_deleted_key("");
+  sftable::configure(m_containers, m_cxt->getContTableSize(),
+                     m_cxt->getTableMaxLoad());
+  m_cxt->getInspector()->m_container_manager.subscribe_on_new_container(
+      [this](const sinsp_container_info &container, sinsp_threadinfo *) {
+        onNewContainer(container);
+      });
 }
 
 ContainerContext::~ContainerContext() { clearAllContainers(); }
@@ -63,14 +105,15 @@ ContainerObj *ContainerContext::createContainer(sinsp_threadinfo *ti) {
     cont->cont.image = INCOMPLETE_IMAGE;
     cont->cont.id = ti->m_container_id;
     cont->incomplete = true;
+    scheduleRetry(cont);
     return cont;
   }
 
   auto *cont = new ContainerObj();
-  setContainer(&cont, container);
-  if (cont->cont.name.compare(INCOMPLETE) == 0 ||
-      cont->cont.image.compare(INCOMPLETE_IMAGE) == 0) {
+  setContainer(&cont, *container);
+  if (isIncomplete(*container)) {
     cont->incomplete = true;
+    scheduleRetry(cont);
   }
 
   if (m_cxt->isK8sEnabled()) {
@@ -104,9 +147,9 @@ bool ContainerContext::exportContainer(const std::string &id) {
     if (m_cxt->isK8sEnabled() && !cont->second->cont.podId.is_null()) {
       m_k8sCxt->exportPod(cont->second->cont.podId.get_string());
     }
-    if (!cont->second->written) {
+    if (cont->second->generation != m_writer->getGeneration()) {
       m_writer->writeContainer(&(cont->second->cont));
-      cont->second->written = true;
+      cont->second->generation = m_writer->getGeneration();
       exprt = true;
     }
   }
@@ -129,39 +172,51 @@ ContainerObj *ContainerContext::getContainer(sinsp_threadinfo *ti) {
     return nullptr;
   }
 
+  uint64_t gen = m_writer->getGeneration();
   ContainerObj *ct = nullptr;
   ContainerTable::iterator cont = m_containers.find(ti->m_container_id);
   if (cont != m_containers.end()) {
-    if (cont->second->written && !cont->second->incomplete) {
-      return cont->second;
+    ct = cont->second;
+    bool written = (ct->generation == gen);
+    // incomplete containers only query libsinsp again once their retry is
+    // due; until then the metadata known so far is used.
+    bool query = !ct->incomplete || m_cxt->timeStamp >= ct->nextRetry;
+    if (written && (!ct->incomplete || !query)) {
+      return ct;
     }
 
-    const sinsp_container_info::ptr_t container =
-        m_cxt->getInspector()->m_container_manager.get_container(
-            ti->m_container_id);
-    if (!container) {
-      // m_containers.erase(cont);
-      // delete cont->second;
-      return cont->second;
-    }
+    if (query) {
+      const sinsp_container_info::ptr_t container =
+          m_cxt->getInspector()->m_container_manager.get_container(
+              ti->m_container_id);
+      if (!container) {
+        if (ct->incomplete) {
+          scheduleRetry(ct);
+        }
+        return ct;
+      }
 
-    if (cont->second->written && cont->second->incomplete) {
-      SF_DEBUG(m_logger,
-               "Container is written and includes name: " << container->m_name);
-      if (container->m_name.compare(INCOMPLETE) == 0 ||
-          container->m_image.compare(INCOMPLETE) == 0) {
-        return cont->second;
-      } else {
-        cont->second->incomplete = false;
+      if (ct->incomplete) {
+        if (isIncomplete(*container)) {
+          scheduleRetry(ct);
+          if (written) {
+            return ct;
+          }
+        } else {
+          SF_DEBUG(m_logger, "Incomplete container now includes name: "
+                                 << container->m_name);
+          ct->incomplete = false;
+          ct->retryBackoff = 0;
+        }
       }
+      setContainer(&ct, *container);
     }
-
-    ct = cont->second;
-    setContainer(&ct, container);
   }
 
+  bool created = false;
   if (ct == nullptr) {
     ct = createContainer(ti);
+    created = true;
   } else {
     if (m_cxt->isK8sEnabled()) {
       reupPod(ti, ct);
@@ -172,9 +227,13 @@ ContainerObj *ContainerContext::getContainer(sinsp_threadinfo *ti) {
     return nullptr;
   }
 
-  m_containers[ct->cont.id] = ct;
+  if (created) {
+    m_containers[ct->cont.id] = ct;
+    m_sweepQue.emplace_back(ct, gen);
+  }
+  sfmemory::account(sfmemory::MemContainer, ct);
   m_writer->writeContainer(&(ct->cont));
-  ct->written = true;
+  ct->generation = gen;
 
   return ct;
 }
@@ -205,24 +264,115 @@ void ContainerContext::reupPod(sinsp_threadinfo *ti, ContainerObj *cont) {
   }
 }
 
-void ContainerContext::clearContainers() {
-  for (ContainerTable::iterator it = m_containers.begin();
-       it != m_containers.end(); ++it) {
-    if (it->second->refs == 0) {
-      if (m_cxt->isK8sEnabled() && !it->second->cont.podId.is_null()) {
-        m_k8sCxt->derefPod(it->second->cont.podId.get_string());
+int ContainerContext::sweepContainers(int budget) {
+  uint64_t gen = m_writer->getGeneration();
+  int deleted = 0;
+  while (budget > 0 && !m_sweepQue.empty() && m_sweepQue.front().second < gen) {
+    ContainerObj *cont = m_sweepQue.front().first;
+    m_sweepQue.pop_front();
+    budget--;
+    if (cont->refs == 0 && cont->generation != gen) {
+      if (m_cxt->isK8sEnabled() && !cont->cont.podId.is_null()) {
+        m_k8sCxt->derefPod(cont->cont.podId.get_string());
       }
-      m_containers.erase(it);
-      delete it->second;
+      m_containers.erase(cont->cont.id);
+      sfmemory::release(sfmemory::MemContainer, cont);
+      delete cont;
+      deleted++;
     } else {
-      it->second->written = false;
+      m_sweepQue.emplace_back(cont, gen);
     }
   }
+  return deleted;
 }
 
 void ContainerContext::clearAllContainers() {
   for (ContainerTable::iterator it = m_containers.begin();
        it != m_containers.end(); ++it) {
+    sfmemory::release(sfmemory::MemContainer, it->second);
     delete it->second;
   }
 }
+
+// completes a rollup record with the interval and counters, and writes it
+void ContainerContext::writeRollup(sfsummary::Record &rec,
+                                   const ContainerRollup &rollup,
+                                   uint64_t ts) {
+  rec.add("startTs", m_rollupStartTs);
+  rec.add("endTs", ts);
+  rec.add("netRecvOps", rollup.netRecv.ops);
+  rec.add("netRecvBytes", rollup.netRecv.bytes);
+  rec.add("netSendOps", rollup.netSend.ops);
+  rec.add("netSendBytes", rollup.netSend.bytes);
+  rec.add("fileReadOps", rollup.fileRead.ops);
+  rec.add("fileReadBytes", rollup.fileRead.bytes);
+  rec.add("fileWriteOps", rollup.fileWrite.ops);
+  rec.add("fileWriteBytes", rollup.fileWrite.bytes);
+  rec.add("filesWritten", rollup.filesWritten);
+  rec.add("procsSpawned", rollup.procsSpawned);
+  rec.add("threadsCloned", rollup.threadsCloned);
+  rec.add("threadsExited", rollup.threadsExited);
+  if (m_cxt->isFanOut()) {
+    rec.add("distinctIPs", rollup.fanOut.ips.estimate());
+    rec.add("distinctPorts", rollup.fanOut.ports.estimate());
+    rec.add("distinctFiles", rollup.fanOut.files.estimate());
+  }
+  m_writer->writeSummary(rec);
+}
+
+int ContainerContext::writeRollups() {
+  uint64_t ts = utils::getSinspTime(m_cxt);
+  auto recTs = static_cast<int64_t>(ts);
+  bool k8s = m_cxt->isK8sEnabled();
+  std::map<std::string, ContainerRollup> pods;
+  int written = 0;
+  for (auto &it : m_containers) {
+    ContainerObj *cont = it.second;
+    if (cont->ext == nullptr || cont->ext->rollup.empty()) {
+      continue;
+    }
+    ContainerRollup &rollup = cont->ext->rollup;
+    // the container record precedes its rollups in the output file
+    exportContainer(cont->cont.id);
+    sfsummary::Record rec("ContainerRollup", recTs);
+    rec.add("id", cont->cont.id);
+    rec.add("name", cont->cont.name);
+    rec.add("image", cont->cont.image);
+    if (!cont->cont.podId.is_null()) {
+      rec.add("podId", cont->cont.podId.get_string());
+      if (k8s) {
+        pods[cont->cont.podId.get_string()] += rollup;
+      }
+    }
+    writeRollup(rec, rollup, ts);
+    rollup = ContainerRollup();
+    written++;
+  }
+  for (auto &it : pods) {
+    sfsummary::Record rec("PodRollup", recTs);
+    rec.add("id", it.first);
+    std::shared_ptr<PodObj> pod = m_k8sCxt->getPod(it.first);
+    if (pod != nullptr) {
+      rec.add("name", pod->pod.name);
+      rec.add("namespace", pod->pod.namespace_);
+    }
+    writeRollup(rec, it.second, ts);
+    written++;
+  }
+  m_rollupStartTs = ts;
+  sfmetrics::g_metrics.rollupRecords += written;
+  return written;
+}
+
+int ContainerContext::checkRollups(time_t now) {
+  if (m_lastRollupWrite == 0) {
+    m_lastRollupWrite = now;
+    m_rollupStartTs = utils::getSinspTime(m_cxt);
+    return 0;
+  }
+  if (difftime(now, m_lastRollupWrite) < m_cxt->getNFExportInterval()) {
+    return 0;
+  }
+  m_lastRollupWrite = now;
+  return writeRollups();
+}
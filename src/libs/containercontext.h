@@ -23,24 +23,35 @@
 
 #include "datatypes.h"
 #include "k8scontext.h"
+#include "sfmemory.h"
 #include "sysflow.h"
 #include "sysflowcontext.h"
 #include "sysflowwriter.h"
 #include <sinsp.h>
-#define CONT_TABLE_SIZE 100
 #define INCOMPLETE "incomplete"
 #define INCOMPLETE_IMAGE "incomplete:incomplete"
+// backoff bounds (ns) between metadata lookups of incomplete containers
+#define CONT_RETRY_MIN_NS 100000000ULL
+#define CONT_RETRY_MAX_NS 30000000000ULL
 
 namespace container {
 class ContainerContext {
 private:
   ContainerTable m_containers;
+  ContainerSweepQueue m_sweepQue;
   context::SysFlowContext *m_cxt;
   writer::SysFlowWriter *m_writer;
   sfk8s::K8sContext *m_k8sCxt;
+  time_t m_lastRollupWrite{0};
+  uint64_t m_rollupStartTs{0};
   ContainerObj *createContainer(sinsp_threadinfo *ti);
-  void setContainer(ContainerObj **cont, sinsp_container_info::ptr_t container);
+  void setContainer(ContainerObj **cont, const sinsp_container_info &container);
+  bool isIncomplete(const sinsp_container_info &container);
+  void scheduleRetry(ContainerObj *cont);
+  void onNewContainer(const sinsp_container_info &container);
   void reupPod(sinsp_threadinfo *ti, ContainerObj *cont);
+  void writeRollup(sfsummary::Record &rec, const ContainerRollup &rollup,
+                   uint64_t ts);
 
 public:
   ContainerContext(context::SysFlowContext *cxt, writer::SysFlowWriter *writer,
@@ -51,8 +62,17 @@ public:
   bool exportContainer(const std::string &id);
   int derefContainer(const std::string &id);
   void clearAllContainers();
-  void clearContainers();
+  int sweepContainers(int budget);
+  int writeRollups();
+  int checkRollups(time_t now);
   inline int getSize() { return m_containers.size(); }
+  inline int64_t getMemBytes() {
+    return sfmemory::g_memory.bytes[sfmemory::MemContainer] +
+           sfmemory::bucketBytes(m_containers);
+  }
+  inline bool shrinkTable() {
+    return sftable::shrink(m_containers, m_cxt->getContTableSize());
+  }
 };
 } // namespace container
 #endif
@@ -18,6 +18,7 @@
  **/
 
 #include "controlflowprocessor.h"
+#include "sfmetrics.h"
 
 using controlflow::ControlFlowProcessor;
 
@@ -30,6 +31,14 @@ ControlFlowProcessor::ControlFlowProcessor(
   m_processCxt = processCxt;
   m_writer = writer;
   m_lastCheck = 0;
+  m_lastForkSummaryWrite = 0;
+  m_lastFanOutWrite = 0;
+  ForkSummaryKey emptyKey{};
+  ForkSummaryKey delKey{};
+  emptyKey.poid = *utils::getOIDEmptyKey();
+  delKey.poid = *utils::getOIDDelKey();
+  m_forkSummaries.set_empty_key(emptyKey);
+  m_forkSummaries.set_deleted_key(delKey);
   m_pfSet = processCxt->getPFSet();
   m_procEvtPrcr =
       new processevent::ProcessEventProcessor(writer, processCxt, dfPrcr);
@@ -39,6 +48,10 @@ ControlFlowProcessor::~ControlFlowProcessor() {
   if (m_procEvtPrcr != nullptr) {
     delete m_procEvtPrcr;
   }
+  for (auto &s : m_forkSummaries) {
+    sfmemory::release(sfmemory::MemProcess, s.second);
+    delete s.second;
+  }
 }
 
 void ControlFlowProcessor::setUID(sinsp_evt *ev) { m_procEvtPrcr->setUID(ev); }
@@ -50,7 +63,7 @@ inline void ControlFlowProcessor::processFlow(sinsp_evt *ev, OpFlags flag) {
   if (pfo == nullptr) {
     processNewFlow(ev, proc, flag);
   } else {
-    updateProcFlow(pfo, flag, ev);
+    updateProcFlow(pfo, flag, ev, proc);
   }
 }
 
@@ -61,9 +74,10 @@ inline void ControlFlowProcessor::processNewFlow(sinsp_evt *ev,
   pf->exportTime = utils::getCurrentTime(m_cxt);
   pf->lastUpdate = utils::getCurrentTime(m_cxt);
   populateProcFlow(pf, flag, ev, proc);
-  updateProcFlow(pf, flag, ev);
+  updateProcFlow(pf, flag, ev, proc);
   proc->pfo = pf;
   m_pfSet->insert(proc);
+  sfmemory::account(sfmemory::MemProcFlow, pf);
 }
 
 inline void ControlFlowProcessor::populateProcFlow(ProcessFlowObj *pf,
@@ -80,18 +94,26 @@ inline void ControlFlowProcessor::populateProcFlow(ProcessFlowObj *pf,
 }
 
 inline void ControlFlowProcessor::updateProcFlow(ProcessFlowObj *pf,
-                                                 OpFlags flag, sinsp_evt *ev) {
+                                                 OpFlags flag, sinsp_evt *ev,
+                                                 ProcessObj *proc) {
   pf->procflow.opFlags |= flag;
   pf->lastUpdate = utils::getCurrentTime(m_cxt);
+  ContainerRollup *rollup = proc->getRollup();
   if (flag == OP_CLONE) {
     int res = utils::getSyscallResult(ev);
     if (res == 0) {
       pf->procflow.numThreadsCloned++;
+      if (rollup != nullptr) {
+        rollup->threadsCloned++;
+      }
     } else if (res == -1) {
       pf->procflow.numCloneErrors++;
     }
   } else if (flag == OP_EXIT) {
     pf->procflow.numThreadsExited++;
+    if (rollup != nullptr) {
+      rollup->threadsExited++;
+    }
   }
 }
 
@@ -101,13 +123,189 @@ inline void ControlFlowProcessor::removeAndWriteProcessFlow(ProcessObj *proc) {
   proc->pfo = nullptr;
 }
 
+bool ControlFlowProcessor::updateForkRate(ProcessObj *parent, uint64_t ts) {
+  uint64_t sec = ts / 1000000000ULL;
+  auto threshold = static_cast<uint32_t>(m_cxt->getForkStormThreshold());
+  ProcessExt *ext = sfmemory::getExt(parent);
+  if (sec != ext->cloneSecond) {
+    // a storm lasts as long as every second is over the threshold
+    ext->forkStorm =
+        (sec == ext->cloneSecond + 1 && ext->clonesInSecond > threshold);
+    ext->cloneSecond = sec;
+    ext->clonesInSecond = 0;
+  }
+  if (++ext->clonesInSecond > threshold) {
+    ext->forkStorm = true;
+  }
+  return ext->forkStorm;
+}
+
+ProcessObj *ControlFlowProcessor::getStormParent(sinsp_threadinfo *mt,
+                                                 uint64_t ts) {
+  sinsp_threadinfo *pt = mt->get_parent_thread();
+  if (pt == nullptr) {
+    return nullptr;
+  }
+  if (!pt->is_main_thread()) {
+    sinsp_threadinfo *main = pt->get_main_thread();
+    if (main != nullptr) {
+      pt = main;
+    }
+  }
+  OID poid;
+  poid.hpid = pt->m_pid;
+  poid.createTS = pt->m_clone_ts;
+  ProcessObj *parent = m_processCxt->getProcess(&poid);
+  if (parent == nullptr || parent->ext == nullptr || !parent->ext->forkStorm ||
+      ts / 1000000000ULL > parent->ext->cloneSecond + 1) {
+    return nullptr;
+  }
+  return parent;
+}
+
+void ControlFlowProcessor::foldForkEvent(ProcessObj *parent,
+                                         sinsp_threadinfo *mt, sinsp_evt *ev,
+                                         OpFlags flag, bool counted) {
+  const std::string &exe =
+      (mt->m_exepath.empty() || mt->m_exepath.compare("<NA>") == 0)
+          ? mt->m_exe
+          : mt->m_exepath;
+  ForkSummaryKey key{};
+  key.poid = parent->proc.oid;
+  key.exeHash = XXH3_64bits(exe.data(), exe.size());
+  for (const auto &arg : mt->m_args) {
+    key.exeHash = XXH3_64bits_withSeed(arg.data(), arg.size(), key.exeHash);
+  }
+  ForkSummaryObj *s = nullptr;
+  ForkSummaryTable::iterator it = m_forkSummaries.find(key);
+  if (it == m_forkSummaries.end()) {
+    s = new ForkSummaryObj();
+    s->ts = ev->get_ts();
+    s->poid = parent->proc.oid;
+    s->exe = exe;
+    for (const auto &arg : mt->m_args) {
+      if (!s->exeArgs.empty()) {
+        s->exeArgs += " ";
+      }
+      s->exeArgs += arg;
+    }
+    m_forkSummaries[key] = s;
+  } else {
+    s = it->second;
+  }
+  s->lastTs = ev->get_ts();
+  if (counted) {
+    if (flag == OP_CLONE) {
+      s->clones++;
+    } else if (flag == OP_EXEC) {
+      s->execs++;
+    } else {
+      s->exits++;
+    }
+  }
+  sfmemory::account(sfmemory::MemProcess, s);
+  sfmetrics::g_metrics.forkStormEvents++;
+}
+
+bool ControlFlowProcessor::summarizeForkStorm(sinsp_evt *ev,
+                                              sinsp_threadinfo *ti,
+                                              OpFlags flag) {
+  if (flag != OP_CLONE && flag != OP_EXEC && flag != OP_EXIT) {
+    return false;
+  }
+  sinsp_threadinfo *mt = ti->get_main_thread();
+  if (mt == nullptr) {
+    mt = ti;
+  }
+  OID oid;
+  oid.hpid = mt->m_pid;
+  oid.createTS = mt->m_clone_ts;
+  ProcessObj *proc = m_processCxt->getProcess(&oid);
+  if (flag == OP_CLONE && utils::getSyscallResult(ev) > 0) {
+    // parent side of a clone: counts towards the clone rate of the parent
+    if (proc == nullptr || utils::isCloneThreadSet(ev) ||
+        !updateForkRate(proc, ev->get_ts())) {
+      return false;
+    }
+    foldForkEvent(proc, mt, ev, flag, true);
+    return true;
+  }
+  // events of children that are not in the process table yet, because all
+  // their events so far were folded
+  if (proc != nullptr) {
+    return false;
+  }
+  ProcessObj *parent = getStormParent(mt, ev->get_ts());
+  if (parent == nullptr) {
+    return false;
+  }
+  // the fork summary stands in for the child, which is never written
+  bool exited = (flag == OP_EXIT && ti->is_main_thread());
+  foldForkEvent(parent, mt, ev, flag, flag == OP_EXEC || exited);
+  return true;
+}
+
+int ControlFlowProcessor::writeForkSummaries() {
+  int written = 0;
+  for (auto &it : m_forkSummaries) {
+    ForkSummaryObj *s = it.second;
+    if (m_processCxt->getProcess(&(s->poid)) != nullptr) {
+      m_processCxt->exportProcess(&(s->poid));
+    }
+    sfsummary::Record rec("ForkSummary", s->ts);
+    rec.addOID("procOID", s->poid);
+    rec.add("endTs", s->lastTs);
+    rec.add("exe", s->exe);
+    rec.add("args", s->exeArgs);
+    rec.add("clones", s->clones);
+    rec.add("execs", s->execs);
+    rec.add("exits", s->exits);
+    m_writer->writeSummary(rec);
+    sfmemory::release(sfmemory::MemProcess, s);
+    delete s;
+    written++;
+  }
+  m_forkSummaries.clear();
+  sfmetrics::g_metrics.forkSummaryRecords += written;
+  return written;
+}
+
+int ControlFlowProcessor::checkForkSummaries(time_t now) {
+  if (m_lastForkSummaryWrite == 0) {
+    m_lastForkSummaryWrite = now;
+    return 0;
+  }
+  if (difftime(now, m_lastForkSummaryWrite) < m_cxt->getNFExportInterval()) {
+    return 0;
+  }
+  m_lastForkSummaryWrite = now;
+  return writeForkSummaries();
+}
+
+int ControlFlowProcessor::checkFanOuts(time_t now) {
+  if (m_lastFanOutWrite == 0) {
+    m_lastFanOutWrite = now;
+    return 0;
+  }
+  if (difftime(now, m_lastFanOutWrite) < m_cxt->getNFExportInterval()) {
+    return 0;
+  }
+  m_lastFanOutWrite = now;
+  return writeFanOuts();
+}
+
 int ControlFlowProcessor::handleProcEvent(sinsp_evt *ev, OpFlags flag) {
+  SF_LATENCY_STAGE(LatProcEvent)
   sinsp_threadinfo *ti = ev->get_thread_info();
   if (ti == nullptr) {
     SF_DEBUG(m_logger, "ti is NULL in handleProcEvent for flag " << flag);
     return -1;
   }
 
+  if (m_cxt->isForkStormSummary() && summarizeForkStorm(ev, ti, flag)) {
+    return 2;
+  }
+
   switch (flag) {
   case OP_EXIT: {
     if (m_cxt->isProcessFlowEnabled() && !ti->is_main_thread()) {
@@ -184,12 +382,20 @@ int ControlFlowProcessor::checkForExpiredRecords() {
   }
   m_lastCheck = now;
   int i = 0;
+  uint64_t start = sfbench::getTimeNs();
+  if (m_cxt->isForkStormSummary()) {
+    i += checkForkSummaries(now);
+  }
+  if (m_cxt->isFanOut()) {
+    i += checkFanOuts(now);
+  }
   SF_DEBUG(m_logger, "Checking expired PROC Flows!!!....");
   for (auto it = m_pfSet->begin(); it != m_pfSet->end();) {
     if (difftime(now, (*it)->pfo->exportTime) >= m_cxt->getNFExportInterval()) {
       SF_DEBUG(m_logger, "Exporting Proc flow!!! ");
       if (difftime(now, (*it)->pfo->lastUpdate) >=
           m_cxt->getNFExpireInterval()) {
+        sfmemory::release(sfmemory::MemProcFlow, (*it)->pfo);
         delete (*it)->pfo;
         (*it)->pfo = nullptr;
         it = m_pfSet->erase(it);
@@ -205,5 +411,6 @@ int ControlFlowProcessor::checkForExpiredRecords() {
       break;
     }
   }
+  sfmetrics::recordExpiryScan(start, i);
   return i;
 }
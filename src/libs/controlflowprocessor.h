@@ -36,13 +36,22 @@ private:
   writer::SysFlowWriter *m_writer;
   ProcessFlowSet *m_pfSet;
   time_t m_lastCheck;
+  ForkSummaryTable m_forkSummaries;
+  time_t m_lastForkSummaryWrite;
+  time_t m_lastFanOutWrite;
   DEFINE_LOGGER();
-  void updateProcFlow(ProcessFlowObj *pf, OpFlags flag, sinsp_evt *ev);
+  void updateProcFlow(ProcessFlowObj *pf, OpFlags flag, sinsp_evt *ev,
+                      ProcessObj *proc);
   void populateProcFlow(ProcessFlowObj *pf, OpFlags flag, sinsp_evt *ev,
                         ProcessObj *proc);
   void processNewFlow(sinsp_evt *ev, ProcessObj *proc, OpFlags flag);
   void processFlow(sinsp_evt *ev, OpFlags flag);
   void removeAndWriteProcessFlow(ProcessObj *proc);
+  bool summarizeForkStorm(sinsp_evt *ev, sinsp_threadinfo *ti, OpFlags flag);
+  bool updateForkRate(ProcessObj *parent, uint64_t ts);
+  ProcessObj *getStormParent(sinsp_threadinfo *mt, uint64_t ts);
+  void foldForkEvent(ProcessObj *parent, sinsp_threadinfo *mt, sinsp_evt *ev,
+                     OpFlags flag, bool counted);
 
 public:
   inline int getSize() { return m_pfSet->size(); }
@@ -56,6 +65,11 @@ public:
   void printFlowStats();
   void exportProcessFlow(ProcessFlowObj *pfo);
   void setUID(sinsp_evt *ev);
+  // writes the fork storm summaries once per export interval
+  int checkForkSummaries(time_t now);
+  int writeForkSummaries();
+  int checkFanOuts(time_t now);
+  inline int writeFanOuts() { return m_processCxt->writeFanOuts(); }
 };
 } // namespace controlflow
 
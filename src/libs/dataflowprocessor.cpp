@@ -18,6 +18,8 @@
  **/
 
 #include "dataflowprocessor.h"
+#include "dropfilter.h"
+#include <arpa/inet.h>
 
 using dataflow::DataFlowProcessor;
 
@@ -30,6 +32,7 @@ DataFlowProcessor::DataFlowProcessor(context::SysFlowContext *cxt,
     : m_dfSet() {
   m_cxt = cxt;
   m_procCxt = processCxt;
+  m_writer = writer;
   m_netflowPrcr =
       new networkflow::NetworkFlowProcessor(cxt, writer, processCxt, &m_dfSet);
   m_fileflowPrcr = new fileflow::FileFlowProcessor(cxt, writer, processCxt,
@@ -37,6 +40,9 @@ DataFlowProcessor::DataFlowProcessor(context::SysFlowContext *cxt,
   m_fileevtPrcr =
       new fileevent::FileEventProcessor(writer, processCxt, fileCxt);
   m_lastCheck = 0;
+  if (m_cxt->isHeavyHitters()) {
+    m_heavyHitters = new sfsketch::HeavyHitters(m_cxt->getHeavyHitterK());
+  }
 }
 
 DataFlowProcessor::~DataFlowProcessor() {
@@ -49,10 +55,115 @@ DataFlowProcessor::~DataFlowProcessor() {
   if (m_fileevtPrcr != nullptr) {
     delete m_fileevtPrcr;
   }
+  if (m_heavyHitters != nullptr) {
+    delete m_heavyHitters;
+  }
+}
+
+void DataFlowProcessor::sketchEvent(sinsp_evt *ev, sinsp_fdinfo_t *fdinfo) {
+  m_heavyHitters->countEvent();
+  sinsp_threadinfo *ti = ev->get_thread_info();
+  if (ti != nullptr) {
+    sinsp_threadinfo *mt = ti->get_main_thread();
+    if (mt == nullptr) {
+      mt = ti;
+    }
+    const std::string &exe = mt->m_exepath.empty() ? mt->m_exe : mt->m_exepath;
+    m_heavyHitters->add(sfsketch::SketchExe, exe.data(), exe.size(),
+                        [&exe]() { return exe; });
+    const std::string &cont = ti->m_container_id;
+    if (!cont.empty()) {
+      m_heavyHitters->add(sfsketch::SketchContainer, cont.data(), cont.size(),
+                          [&cont]() { return cont; });
+    }
+  }
+  if (fdinfo == nullptr) {
+    return;
+  }
+  if (fdinfo->is_ipv4_socket()) {
+    uint32_t ip;
+    uint16_t port;
+    utils::getRemoteEndpoint(fdinfo, ip, port);
+    char ep[sizeof(ip) + sizeof(port)];
+    memcpy(ep, &ip, sizeof(ip));
+    memcpy(ep + sizeof(ip), &port, sizeof(port));
+    m_heavyHitters->add(sfsketch::SketchEndpoint, ep, sizeof(ep),
+                        [ip, port]() {
+                          char addr[INET_ADDRSTRLEN];
+                          inet_ntop(AF_INET, &ip, addr, sizeof(addr));
+                          return std::string(addr) + ":" +
+                                 std::to_string(port);
+                        });
+  } else if (fdinfo->is_ipv6_socket()) {
+    ipv6addr ip;
+    uint16_t port;
+    utils::getRemoteEndpoint(fdinfo, ip, port);
+    char ep[sizeof(ip.m_b) + sizeof(port)];
+    memcpy(ep, ip.m_b, sizeof(ip.m_b));
+    memcpy(ep + sizeof(ip.m_b), &port, sizeof(port));
+    m_heavyHitters->add(sfsketch::SketchEndpoint, ep, sizeof(ep),
+                        [&ip, port]() {
+                          char addr[INET6_ADDRSTRLEN];
+                          inet_ntop(AF_INET6, ip.m_b, addr, sizeof(addr));
+                          return "[" + std::string(addr) +
+                                 "]:" + std::to_string(port);
+                        });
+  } else if (!fdinfo->m_name.empty()) {
+    const std::string &name = fdinfo->m_name;
+    m_heavyHitters->add(sfsketch::SketchFile, name.data(), name.size(),
+                        [&name]() { return name; });
+  }
+}
+
+// lifecycle operations are never limited, so that flows are still opened and
+// closed (and written) whatever their data events
+bool DataFlowProcessor::rateLimited(sinsp_evt *ev, OpFlags flag) {
+  if (flag == OP_OPEN || flag == OP_ACCEPT || flag == OP_CONNECT ||
+      flag == OP_CLOSE || flag == OP_SHUTDOWN) {
+    return false;
+  }
+  sinsp_threadinfo *ti = ev->get_thread_info();
+  if (ti == nullptr) {
+    return false;
+  }
+  sinsp_threadinfo *mt = ti->get_main_thread();
+  if (mt == nullptr) {
+    mt = ti;
+  }
+  OID oid;
+  oid.hpid = mt->m_pid;
+  oid.createTS = mt->m_clone_ts;
+  ProcessObj *proc = m_procCxt->getProcess(&oid);
+  if (proc == nullptr) {
+    return false;
+  }
+  TokenBucket *bucket = &(sfmemory::getExt(proc)->bucket);
+  if (m_cxt->getRateLimitScope() == SFRateLimitScope::SFRateLimitContainer &&
+      !ti->m_container_id.empty()) {
+    ContainerObj *cont = m_procCxt->getContainer(ti->m_container_id);
+    if (cont != nullptr) {
+      bucket = &(sfmemory::getExt(cont)->bucket);
+    }
+  }
+  if (bucket->take(m_cxt->getRateLimit(), m_cxt->getRateLimitBurst(),
+                   ev->get_ts())) {
+    return false;
+  }
+  // the count is held by the writer until the next flow of the process
+  m_writer->addCount(oid, sfsummary::CountSuppressed);
+  sfmetrics::g_metrics.rateLimitedEvents++;
+  return true;
 }
 
 int DataFlowProcessor::handleDataEvent(sinsp_evt *ev, OpFlags flag) {
+  SF_LATENCY_STAGE(LatDataEvent)
   sinsp_fdinfo_t *fdinfo = ev->get_fd_info();
+  if (m_heavyHitters != nullptr) {
+    sketchEvent(ev, fdinfo);
+  }
+  if (m_cxt->isRateLimit() && rateLimited(ev, flag)) {
+    return 2;
+  }
 
   if (fdinfo == nullptr) {
     SF_DEBUG(
@@ -106,6 +217,16 @@ int DataFlowProcessor::checkForExpiredRecords() {
 
   m_lastCheck = now;
   int i = 0;
+  uint64_t start = sfbench::getTimeNs();
+  if (m_cxt->isConnSummary()) {
+    i += m_netflowPrcr->checkSummaries(now);
+  }
+  if (m_cxt->isFileCoalesce()) {
+    i += m_fileflowPrcr->checkCoalescedFlows(now);
+  }
+  if (m_heavyHitters != nullptr) {
+    i += checkHeavyHitters(now);
+  }
   SF_DEBUG(m_logger, "Checking expired Flows!!!....");
   for (auto it = m_dfSet.begin(); it != m_dfSet.end();) {
     SF_DEBUG(m_logger, "Checking flow with exportTime: " << (*it)->exportTime
@@ -135,5 +256,86 @@ int DataFlowProcessor::checkForExpiredRecords() {
       break;
     }
   }
+  sfmetrics::recordExpiryScan(start, i);
   return i;
 }
+
+// drop filter rule that would suppress a heavy hitter. Drop rules match a
+// single attribute, so endpoints (address and port) get no suggestion.
+static std::string suggestRule(sfsketch::SketchType type,
+                               const std::string &key) {
+  switch (type) {
+  case sfsketch::SketchFile:
+    return std::string(DROP_RULE_PATH) + " " + key;
+  case sfsketch::SketchExe:
+    return std::string(DROP_RULE_EXE) + " " + key;
+  case sfsketch::SketchContainer:
+    return std::string(DROP_RULE_CONTAINER) + " " + key;
+  default:
+    return std::string();
+  }
+}
+
+int DataFlowProcessor::writeHeavyHitters() {
+  m_heavyHitters->rotate();
+  uint64_t ts = utils::getSinspTime(m_cxt);
+  uint64_t events = m_heavyHitters->getLastEvents();
+  sfsummary::Record rec("HeavyHitters", static_cast<int64_t>(ts));
+  rec.add("startTs", m_heavyHitterStartTs);
+  rec.add("endTs", ts);
+  rec.add("events", events);
+  m_heavyHitterStartTs = ts;
+  std::vector<std::string> suggestions;
+  for (int i = 0; i < sfsketch::NumSketches; i++) {
+    auto type = static_cast<sfsketch::SketchType>(i);
+    std::string hitters = "[";
+    for (const sfsketch::HeavyHitter &h : m_heavyHitters->getLast(type)) {
+      hitters += (hitters.size() == 1) ? "{\"key\":\"" : ",{\"key\":\"";
+      utils::appendEscaped(hitters, h.key);
+      hitters += "\",\"count\":" + std::to_string(h.count) + "}";
+      if (events >= HH_SUGGEST_MIN_EVENTS &&
+          h.count >= events * HH_SUGGEST_SHARE) {
+        std::string rule = suggestRule(type, h.key);
+        if (!rule.empty()) {
+          suggestions.push_back(std::move(rule));
+        }
+      }
+    }
+    rec.addJSON(sfsketch::getSketchName(type), hitters + "]");
+  }
+  // suggestions are logged once per output generation, and at most
+  // HEAVY_HITTERS_MAX of them are remembered
+  uint64_t gen = m_writer->getGeneration();
+  if (gen != m_suggestedGeneration || m_suggested.size() >= HEAVY_HITTERS_MAX) {
+    m_suggested.clear();
+    m_suggestedGeneration = gen;
+  }
+  std::string rules = "[";
+  for (size_t i = 0; i < suggestions.size(); i++) {
+    rules += (i == 0) ? "\"" : ",\"";
+    utils::appendEscaped(rules, suggestions[i]);
+    rules += "\"";
+    if (m_suggested.insert(suggestions[i]).second) {
+      SF_INFO(m_logger, "Drop filter suggestion: " << suggestions[i])
+    }
+  }
+  rec.addJSON("suggestions", rules + "]");
+  if (!m_cxt->isHeavyHitterRecords()) {
+    return 0;
+  }
+  m_writer->writeSummary(rec);
+  return 1;
+}
+
+int DataFlowProcessor::checkHeavyHitters(time_t now) {
+  if (m_lastHeavyHitterWrite == 0) {
+    m_lastHeavyHitterWrite = now;
+    m_heavyHitterStartTs = utils::getSinspTime(m_cxt);
+    return 0;
+  }
+  if (difftime(now, m_lastHeavyHitterWrite) < m_cxt->getNFExportInterval()) {
+    return 0;
+  }
+  m_lastHeavyHitterWrite = now;
+  return writeHeavyHitters();
+}
@@ -24,8 +24,10 @@
 #include "logger.h"
 #include "networkflowprocessor.h"
 #include "op_flags.h"
+#include "sfsketch.h"
 #include "sysflowcontext.h"
 #include "sysflowwriter.h"
+#include <set>
 #include <sinsp.h>
 
 namespace dataflow {
@@ -38,7 +40,17 @@ private:
   process::ProcessContext *m_procCxt;
   DataFlowSet m_dfSet;
   time_t m_lastCheck;
+  writer::SysFlowWriter *m_writer;
+  sfsketch::HeavyHitters *m_heavyHitters{nullptr};
+  time_t m_lastHeavyHitterWrite{0};
+  uint64_t m_heavyHitterStartTs{0};
+  // suggestions already logged in the current output generation
+  std::set<std::string> m_suggested;
+  uint64_t m_suggestedGeneration{0};
   DEFINE_LOGGER();
+  void sketchEvent(sinsp_evt *ev, sinsp_fdinfo_t *fdinfo);
+  int checkHeavyHitters(time_t now);
+  bool rateLimited(sinsp_evt *ev, OpFlags flag);
 
 public:
   inline int getNFSize() { return m_netflowPrcr->getSize(); }
@@ -51,6 +63,14 @@ public:
   int checkForExpiredRecords();
   void printFlowStats();
   int removeAndWriteDFFromProc(ProcessObj *proc, int64_t tid);
+  inline int writeSummaries() { return m_netflowPrcr->writeSummaries(); }
+  inline int writeCoalescedFlows() {
+    return m_fileflowPrcr->writeCoalescedFlows();
+  }
+  int writeHeavyHitters();
+  inline const sfsketch::HeavyHitters *getHeavyHitters() {
+    return m_heavyHitters;
+  }
 };
 } // namespace dataflow
 
@@ -19,12 +19,18 @@
 
 #ifndef __HASHER__
 #define __HASHER__
+#include "sfhll.h"
+#include "sftable.h"
 #include "sysflow.h"
 #include "utils.h"
 #include "xxhash.h"
+#include <algorithm>
 #include <google/dense_hash_map>
+#include <deque>
 #include <google/dense_hash_set>
+#include <memory>
 #include <set>
+#include <type_traits>
 
 using sysflow::Container;
 using sysflow::FileFlow;
@@ -34,14 +40,20 @@ using sysflow::Pod;
 using sysflow::Process;
 using sysflow::ProcessFlow;
 
+// Network flow key. Fields are ordered by decreasing size so that the struct
+// has no padding: XXHasher hashes the raw bytes of the key, so every byte
+// must belong to a field compared by eqnfkey.
 struct NFKey {
   uint64_t tid;
   uint32_t ip1;
-  uint16_t port1;
   uint32_t ip2;
-  uint16_t port2;
   uint32_t fd;
+  uint16_t port1;
+  uint16_t port2;
 };
+static_assert(sizeof(NFKey) == 24, "NFKey must not contain padding");
+static_assert(std::has_unique_object_representations_v<NFKey>,
+              "NFKey must be hashable as raw bytes");
 
 class OIDObj {
 public:
@@ -58,6 +70,10 @@ public:
   time_t exportTime;
   time_t lastUpdate;
   bool isNetworkFlow;
+  // bytes accounted for the object in sfmemory
+  int64_t memBytes{0};
+  // periodic exports skipped by the export policy since the last record
+  uint32_t skippedExports{0};
   explicit DataFlowObj(bool inf)
       : exportTime(0), lastUpdate(0), isNetworkFlow(inf) {}
 };
@@ -104,6 +120,16 @@ public:
   FileFlowObj() : DataFlowObj(false) {}
 };
 
+// Completed file flows of a process merged by file and open flags.
+class FFCoalescedObj {
+public:
+  FileFlow fileflow;
+  std::string filekey;
+  // completed flows merged into the flow
+  uint64_t flows{0};
+  int64_t memBytes{0};
+};
+
 class ProcessFlowObj : public DataFlowObj {
 public:
   ProcessFlow procflow;
@@ -125,11 +151,18 @@ template <typename T> struct XXHasher {
   }
 };
 
+// OID is generated from the schema, so its fields are hashed explicitly
+// rather than its raw bytes, which could include padding
+inline XXH64_hash_t hashOID(const OID &oid, XXH64_hash_t seed = 0) {
+  const int64_t fields[2] = {oid.hpid, oid.createTS};
+  return XXH3_64bits_withSeed(fields, sizeof(fields), seed);
+}
+
+template <> struct XXHasher<OID> {
+  size_t operator()(const OID &t) const { return hashOID(t); }
+};
 template <> struct XXHasher<OID *> {
-  size_t operator()(const OID *t) const {
-    XXH64_hash_t hash = XXH3_64bits((void *)t, sizeof(OID));
-    return hash;
-  }
+  size_t operator()(const OID *t) const { return hashOID(*t); }
 };
 template <> struct XXHasher<NFKey *> {
   size_t operator()(const NFKey *t) const {
@@ -183,49 +216,255 @@ struct eqdfobj {
   }
 };
 
+// Connection summary key: completed network flows of a process to the same
+// destination are folded into one summary.
+struct NFSummaryKey {
+  OID oid;
+  uint32_t dip;
+  uint16_t dport;
+  uint16_t proto;
+};
+
+template <> struct XXHasher<NFSummaryKey> {
+  size_t operator()(const NFSummaryKey &t) const {
+    uint64_t dst = (static_cast<uint64_t>(t.dip) << 32) |
+                   (static_cast<uint64_t>(t.dport) << 16) | t.proto;
+    return hashOID(t.oid, dst);
+  }
+};
+
+struct eqnfsummarykey {
+  bool operator()(const NFSummaryKey &s1, const NFSummaryKey &s2) const {
+    return (s1.oid.hpid == s2.oid.hpid && s1.oid.createTS == s2.oid.createTS &&
+            s1.dip == s2.dip && s1.dport == s2.dport && s1.proto == s2.proto);
+  }
+};
+
+class NFSummaryObj {
+public:
+  NetworkFlow netflow;
+  // completed flows folded into the summary
+  uint64_t connections{0};
+  int64_t memBytes{0};
+};
+
+// Fork storm summary key: the parent, and a hash of the exe and args of
+// its children.
+struct ForkSummaryKey {
+  OID poid;
+  uint64_t exeHash;
+};
+
+template <> struct XXHasher<ForkSummaryKey> {
+  size_t operator()(const ForkSummaryKey &t) const {
+    return hashOID(t.poid, t.exeHash);
+  }
+};
+
+struct eqforksummarykey {
+  bool operator()(const ForkSummaryKey &k1, const ForkSummaryKey &k2) const {
+    return (k1.poid.hpid == k2.poid.hpid &&
+            k1.poid.createTS == k2.poid.createTS && k1.exeHash == k2.exeHash);
+  }
+};
+
+class ForkSummaryObj {
+public:
+  // the parent, and the first and last folded events
+  OID poid;
+  int64_t ts{0};
+  std::string exe;
+  std::string exeArgs;
+  int64_t lastTs{0};
+  uint64_t clones{0};
+  uint64_t execs{0};
+  uint64_t exits{0};
+  int64_t memBytes{0};
+};
+
 class FileObj {
 public:
-  bool written{false};
+  // writer generation in which the object was last written
+  uint64_t generation{0};
   uint32_t refs{0};
+  int64_t memBytes{0};
   std::string key;
   sysflow::File file;
   FileObj() {}
 };
 
+// token bucket of a rate limited process or container, refilled from the
+// event clock so that offline captures are limited as they were recorded
+struct TokenBucket {
+  double tokens{-1};
+  uint64_t lastTs{0};
+  inline bool take(double rate, double burst, uint64_t ts) {
+    if (tokens < 0) {
+      tokens = burst;
+      lastTs = ts;
+    } else if (ts > lastTs) {
+      tokens = std::min(burst, tokens + (ts - lastTs) * rate / 1e9);
+      lastTs = ts;
+    }
+    if (tokens < 1) {
+      return false;
+    }
+    tokens -= 1;
+    return true;
+  }
+};
+
+// operation and byte counts of a container rollup
+struct RollupCounter {
+  uint64_t ops{0};
+  uint64_t bytes{0};
+  inline void add(int res) {
+    ops++;
+    if (res > 0) {
+      bytes += res;
+    }
+  }
+  inline RollupCounter &operator+=(const RollupCounter &c) {
+    ops += c.ops;
+    bytes += c.bytes;
+    return *this;
+  }
+};
+
+// activity of the processes of a container in the current export interval
+struct ContainerRollup {
+  RollupCounter netRecv;
+  RollupCounter netSend;
+  RollupCounter fileRead;
+  RollupCounter fileWrite;
+  // file flows with writes, processes spawned, and threads cloned and exited
+  uint64_t filesWritten{0};
+  uint64_t procsSpawned{0};
+  uint64_t threadsCloned{0};
+  uint64_t threadsExited{0};
+  // distinct destinations, with fan-out estimates enabled
+  sfhll::FanOutSketch fanOut;
+  inline bool empty() const {
+    return netRecv.ops == 0 && netSend.ops == 0 && fileRead.ops == 0 &&
+           fileWrite.ops == 0 && filesWritten == 0 && procsSpawned == 0 &&
+           threadsCloned == 0 && threadsExited == 0 && fanOut.empty();
+  }
+  inline ContainerRollup &operator+=(const ContainerRollup &r) {
+    netRecv += r.netRecv;
+    netSend += r.netSend;
+    fileRead += r.fileRead;
+    fileWrite += r.fileWrite;
+    filesWritten += r.filesWritten;
+    procsSpawned += r.procsSpawned;
+    threadsCloned += r.threadsCloned;
+    threadsExited += r.threadsExited;
+    fanOut.merge(r.fanOut);
+    return *this;
+  }
+};
+
+// optional state of a container, allocated by the first feature using it
+struct ContainerExt {
+  ContainerRollup rollup;
+  TokenBucket bucket;
+};
+
 class ContainerObj {
 public:
-  bool written{false};
+  uint64_t generation{0};
   bool incomplete{false};
+  // sinsp timestamp after which the metadata of an incomplete container is
+  // looked up again, and the current delay between lookups.
+  uint64_t nextRetry{0};
+  uint64_t retryBackoff{0};
   uint32_t refs{0};
+  int64_t memBytes{0};
+  std::unique_ptr<ContainerExt> ext;
   Container cont;
   ContainerObj() {}
 };
 
 typedef google::dense_hash_map<int, std::string> ParameterMapping;
-typedef google::dense_hash_map<std::string, ContainerObj *,
-                               XXHasher<std::string>, eqstr>
+typedef sftable::HashMap<std::string, ContainerObj *, XXHasher<std::string>,
+                         eqstr>
     ContainerTable;
-typedef google::dense_hash_map<NFKey, NetFlowObj *, XXHasher<NFKey>, eqnfkey>
+typedef sftable::HashMap<NFKey, NetFlowObj *, XXHasher<NFKey>, eqnfkey>
     NetworkFlowTable;
-typedef google::dense_hash_map<std::string, FileFlowObj *,
-                               XXHasher<std::string>, eqstr>
+typedef sftable::HashMap<std::string, FileFlowObj *, XXHasher<std::string>,
+                         eqstr>
     FileFlowTable;
-typedef google::dense_hash_map<std::string, FileObj *, XXHasher<std::string>,
-                               eqstr>
+typedef sftable::HashMap<NFSummaryKey, NFSummaryObj *, XXHasher<NFSummaryKey>,
+                         eqnfsummarykey>
+    NFSummaryTable;
+typedef sftable::HashMap<ForkSummaryKey, ForkSummaryObj *,
+                         XXHasher<ForkSummaryKey>, eqforksummarykey>
+    ForkSummaryTable;
+typedef sftable::HashMap<std::string, FileObj *, XXHasher<std::string>, eqstr>
     FileTable;
 typedef google::dense_hash_map<OID, NetworkFlowTable *, XXHasher<OID>, eqoid>
     OIDNetworkTable;
 typedef google::dense_hash_set<OID, XXHasher<OID>, eqoid> ProcessSet;
 typedef std::multiset<DataFlowObj *, eqdfobj> DataFlowSet;
 typedef std::list<OIDObj *> OIDQueue;
+
+// optional state of a process, allocated by the first feature using it so
+// that processes of a collector without these features carry one pointer
+struct ProcessExt {
+  // completed file flows merged by file and open flags, written once per
+  // export interval
+  std::vector<FFCoalescedObj *> coalesced;
+  // children cloned in the current second of the event clock, and whether
+  // the process is in a fork storm
+  uint64_t cloneSecond{0};
+  uint32_t clonesInSecond{0};
+  bool forkStorm{false};
+  // rollup of the container of the process, if container rollups are on.
+  // The container is referenced by the process, so it outlives the pointer.
+  ContainerRollup *rollup{nullptr};
+  // distinct destinations of the process, allocated on its first flow with
+  // fan-out estimates enabled, and whether they changed since last written
+  std::unique_ptr<sfhll::FanOutSketch> fanOut;
+  bool fanOutDirty{false};
+  // rate limiter of the process
+  TokenBucket bucket;
+  // whether the state holds records not written yet
+  inline bool pending() const { return !coalesced.empty() || fanOutDirty; }
+};
+
 class ProcessObj {
 public:
-  bool written{false};
+  uint64_t generation{0};
+  // generation of the latest sweep queue entry for this process; older
+  // entries for the same OID are stale and skipped by the sweep.
+  uint64_t sweepGen{0};
   Process proc;
   NetworkFlowTable netflows;
   FileFlowTable fileflows;
   ProcessSet children;
   ProcessFlowObj *pfo;
+  // ancestor OIDs (parent first) resolved on the last full walk of the
+  // parent chain, along with the parent tid seen at that time. Each link is
+  // revalidated against the current libsinsp parent chain before the cache
+  // is replayed.
+  std::vector<OID> ancestors;
+  bool ancestorsValid{false};
+  int64_t ancestorsPtid{-1};
+  // bytes accounted in sfmemory for the process, and for the bucket arrays
+  // of its flow tables (tallied under the flow tables)
+  int64_t memBytes{0};
+  int64_t netflowBucketBytes{0};
+  int64_t fileflowBucketBytes{0};
+  // connection summaries held for the process in the current interval
+  uint32_t netSummaries{0};
+  // per feature state, see sfmemory::getExt()
+  std::unique_ptr<ProcessExt> ext;
+  inline ContainerRollup *getRollup() const {
+    return (ext != nullptr) ? ext->rollup : nullptr;
+  }
+  inline void invalidateAncestors() {
+    ancestors.clear();
+    ancestorsValid = false;
+  }
   ProcessObj() : proc(), netflows(), fileflows(), children(), pfo(nullptr) {
     NFKey *emptykey = utils::getNFEmptyKey();
     NFKey *delkey = utils::getNFDelKey();
@@ -254,18 +493,21 @@ struct eqpfobj {
   }
 };
 typedef std::multiset<ProcessObj *, eqpfobj> ProcessFlowSet;
-typedef google::dense_hash_map<OID *, ProcessObj *, XXHasher<OID *>, eqoidptr>
-    ProcessTable;
+// processes are keyed by value so lookups compare OIDs in the table slots
+// rather than chasing a pointer into each ProcessObj
+typedef sftable::HashMap<OID, ProcessObj *, XXHasher<OID>, eqoid> ProcessTable;
+typedef sftable::SlabPool<ProcessObj> ProcessPool;
 
 class PodObj {
 public:
-  bool written;
+  uint64_t generation;
   Pod pod;
   uint32_t refs;
+  int64_t memBytes{0};
   PodObj(std::string id, std::string name, std::string nodeName,
          std::string hostIP, std::string internalIP, std::string ns,
          int64_t restartCount)
-      : written(false), pod(), refs(0) {
+      : generation(0), pod(), refs(0) {
     pod.id = id;
     pod.name = name;
     pod.nodeName = nodeName;
@@ -276,8 +518,15 @@ public:
   }
 };
 
-typedef google::dense_hash_map<std::string, std::shared_ptr<PodObj>,
-                               XXHasher<std::string>, eqstr>
+typedef sftable::HashMap<std::string, std::shared_ptr<PodObj>,
+                         XXHasher<std::string>, eqstr>
     PodTable;
 
+// queues of table entries awaiting garbage collection, along with the writer
+// generation at which each entry was queued.
+typedef std::deque<std::pair<OID, uint64_t>> ProcessSweepQueue;
+typedef std::deque<std::pair<FileObj *, uint64_t>> FileSweepQueue;
+typedef std::deque<std::pair<ContainerObj *, uint64_t>> ContainerSweepQueue;
+typedef std::deque<std::pair<std::string, uint64_t>> PodSweepQueue;
+
 #endif
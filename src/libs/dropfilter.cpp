@@ -0,0 +1,266 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#include "dropfilter.h"
+#include "sysflowexception.h"
+#include <fstream>
+#include <sstream>
+
+using dropfilter::DropFilter;
+using dropfilter::PathTrie;
+
+CREATE_LOGGER(DropFilter, "sysflow.dropfilter");
+
+uint32_t PathTrie::child(uint32_t node, char c) const {
+  for (const auto &child : m_nodes[node].children) {
+    if (child.first == c) {
+      return child.second;
+    }
+  }
+  return 0;
+}
+
+int PathTrie::insert(const std::string &prefix, int rule) {
+  uint32_t cur = 0;
+  for (char c : prefix) {
+    uint32_t next = child(cur, c);
+    if (next == 0) {
+      next = m_nodes.size();
+      m_nodes[cur].children.emplace_back(c, next);
+      m_nodes.emplace_back();
+    }
+    cur = next;
+  }
+  if (m_nodes[cur].rule < 0) {
+    m_nodes[cur].rule = rule;
+  }
+  return m_nodes[cur].rule;
+}
+
+// returns the shortest rule that is the whole path, or a prefix of it ending
+// with a '/' or followed by one
+int PathTrie::match(const std::string &path) const {
+  uint32_t cur = 0;
+  char last = '\0';
+  for (char c : path) {
+    if (m_nodes[cur].rule >= 0 && (c == '/' || last == '/')) {
+      return m_nodes[cur].rule;
+    }
+    cur = child(cur, c);
+    if (cur == 0) {
+      return -1;
+    }
+    last = c;
+  }
+  return m_nodes[cur].rule;
+}
+
+DropFilter::DropFilter(const std::string &rulesPath) : m_numDropped(0) {
+  m_exes.set_empty_key("-2");
+  m_exes.set_deleted_key("-1");
+  m_containers.set_empty_key("-2");
+  m_containers.set_deleted_key("-1");
+  m_ports.set_empty_key(UINT32_MAX);
+  m_ports.set_deleted_key(UINT32_MAX - 1);
+  m_uids.set_empty_key(UINT32_MAX);
+  m_uids.set_deleted_key(UINT32_MAX - 1);
+
+  std::ifstream rules(rulesPath);
+  if (!rules.is_open()) {
+    throw sfexception::SysFlowException(
+        std::string("Unable to open drop filter rules file '") + rulesPath +
+            std::string("'."),
+        sfexception::ErrorReadingFileSystem);
+  }
+
+  std::string line;
+  int lineNum = 0;
+  while (std::getline(rules, line)) {
+    lineNum++;
+    std::size_t comment = line.find('#');
+    if (comment != std::string::npos) {
+      line.erase(comment);
+    }
+    std::istringstream tokens(line);
+    std::string type;
+    std::string value;
+    if (!(tokens >> type)) {
+      continue;
+    }
+    if (!(tokens >> value)) {
+      throw sfexception::SysFlowException(
+          std::string("Drop filter rule '") + type +
+              std::string("' is missing a value at line ") +
+              std::to_string(lineNum),
+          sfexception::InvalidConfiguration);
+    }
+    addRule(type, value, lineNum);
+  }
+  SF_INFO(m_logger, "Loaded " << m_rules.size()
+                              << " drop filter rules from " << rulesPath)
+}
+
+DropFilter::~DropFilter() = default;
+
+void DropFilter::addRule(const std::string &type, const std::string &value,
+                         int line) {
+  int idx = m_rules.size();
+  uint32_t num = 0;
+  if (type == DROP_RULE_PORT || type == DROP_RULE_UID) {
+    char *end = nullptr;
+    errno = 0;
+    unsigned long l = strtoul(value.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0' ||
+        (type == DROP_RULE_PORT && l > UINT16_MAX) || l >= UINT32_MAX - 1) {
+      throw sfexception::SysFlowException(
+          std::string("Invalid drop filter value '") + value +
+              std::string("' at line ") + std::to_string(line),
+          sfexception::InvalidConfiguration);
+    }
+    num = static_cast<uint32_t>(l);
+  }
+
+  // duplicate rules are kept once, so that each rule has a single hit count
+  DropRuleType ruleType;
+  bool added = false;
+  if (type == DROP_RULE_EXE) {
+    ruleType = DropExe;
+    added = m_exes.insert(std::make_pair(value, idx)).second;
+  } else if (type == DROP_RULE_CONTAINER) {
+    ruleType = DropContainer;
+    added = m_containers.insert(std::make_pair(value, idx)).second;
+  } else if (type == DROP_RULE_PATH) {
+    ruleType = DropPath;
+    added = (m_paths.insert(value, idx) == idx);
+  } else if (type == DROP_RULE_PORT) {
+    ruleType = DropPort;
+    added = m_ports.insert(std::make_pair(num, idx)).second;
+  } else if (type == DROP_RULE_UID) {
+    ruleType = DropUID;
+    added = m_uids.insert(std::make_pair(num, idx)).second;
+  } else {
+    throw sfexception::SysFlowException(
+        std::string("Unknown drop filter rule type '") + type +
+            std::string("' at line ") + std::to_string(line),
+        sfexception::InvalidConfiguration);
+  }
+  if (added) {
+    m_rules.push_back({ruleType, value, 0});
+  } else {
+    SF_INFO(m_logger, "Ignoring duplicate drop filter rule '"
+                          << type << " " << value << "' at line " << line)
+  }
+}
+
+bool DropFilter::matchPort(sinsp_fdinfo_t *fdinfo) {
+  uint16_t sport = 0;
+  uint16_t dport = 0;
+  if (fdinfo->is_ipv4_socket()) {
+    sport = fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sport;
+    dport = fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dport;
+  } else if (fdinfo->is_ipv6_socket()) {
+    sport = fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sport;
+    dport = fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dport;
+  } else {
+    return false;
+  }
+  DropIntTable::iterator it = m_ports.find(sport);
+  if (it == m_ports.end()) {
+    it = m_ports.find(dport);
+  }
+  if (it != m_ports.end()) {
+    return hit(it->second);
+  }
+  return false;
+}
+
+bool DropFilter::dropEvent(sinsp_evt *ev) {
+  sinsp_threadinfo *ti = ev->get_thread_info();
+  if (ti == nullptr) {
+    return false;
+  }
+
+  // process exits always go through so that already tracked processes are
+  // cleaned up from the tables
+  uint16_t type = ev->get_type();
+  if (type == PPME_PROCEXIT_E || type == PPME_PROCEXIT_X ||
+      type == PPME_PROCEXIT_1_E || type == PPME_PROCEXIT_1_X) {
+    return false;
+  }
+
+  if (!m_containers.empty() && !ti->m_container_id.empty()) {
+    DropStringTable::iterator it = m_containers.find(ti->m_container_id);
+    if (it != m_containers.end()) {
+      return hit(it->second);
+    }
+  }
+
+  if (!m_uids.empty()) {
+    DropIntTable::iterator it = m_uids.find(ti->m_user.uid);
+    if (it != m_uids.end()) {
+      return hit(it->second);
+    }
+  }
+
+  if (!m_exes.empty()) {
+    sinsp_threadinfo *mt = ti->get_main_thread();
+    if (mt == nullptr) {
+      mt = ti;
+    }
+    DropStringTable::iterator it = m_exes.find(mt->m_exepath);
+    if (it == m_exes.end()) {
+      it = m_exes.find(mt->m_exe);
+    }
+    if (it != m_exes.end()) {
+      return hit(it->second);
+    }
+  }
+
+  if (m_ports.empty() && m_paths.empty()) {
+    return false;
+  }
+
+  sinsp_fdinfo_t *fdinfo = ev->get_fd_info();
+  if (fdinfo == nullptr) {
+    return false;
+  }
+
+  if (!m_ports.empty() && matchPort(fdinfo)) {
+    return true;
+  }
+
+  if (!m_paths.empty() && !fdinfo->m_name.empty()) {
+    int rule = m_paths.match(fdinfo->m_name);
+    if (rule >= 0) {
+      return hit(rule);
+    }
+  }
+  return false;
+}
+
+void DropFilter::printStats() {
+  static const char *types[] = {DROP_RULE_EXE, DROP_RULE_CONTAINER,
+                                DROP_RULE_PATH, DROP_RULE_PORT, DROP_RULE_UID};
+  SF_INFO(m_logger, "Drop Filter: " << m_numDropped << " events dropped")
+  for (const auto &rule : m_rules) {
+    SF_INFO(m_logger, "Drop Filter Rule: " << types[rule.type] << " "
+                                           << rule.value
+                                           << " Hits: " << rule.hits)
+  }
+}
@@ -0,0 +1,103 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#ifndef _SF_DROP_FILTER_
+#define _SF_DROP_FILTER_
+#include "datatypes.h"
+#include "logger.h"
+#include <sinsp.h>
+#include <string>
+#include <vector>
+
+#define DROP_RULE_EXE "exe"
+#define DROP_RULE_CONTAINER "container"
+#define DROP_RULE_PATH "path"
+#define DROP_RULE_PORT "port"
+#define DROP_RULE_UID "uid"
+
+namespace dropfilter {
+
+enum DropRuleType { DropExe, DropContainer, DropPath, DropPort, DropUID };
+
+struct DropRule {
+  DropRuleType type;
+  std::string value;
+  uint64_t hits;
+};
+
+typedef google::dense_hash_map<std::string, int, XXHasher<std::string>, eqstr>
+    DropStringTable;
+typedef google::dense_hash_map<uint32_t, int> DropIntTable;
+
+// Byte-wise prefix trie over path rules. Each node stores its children as a
+// small vector since path prefixes share long common stems and fan out little.
+// Prefixes only match at path component boundaries: /var/log matches
+// /var/log and /var/log/syslog, but not /var/logfoo.
+class PathTrie {
+private:
+  struct Node {
+    int rule{-1};
+    std::vector<std::pair<char, uint32_t>> children;
+  };
+  std::vector<Node> m_nodes;
+  uint32_t child(uint32_t node, char c) const;
+
+public:
+  PathTrie() : m_nodes(1) {}
+  // returns the rule already stored for the prefix, or else stores and
+  // returns the given rule
+  int insert(const std::string &prefix, int rule);
+  int match(const std::string &path) const;
+  inline bool empty() const { return m_nodes.size() == 1; }
+};
+
+// Drops events of noisy processes, containers, paths and ports before any
+// table lookup or flow update takes place. Rules are loaded once at startup
+// and matched with constant-time hash lookups (exe, container, port, uid) or a
+// single trie walk (path prefix).
+class DropFilter {
+private:
+  std::vector<DropRule> m_rules;
+  DropStringTable m_exes;
+  DropStringTable m_containers;
+  DropIntTable m_ports;
+  DropIntTable m_uids;
+  PathTrie m_paths;
+  uint64_t m_numDropped;
+  DEFINE_LOGGER();
+  void addRule(const std::string &type, const std::string &value, int line);
+  inline bool hit(int rule) {
+    m_rules[rule].hits++;
+    m_numDropped++;
+    return true;
+  }
+  bool matchPort(sinsp_fdinfo_t *fdinfo);
+
+public:
+  explicit DropFilter(const std::string &rulesPath);
+  virtual ~DropFilter();
+  bool dropEvent(sinsp_evt *ev);
+  void printStats();
+  inline const std::vector<DropRule> &getRules() { return m_rules; }
+  inline uint64_t getNumDropped() { return m_numDropped; }
+  inline bool isEmpty() { return m_rules.empty(); }
+};
+} // namespace dropfilter
+
+#endif
@@ -22,12 +22,17 @@
 
 using file::FileContext;
 
-FileContext::FileContext(container::ContainerContext *containerCxt,
-                         writer::SysFlowWriter *writer) {
+FileContext::FileContext(context::SysFlowContext *cxt,
+                         container::ContainerContext *containerCxt,
+                         writer::SysFlowWriter *writer)
+    : m_files(cxt->getFileTableSize()) {
+  m_cxt = cxt;
   m_writer = writer;
   m_containerCxt = containerCxt;
   m_files.set_empty_key("-1");
   m_files.set_deleted_key("-2");
+  sftable::configure(m_files, m_cxt->getFileTableSize(),
+                     m_cxt->getTableMaxLoad());
 }
 
 FileContext::~FileContext() { clearAllFiles(); }
@@ -67,11 +72,12 @@ FileObj *FileContext::getFile(sinsp_evt *ev, const std::string &path,
   key.reserve(ti->m_container_id.length() + path.length());
   key += ti->m_container_id;
   key += path;
+  uint64_t gen = m_writer->getGeneration();
   FileTable::iterator f = m_files.find(key);
   FileObj *file = nullptr;
   if (f != m_files.end()) {
     created = false;
-    if (f->second->written) {
+    if (f->second->generation == gen) {
       return f->second;
     }
     file = f->second;
@@ -79,20 +85,22 @@ FileObj *FileContext::getFile(sinsp_evt *ev, const std::string &path,
   }
   if (file == nullptr) {
     file = createFile(ev, path, typechar, state, key);
+    m_files[file->key] = file;
+    m_sweepQue.emplace_back(file, gen);
+    sfmemory::account(sfmemory::MemFile, file);
   }
-  m_files[key] = file;
   m_writer->writeFile(&(file->file));
-  file->written = true;
+  file->generation = gen;
   return file;
 }
 
 FileObj *FileContext::getFile(const std::string &key) {
   FileTable::iterator f = m_files.find(key);
   if (f != m_files.end()) {
-    if (!f->second->written) {
+    if (f->second->generation != m_writer->getGeneration()) {
       f->second->file.state = SFObjectState::REUP;
       m_writer->writeFile(&(f->second->file));
-      f->second->written = true;
+      f->second->generation = m_writer->getGeneration();
     }
     return f->second;
   }
@@ -102,30 +110,38 @@ FileObj *FileContext::getFile(const std::string &key) {
 FileObj *FileContext::exportFile(const std::string &key) {
   FileTable::iterator f = m_files.find(key);
   if (f != m_files.end()) {
-    if (!f->second->written) {
+    if (f->second->generation != m_writer->getGeneration()) {
       f->second->file.state = SFObjectState::REUP;
       m_writer->writeFile(&(f->second->file));
-      f->second->written = true;
+      f->second->generation = m_writer->getGeneration();
     }
     return f->second;
   }
   return nullptr;
 }
 
-void FileContext::clearFiles() {
-  for (FileTable::iterator it = m_files.begin(); it != m_files.end(); ++it) {
-    if (it->second->refs == 0) {
-      FileObj *file = it->second;
-      m_files.erase(it);
+int FileContext::sweepFiles(int budget) {
+  uint64_t gen = m_writer->getGeneration();
+  int deleted = 0;
+  while (budget > 0 && !m_sweepQue.empty() && m_sweepQue.front().second < gen) {
+    FileObj *file = m_sweepQue.front().first;
+    m_sweepQue.pop_front();
+    budget--;
+    if (file->refs == 0 && file->generation != gen) {
+      m_files.erase(file->key);
+      sfmemory::release(sfmemory::MemFile, file);
       delete file;
+      deleted++;
     } else {
-      it->second->written = false;
+      m_sweepQue.emplace_back(file, gen);
     }
   }
+  return deleted;
 }
 
 void FileContext::clearAllFiles() {
   for (FileTable::iterator it = m_files.begin(); it != m_files.end(); ++it) {
+    sfmemory::release(sfmemory::MemFile, it->second);
     delete it->second;
   }
 }
@@ -21,6 +21,7 @@
 #define _SF_FILE_
 #include "containercontext.h"
 #include "datatypes.h"
+#include "sfmemory.h"
 #include "sysflow.h"
 #include "sysflowwriter.h"
 
@@ -29,13 +30,16 @@ using sysflow::SFObjectState;
 namespace file {
 class FileContext {
 private:
+  context::SysFlowContext *m_cxt;
   writer::SysFlowWriter *m_writer;
   FileTable m_files;
+  FileSweepQueue m_sweepQue;
   container::ContainerContext *m_containerCxt;
   void clearAllFiles();
 
 public:
-  FileContext(container::ContainerContext *containerCxt,
+  FileContext(context::SysFlowContext *cxt,
+              container::ContainerContext *containerCxt,
               writer::SysFlowWriter *writer);
   virtual ~FileContext();
   FileObj *getFile(sinsp_evt *ev, sinsp_fdinfo_t *fdinfo, SFObjectState state,
@@ -46,8 +50,15 @@ public:
   FileObj *createFile(sinsp_evt *ev, std::string path, char typechar,
                       SFObjectState state, std::string key);
   FileObj *exportFile(const std::string &key);
-  void clearFiles();
+  int sweepFiles(int budget);
   inline int getSize() { return m_files.size(); }
+  inline int64_t getMemBytes() {
+    return sfmemory::g_memory.bytes[sfmemory::MemFile] +
+           sfmemory::bucketBytes(m_files);
+  }
+  inline bool shrinkTable() {
+    return sftable::shrink(m_files, m_cxt->getFileTableSize());
+  }
 };
 } // namespace file
 
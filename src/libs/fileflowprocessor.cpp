@@ -18,7 +18,10 @@
  **/
 
 #include "fileflowprocessor.h"
+#include "sfexport.h"
+#include "sfmetrics.h"
 #include "utils.h"
+#include <algorithm>
 #include <boost/stacktrace.hpp>
 #include <utility>
 
@@ -36,9 +39,51 @@ FileFlowProcessor::FileFlowProcessor(context::SysFlowContext *cxt,
   m_processCxt = processCxt;
   m_dfSet = dfSet;
   m_fileCxt = fileCxt;
+  m_lastCoalesceWrite = 0;
+  m_mmapGeneration = 0;
+  m_mmapFiles.set_empty_key("-1");
+  m_mmapFiles.set_deleted_key("-2");
 }
 
-FileFlowProcessor::~FileFlowProcessor() = default;
+FileFlowProcessor::~FileFlowProcessor() { clearMmapFiles(); }
+
+void FileFlowProcessor::clearMmapFiles() {
+  for (auto &f : m_mmapFiles) {
+    f.second->refs--;
+  }
+  m_mmapFiles.clear();
+}
+
+int FileFlowProcessor::dedupMmap(sinsp_evt *ev, sinsp_fdinfo_t *fdinfo,
+                                 int64_t fd) {
+  uint64_t gen = m_writer->getGeneration();
+  if (gen != m_mmapGeneration) {
+    clearMmapFiles();
+    m_mmapGeneration = gen;
+  }
+  sinsp_threadinfo *ti = ev->get_thread_info();
+  m_mmapKey.clear();
+  m_mmapKey += ti->m_container_id;
+  m_mmapKey += fdinfo->m_name;
+  bool created = false;
+  // the process is written (and kept in the table) even when the map is only
+  // counted, so that its counts refer to a Process record of the file
+  ProcessObj *proc = m_processCxt->getProcess(ev, SFObjectState::REUP, created);
+  if (m_mmapFiles.find(m_mmapKey) != m_mmapFiles.end()) {
+    // counted for the process and written with its next flow
+    m_writer->addCount(proc->proc.oid, sfsummary::CountMmaps);
+    sfmetrics::g_metrics.dedupedMmaps++;
+    return 0;
+  }
+  FileObj *file = m_fileCxt->getFile(ev, fdinfo, SFObjectState::REUP, created);
+  FileFlowObj ffobj;
+  populateFileFlow(&ffobj, OP_MMAP, ev, proc, file, fdinfo->m_name, fdinfo, fd);
+  ffobj.fileflow.endTs = ev->get_ts();
+  SHOULD_WRITE((&ffobj), &(proc->proc), &(file->file))
+  file->refs++;
+  m_mmapFiles[file->key] = file;
+  return 0;
+}
 
 inline void FileFlowProcessor::populateFileFlow(
     FileFlowObj *ff, OpFlags flag, sinsp_evt *ev, ProcessObj *proc,
@@ -75,7 +120,7 @@ void FileFlowProcessor::removeAndWriteRelatedFlows(ProcessObj *proc,
                                                    uint64_t endTs) {
   std::vector<FileFlowObj *> ffobjs;
   for (FileFlowTable::iterator ffi = proc->fileflows.begin();
-       ffi != proc->fileflows.end(); ffi++) {
+       ffi != proc->fileflows.end();) {
     if (ffi->second->fileflow.tid != ffo->fileflow.tid &&
         ffi->second->fileflow.fd == ffo->fileflow.fd &&
         ffi->second->filekey.compare(ffo->filekey) == 0) {
@@ -86,7 +131,9 @@ void FileFlowProcessor::removeAndWriteRelatedFlows(ProcessObj *proc,
       }
       SF_DEBUG(m_logger, "Removing related file flow on thread: "
                              << ffi->second->fileflow.tid);
-      proc->fileflows.erase(ffi);
+      ffi = sftable::eraseNext(proc->fileflows, ffi);
+    } else {
+      ffi++;
     }
   }
   for (auto it = ffobjs.begin(); it != ffobjs.end(); it++) {
@@ -102,7 +149,13 @@ void FileFlowProcessor::removeAndWriteRelatedFlows(ProcessObj *proc,
 
 inline void FileFlowProcessor::updateFileFlow(FileFlowObj *ff, OpFlags flag,
                                               sinsp_evt *ev,
-                                              sinsp_fdinfo_t *fdinfo) {
+                                              sinsp_fdinfo_t *fdinfo,
+                                              ProcessObj *proc) {
+  ContainerRollup *rollup = proc->getRollup();
+  if (rollup != nullptr && flag == OP_WRITE_SEND &&
+      (ff->fileflow.opFlags & OP_WRITE_SEND) == 0) {
+    rollup->filesWritten++;
+  }
   ff->fileflow.opFlags |= flag;
   ff->lastUpdate = utils::getCurrentTime(m_cxt);
   if (flag == OP_OPEN) {
@@ -113,12 +166,18 @@ inline void FileFlowProcessor::updateFileFlow(FileFlowObj *ff, OpFlags flag,
     if (res > 0) {
       ff->fileflow.numWSendBytes += res;
     }
+    if (rollup != nullptr) {
+      rollup->fileWrite.add(res);
+    }
   } else if (flag == OP_READ_RECV) {
     ff->fileflow.numRRecvOps++;
     int res = utils::getSyscallResult(ev);
     if (res > 0) {
       ff->fileflow.numRRecvBytes += res;
     }
+    if (rollup != nullptr) {
+      rollup->fileRead.add(res);
+    }
   }
 }
 
@@ -131,16 +190,24 @@ inline void FileFlowProcessor::processNewFlow(sinsp_evt *ev, ProcessObj *proc,
   ff->exportTime = utils::getCurrentTime(m_cxt);
   ff->lastUpdate = utils::getCurrentTime(m_cxt);
   populateFileFlow(ff, flag, ev, proc, file, flowkey, fdinfo, fd);
-  updateFileFlow(ff, flag, ev, fdinfo);
+  if (m_cxt->isFanOut()) {
+    m_processCxt->addFanOutFile(proc, file->file.path);
+  }
+  updateFileFlow(ff, flag, ev, fdinfo, proc);
   if (flag != OP_CLOSE) {
     proc->fileflows[ff->flowkey] = ff;
     file->refs++;
     m_dfSet->insert(ff);
+    sfmemory::account(sfmemory::MemFileFlow, ff);
+    sfmemory::accountSubtables(proc);
   } else {
     removeAndWriteRelatedFlows(proc, ff, ev->get_ts());
     ff->fileflow.endTs = ev->get_ts();
     // m_writer->writeFileFlow(&(ff->fileflow));
-    SHOULD_WRITE(ff, &(proc->proc), &(file->file))
+    FILTER_READ(ff, filtered)
+    if (!filtered && !coalesceFlow(proc, file, ff)) {
+      m_writer->writeFileFlow(&(ff->fileflow), &(proc->proc), &(file->file));
+    }
     delete ff;
   }
 }
@@ -173,7 +240,10 @@ inline void FileFlowProcessor::removeAndWriteFileFlow(ProcessObj *proc,
                                                       FileFlowObj **ff,
                                                       std::string flowkey) {
   // m_writer->writeFileFlow(&((*ff)->fileflow));
-  SHOULD_WRITE((*ff), &(proc->proc), &(file->file))
+  FILTER_READ((*ff), filtered)
+  if (!filtered && !coalesceFlow(proc, file, *ff)) {
+    m_writer->writeFileFlow(&((*ff)->fileflow), &(proc->proc), &(file->file));
+  }
   removeFileFlowFromSet(ff, false);
   removeFileFlow(proc, file, ff, std::move(flowkey));
 }
@@ -181,7 +251,7 @@ inline void FileFlowProcessor::removeAndWriteFileFlow(ProcessObj *proc,
 inline void FileFlowProcessor::processExistingFlow(
     sinsp_evt *ev, ProcessObj *proc, FileObj *file, OpFlags flag,
     std::string flowkey, FileFlowObj *ff, sinsp_fdinfo_t *fdinfo) {
-  updateFileFlow(ff, flag, ev, fdinfo);
+  updateFileFlow(ff, flag, ev, fdinfo, proc);
   if (flag == OP_CLOSE) {
     removeAndWriteRelatedFlows(proc, ff, ev->get_ts());
     ff->fileflow.endTs = ev->get_ts();
@@ -189,6 +259,79 @@ inline void FileFlowProcessor::processExistingFlow(
   }
 }
 
+bool FileFlowProcessor::coalesceFlow(ProcessObj *proc, FileObj *file,
+                                     FileFlowObj *ff) {
+  if (!m_cxt->isFileCoalesce()) {
+    return false;
+  }
+  std::vector<FFCoalescedObj *> &coalesced = sfmemory::getExt(proc)->coalesced;
+  for (FFCoalescedObj *c : coalesced) {
+    if (c->fileflow.openFlags != ff->fileflow.openFlags ||
+        c->filekey != ff->filekey) {
+      continue;
+    }
+    FileFlow &sum = c->fileflow;
+    // threads and fds that differ across the merged flows are cleared
+    if (sum.tid != ff->fileflow.tid) {
+      sum.tid = 0;
+    }
+    if (sum.fd != ff->fileflow.fd) {
+      sum.fd = -1;
+    }
+    sum.ts = std::min(sum.ts, ff->fileflow.ts);
+    sum.endTs = std::max(sum.endTs, ff->fileflow.endTs);
+    sum.opFlags |= ff->fileflow.opFlags;
+    sum.numRRecvOps += ff->fileflow.numRRecvOps;
+    sum.numWSendOps += ff->fileflow.numWSendOps;
+    sum.numRRecvBytes += ff->fileflow.numRRecvBytes;
+    sum.numWSendBytes += ff->fileflow.numWSendBytes;
+    c->flows++;
+    sfmetrics::g_metrics.coalescedFlows++;
+    return true;
+  }
+  if (coalesced.size() >=
+      static_cast<size_t>(m_cxt->getFileCoalesceMax())) {
+    sfmetrics::g_metrics.coalesceOverflows++;
+    return false;
+  }
+  if (coalesced.empty()) {
+    m_coalescedProcs.push_back(proc->proc.oid);
+  }
+  auto *c = new FFCoalescedObj();
+  c->fileflow = ff->fileflow;
+  c->filekey = ff->filekey;
+  c->flows = 1;
+  coalesced.push_back(c);
+  file->refs++;
+  sfmemory::account(sfmemory::MemFileFlow, c);
+  sfmetrics::g_metrics.coalescedFlows++;
+  return true;
+}
+
+int FileFlowProcessor::writeCoalescedFlows() {
+  int written = 0;
+  for (OID &oid : m_coalescedProcs) {
+    ProcessObj *proc = m_processCxt->getProcess(&oid);
+    if (proc != nullptr) {
+      written += m_processCxt->writeCoalescedFlows(proc);
+    }
+  }
+  m_coalescedProcs.clear();
+  return written;
+}
+
+int FileFlowProcessor::checkCoalescedFlows(time_t now) {
+  if (m_lastCoalesceWrite == 0) {
+    m_lastCoalesceWrite = now;
+    return 0;
+  }
+  if (difftime(now, m_lastCoalesceWrite) < m_cxt->getNFExportInterval()) {
+    return 0;
+  }
+  m_lastCoalesceWrite = now;
+  return writeCoalescedFlows();
+}
+
 int FileFlowProcessor::handleFileFlowEvent(sinsp_evt *ev, OpFlags flag) {
   sinsp_fdinfo_t *fdinfo = ev->get_fd_info();
   int64_t fd = ev->get_fd_num();
@@ -237,6 +380,10 @@ int FileFlowProcessor::handleFileFlowEvent(sinsp_evt *ev, OpFlags flag) {
     return 1;
   }
 
+  if (flag == OP_MMAP && m_cxt->isMmapDedup()) {
+    return dedupMmap(ev, fdinfo, fd);
+  }
+
   bool created = false;
   // calling get process is important because it ensures that the process object
   // has been written to the sysflow file. This is important for long running
@@ -277,6 +424,7 @@ void FileFlowProcessor::removeFileFlow(ProcessObj *proc, FileObj *file,
                                        FileFlowObj **ff,
                                        const std::string &flowkey) {
   proc->fileflows.erase(flowkey);
+  sfmemory::release(sfmemory::MemFileFlow, *ff);
   delete *ff;
   ff = nullptr;
   if (file != nullptr) {
@@ -288,36 +436,41 @@ int FileFlowProcessor::removeAndWriteFFFromProc(ProcessObj *proc, int64_t tid) {
   SF_DEBUG(m_logger, "CALLING removeAndWriteFFFromProc");
   int deleted = 0;
 
+  // the flows are taken out of the table before writing them, since writing
+  // related flows erases other entries from the table
+  std::vector<FileFlowObj *> ffobjs;
   for (FileFlowTable::iterator ffi = proc->fileflows.begin();
-       ffi != proc->fileflows.end(); ffi++) {
+       ffi != proc->fileflows.end();) {
     if (tid == -1 || tid == ffi->second->fileflow.tid) {
-      FileObj *file = m_fileCxt->getFile(ffi->second->filekey);
-      ffi->second->fileflow.endTs = utils::getSinspTime(m_cxt);
-      if (tid != -1) {
-        removeAndWriteRelatedFlows(proc, ffi->second,
-                                   ffi->second->fileflow.endTs);
-      }
-      ffi->second->fileflow.opFlags |= OP_TRUNCATE;
-      SF_DEBUG(m_logger, "Writing FILEFLOW!");
-      SHOULD_WRITE(ffi->second, &(proc->proc), &(file->file))
-      // m_writer->writeFileFlow(&(ffi->second->fileflow));
-      FileFlowObj *ffo = ffi->second;
-      proc->fileflows.erase(ffi);
-      SF_DEBUG(m_logger, "Set size: " << m_dfSet->size());
-      deleted += removeFileFlowFromSet(&ffo, true);
-      SF_DEBUG(m_logger, "After Set size: " << m_dfSet->size());
-      if (file == nullptr) {
-        SF_ERROR(m_logger, "File object doesn't exist for fileflow: "
-                               << ffi->second->filekey
-                               << ". This shouldn't happen.");
-      } else {
-        file->refs--;
-      }
+      ffobjs.push_back(ffi->second);
+      ffi = sftable::eraseNext(proc->fileflows, ffi);
+    } else {
+      ffi++;
     }
   }
 
+  for (FileFlowObj *ffo : ffobjs) {
+    FileObj *file = m_fileCxt->getFile(ffo->filekey);
+    ffo->fileflow.endTs = utils::getSinspTime(m_cxt);
+    if (tid != -1) {
+      removeAndWriteRelatedFlows(proc, ffo, ffo->fileflow.endTs);
+    }
+    ffo->fileflow.opFlags |= OP_TRUNCATE;
+    SF_DEBUG(m_logger, "Writing FILEFLOW!");
+    SHOULD_WRITE(ffo, &(proc->proc), &(file->file))
+    // m_writer->writeFileFlow(&(ffo->fileflow));
+    if (file == nullptr) {
+      SF_ERROR(m_logger, "File object doesn't exist for fileflow: "
+                             << ffo->filekey << ". This shouldn't happen.");
+    } else {
+      file->refs--;
+    }
+    SF_DEBUG(m_logger, "Set size: " << m_dfSet->size());
+    deleted += removeFileFlowFromSet(&ffo, true);
+    SF_DEBUG(m_logger, "After Set size: " << m_dfSet->size());
+  }
   if (tid == -1) {
-    proc->fileflows.clear();
+    m_processCxt->writeCoalescedFlows(proc);
   }
 
   return deleted;
@@ -335,6 +488,7 @@ int FileFlowProcessor::removeFileFlowFromSet(FileFlowObj **ffo,
         SF_DEBUG(m_logger, "Removing fileflow element from multiset");
         m_dfSet->erase(iter);
         if (deleteFileFlow) {
+          sfmemory::release(sfmemory::MemFileFlow, *ffo);
           delete *ffo;
           ffo = nullptr;
         }
@@ -374,6 +528,7 @@ int FileFlowProcessor::removeFileFlowFromSet(FileFlowObj **ffo,
 
     if (deleteFileFlow) {
       SF_ERROR(m_logger, "Deleting File Flow...");
+      sfmemory::release(sfmemory::MemFileFlow, *ffo);
       delete *ffo;
       ffo = nullptr;
       SF_ERROR(m_logger, "Deleted File Flow...");
@@ -396,22 +551,49 @@ void FileFlowProcessor::removeFileFlow(DataFlowObj *dfo) {
                                               << ffo->fileflow.procOID.createTS
                                               << " This shouldn't happen!");
   } else {
-    FileObj *file = m_fileCxt->getFile(ffo->filekey);
+    // intervals held back by the export policy are written before expiring,
+    // after the process and file (as in exportFileFlow) since the last
+    // record of the flow may be in an earlier output file
+    bool flush = (ffo->skippedExports > 0);
+    if (flush) {
+      ffo->fileflow.endTs = utils::getSinspTime(m_cxt);
+      m_processCxt->exportProcess(&(ffo->fileflow.procOID));
+    }
+    FileObj *file = flush ? m_fileCxt->exportFile(ffo->filekey)
+                          : m_fileCxt->getFile(ffo->filekey);
     if (file == nullptr) {
       SF_ERROR(m_logger, "Unable to find file object of key "
                              << ffo->filekey << ". Shouldn't happen!");
     }
+    if (flush) {
+      SHOULD_WRITE(ffo, &(proc->proc),
+                   ((file != nullptr) ? &(file->file) : nullptr))
+    }
     removeFileFlow(proc, file, &ffo, ffo->flowkey);
   }
 }
 
 void FileFlowProcessor::exportFileFlow(DataFlowObj *dfo, time_t /*now*/) {
   auto *ffo = static_cast<FileFlowObj *>(dfo);
+  SFExportPolicy policy = m_cxt->getFileFlowExport();
+  bool active = (ffo->fileflow.numRRecvOps + ffo->fileflow.numWSendOps) > 0;
+  if (sfexport::skipExport(ffo, policy, m_cxt->getFileFlowKeepAlive(),
+                           active)) {
+    SF_DEBUG(m_logger, "Skipping periodic export of file flow");
+    return;
+  }
   ffo->fileflow.endTs = utils::getSinspTime(m_cxt);
   ProcessObj *proc = m_processCxt->exportProcess(&(ffo->fileflow.procOID));
   FileObj *file = m_fileCxt->exportFile(ffo->filekey);
+  sfexport::CapStrings caps;
+  if (policy == SFExportPolicy::SFExportHeartbeat) {
+    caps.take(ffo->fileflow);
+  }
   SHOULD_WRITE(ffo, ((proc != nullptr) ? &(proc->proc) : nullptr),
                ((file != nullptr) ? &(file->file) : nullptr))
+  if (policy == SFExportPolicy::SFExportHeartbeat) {
+    caps.restore(ffo->fileflow);
+  }
   // m_writer->writeFileFlow(&(ffo->fileflow));
   SF_DEBUG(m_logger, "Reupping flow");
   ffo->fileflow.ts = utils::getSinspTime(m_cxt);
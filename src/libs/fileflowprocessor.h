@@ -40,11 +40,21 @@ private:
   writer::SysFlowWriter *m_writer;
   DataFlowSet *m_dfSet;
   file::FileContext *m_fileCxt;
+  // processes holding coalesced flows
+  std::vector<OID> m_coalescedProcs;
+  time_t m_lastCoalesceWrite;
+  // files mapped in the current writer generation, holding a file ref
+  FileTable m_mmapFiles;
+  uint64_t m_mmapGeneration;
+  // scratch buffer for the mmap dedup key
+  std::string m_mmapKey;
+  void clearMmapFiles();
+  int dedupMmap(sinsp_evt *ev, sinsp_fdinfo_t *fdinfo, int64_t fd);
   void populateFileFlow(FileFlowObj *ff, OpFlags flag, sinsp_evt *ev,
                         ProcessObj *proc, FileObj *file, std::string flowkey,
                         sinsp_fdinfo_t *fdinfo, int64_t fd);
   void updateFileFlow(FileFlowObj *ff, OpFlags flag, sinsp_evt *ev,
-                      sinsp_fdinfo_t *fdinfo);
+                      sinsp_fdinfo_t *fdinfo, ProcessObj *proc);
   void processExistingFlow(sinsp_evt *ev, ProcessObj *proc, FileObj *file,
                            OpFlags flag, std::string flowkey, FileFlowObj *ff,
                            sinsp_fdinfo_t *fdinfo);
@@ -58,6 +68,7 @@ private:
   int removeFileFlowFromSet(FileFlowObj **ffo, bool deleteFileFlow);
   void removeAndWriteRelatedFlows(ProcessObj *proc, FileFlowObj *ffo,
                                   uint64_t endTs);
+  bool coalesceFlow(ProcessObj *proc, FileObj *file, FileFlowObj *ff);
   int createConsumerRecord(sinsp_evt *ev, ProcessObj *proc, FileObj *file,
                            OpFlags flag, sinsp_fdinfo_t *fdinfo, int64_t fd);
   DEFINE_LOGGER();
@@ -72,6 +83,9 @@ public:
   int removeAndWriteFFFromProc(ProcessObj *proc, int64_t tid);
   void removeFileFlow(DataFlowObj *dfo);
   void exportFileFlow(DataFlowObj *dfo, time_t now);
+  // writes the coalesced flows once per export interval
+  int checkCoalescedFlows(time_t now);
+  int writeCoalescedFlows();
 };
 } // namespace fileflow
 #endif
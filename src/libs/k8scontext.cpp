@@ -25,11 +25,15 @@ CREATE_LOGGER(K8sContext, "sysflow.pod");
 
 K8sContext::K8sContext(context::SysFlowContext *cxt,
                        writer::SysFlowWriter *writer)
-    : m_pods(K8S_TABLE_SIZE) {
+    : m_pods(cxt->getPodTableSize()) {
   m_cxt = cxt;
   m_writer = writer;
   m_pods.set_empty_key("0");
   m_pods.set_deleted_key("");
+  sftable::configure(m_pods, m_cxt->getPodTableSize(),
+                     m_cxt->getTableMaxLoad());
+  m_containerPods.set_empty_key("0");
+  m_containerPods.set_deleted_key("");
 }
 
 K8sContext::~K8sContext() { clearAllPods(); }
@@ -46,11 +50,11 @@ bool K8sContext::exportPod(const std::string &id) {
   bool exprt = false;
   auto pod = m_pods.find(id);
   if (pod != m_pods.end()) {
-    if (!pod->second->written) {
+    if (pod->second->generation != m_writer->getGeneration()) {
       SF_DEBUG(m_logger,
                "Writing pod marked not written " << pod->second->pod.name)
       m_writer->writePod(&(pod->second->pod));
-      pod->second->written = true;
+      pod->second->generation = m_writer->getGeneration();
       exprt = true;
     }
   }
@@ -119,48 +123,90 @@ std::shared_ptr<PodObj> K8sContext::getPod(sinsp_threadinfo *ti) {
     return pod;
   }
 
+  uint64_t gen = m_writer->getGeneration();
+  auto cached = m_containerPods.find(ti->m_container_id);
+  if (cached != m_containerPods.end()) {
+    pod = cached->second;
+    if (pod != nullptr && pod->generation != gen) {
+      m_writer->writePod(&(pod->pod));
+      pod->generation = gen;
+    }
+    return pod;
+  }
+
   const k8s_state_t &k8sState =
       m_cxt->getInspector()->m_k8s_client->get_state();
 
   const k8s_pod_t *p = k8sState.get_pod(ti->m_container_id);
   if (p == nullptr) {
     SF_DEBUG(m_logger, "No pod for container " << ti->m_container_id)
+    m_containerPods[ti->m_container_id] = pod;
     return pod;
   }
 
   auto pitr = m_pods.find(p->get_uid());
   if (pitr != m_pods.end()) {
-    if (pitr->second->written) {
-      return pitr->second;
-    }
     pod = pitr->second;
+    m_containerPods[ti->m_container_id] = pod;
+    if (pod->generation == gen) {
+      return pod;
+    }
   }
 
   if (pod == nullptr) {
     pod = createPod(p, k8sState);
+    if (pod == nullptr) {
+      return nullptr;
+    }
+    m_pods[p->get_uid()] = pod;
+    m_sweepQue.emplace_back(p->get_uid(), gen);
+    sfmemory::account(sfmemory::MemPod, pod.get());
+    m_containerPods[ti->m_container_id] = pod;
   }
 
-  if (pod == nullptr) {
-    return nullptr;
-  }
-
-  m_pods[p->get_uid()] = pod;
   m_writer->writePod(&(pod->pod));
-  pod->written = true;
+  pod->generation = gen;
   return pod;
 }
 
-void K8sContext::clearPods() {
-  for (auto it = m_pods.begin(); it != m_pods.end(); ++it) {
-    if (it->second->refs == 0) {
-      m_pods.erase(it);
+int K8sContext::sweepPods(int budget) {
+  uint64_t gen = m_writer->getGeneration();
+  int deleted = 0;
+  while (budget > 0 && !m_sweepQue.empty() && m_sweepQue.front().second < gen) {
+    std::string uid = std::move(m_sweepQue.front().first);
+    m_sweepQue.pop_front();
+    budget--;
+    auto pod = m_pods.find(uid);
+    if (pod == m_pods.end()) {
+      continue;
+    }
+    if (pod->second->refs == 0 && pod->second->generation != gen) {
+      sfmemory::release(sfmemory::MemPod, pod->second.get());
+      m_pods.erase(pod);
+      deleted++;
+      invalidatePodCache();
     } else {
-      it->second->written = false;
+      m_sweepQue.emplace_back(std::move(uid), gen);
     }
   }
+  return deleted;
 }
 
-void K8sContext::clearAllPods() { m_pods.clear(); }
+void K8sContext::clearAllPods() {
+  for (auto it = m_pods.begin(); it != m_pods.end(); ++it) {
+    sfmemory::release(sfmemory::MemPod, it->second.get());
+  }
+  m_containerPods.clear();
+  m_pods.clear();
+}
+
+void K8sContext::invalidatePodCache() {
+  if (!m_containerPods.empty()) {
+    SF_DEBUG(m_logger, "Invalidating container to pod cache. Size: "
+                           << m_containerPods.size())
+    m_containerPods.clear();
+  }
+}
 
 void K8sContext::updateAndWritePodState(std::string &uid) {
   SF_DEBUG(m_logger, "Update and write pod state for modified pod: " << uid)
@@ -181,9 +227,11 @@ void K8sContext::updateAndWritePodState(std::string &uid) {
     std::shared_ptr<PodObj> podObj = createPod(pod, k8sState);
     if (podObj != nullptr) {
       podObj->refs = podO->refs;
+      sfmemory::release(sfmemory::MemPod, podO.get());
+      sfmemory::account(sfmemory::MemPod, podObj.get());
       m_pods[pod->get_uid()] = podObj;
       m_writer->writePod(&(podObj->pod));
-      podObj->written = true;
+      podObj->generation = m_writer->getGeneration();
     } else {
       SF_DEBUG(m_logger, "Unable to find pod with uid" << uid)
     }
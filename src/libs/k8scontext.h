@@ -25,18 +25,21 @@
 
 #include "datatypes.h"
 #include "logger.h"
+#include "sfmemory.h"
 #include "sysflow.h"
 #include "sysflowcontext.h"
 #include "sysflowwriter.h"
 #include <k8s.h>
 #include <sinsp.h>
 
-#define K8S_TABLE_SIZE 100
-
 namespace sfk8s {
 class K8sContext {
 private:
   PodTable m_pods;
+  PodSweepQueue m_sweepQue;
+  // container id to pod (or null when the container has no pod), so that pod
+  // attribution does not consult the k8s client state on every lookup.
+  PodTable m_containerPods;
   context::SysFlowContext *m_cxt;
   writer::SysFlowWriter *m_writer;
   std::shared_ptr<PodObj> createPod(const k8s_pod_t *p,
@@ -50,8 +53,17 @@ public:
   bool exportPod(const std::string &id);
   int derefPod(const std::string &id);
   void clearAllPods();
-  void clearPods();
+  int sweepPods(int budget);
+  void invalidatePodCache();
   inline int getSize() { return m_pods.size(); }
+  inline int64_t getMemBytes() {
+    return sfmemory::g_memory.bytes[sfmemory::MemPod] +
+           sfmemory::bucketBytes(m_pods) +
+           sfmemory::bucketBytes(m_containerPods);
+  }
+  inline bool shrinkTable() {
+    return sftable::shrink(m_pods, m_cxt->getPodTableSize());
+  }
   void updateCompState(sysflow::K8sAction action, sysflow::K8sComponent comp,
                        const Json::Value &root);
 
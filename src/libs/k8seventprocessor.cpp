@@ -113,6 +113,11 @@ int K8sEventProcessor::handleK8sEvent(sinsp_evt *ev) {
   if (reader.parse(payload, root, false)) {
     m_k8sEvt.action = this->getAction(root);
     m_k8sEvt.kind = this->getK8sComponent(root);
+    // pods and services change container to pod attribution
+    if (m_k8sEvt.kind == sysflow::K8sComponent::K8S_PODS ||
+        m_k8sEvt.kind == sysflow::K8sComponent::K8S_SERVICES) {
+      m_k8sCxt->invalidatePodCache();
+    }
     if (m_k8sEvt.action == sysflow::K8sAction::K8S_COMPONENT_MODIFIED &&
         (m_k8sEvt.kind == sysflow::K8sComponent::K8S_PODS ||
          m_k8sEvt.kind == sysflow::K8sComponent::K8S_SERVICES ||
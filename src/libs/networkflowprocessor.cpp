@@ -18,7 +18,10 @@
  **/
 
 #include "networkflowprocessor.h"
+#include "sfexport.h"
+#include "sfmetrics.h"
 #include "utils.h"
+#include <algorithm>
 
 using networkflow::NetworkFlowProcessor;
 
@@ -31,9 +34,21 @@ NetworkFlowProcessor::NetworkFlowProcessor(context::SysFlowContext *cxt,
   m_writer = writer;
   m_processCxt = processCxt;
   m_dfSet = dfSet;
+  m_lastSummaryWrite = 0;
+  NFSummaryKey emptyKey{};
+  NFSummaryKey delKey{};
+  emptyKey.oid = *utils::getOIDEmptyKey();
+  delKey.oid = *utils::getOIDDelKey();
+  m_summaries.set_empty_key(emptyKey);
+  m_summaries.set_deleted_key(delKey);
 }
 
-NetworkFlowProcessor::~NetworkFlowProcessor() = default;
+NetworkFlowProcessor::~NetworkFlowProcessor() {
+  for (auto &s : m_summaries) {
+    sfmemory::release(sfmemory::MemNetFlow, s.second);
+    delete s.second;
+  }
+}
 
 inline int32_t NetworkFlowProcessor::getProtocol(scap_l4_proto proto) {
   int32_t prt = -1;
@@ -69,6 +84,24 @@ inline void NetworkFlowProcessor::canonicalizeKey(sinsp_fdinfo_t *fdinfo,
   key->port1 = sport;
   key->ip2 = dip;
   key->port2 = dport;
+  aggregateKey(key, getProtocol(fdinfo->get_l4proto()));
+}
+
+// The tuple is ordered client first, so port1 is the client's (usually
+// ephemeral) port and ip2:port2 the server endpoint. Process aggregation keys
+// flows on (process, client ip, server ip, server port, protocol): the tables
+// are per process, the client port is dropped, and the fd slot, unused in
+// that mode, holds the protocol. For a client this is the remote endpoint;
+// for a server, the connecting host and the local service port.
+inline void NetworkFlowProcessor::aggregateKey(NFKey *key, int proto) {
+  SFFlowAggregation aggregation = m_cxt->getFlowAggregation();
+  if (aggregation != SFFlowAggregation::SFThreadFlows) {
+    key->tid = 0;
+  }
+  if (aggregation == SFFlowAggregation::SFProcessFlows) {
+    key->fd = proto;
+    key->port1 = 0;
+  }
 }
 
 inline void NetworkFlowProcessor::canonicalizeKey(NetFlowObj *nf, NFKey *key) {
@@ -82,6 +115,7 @@ inline void NetworkFlowProcessor::canonicalizeKey(NetFlowObj *nf, NFKey *key) {
   key->port1 = sport;
   key->ip2 = dip;
   key->port2 = dport;
+  aggregateKey(key, nf->netflow.proto);
 }
 
 inline void NetworkFlowProcessor::populateNetFlow(NetFlowObj *nf, OpFlags flag,
@@ -91,18 +125,30 @@ inline void NetworkFlowProcessor::populateNetFlow(NetFlowObj *nf, OpFlags flag,
   sinsp_threadinfo *ti = ev->get_thread_info();
   nf->netflow.opFlags = flag;
   nf->netflow.ts = ev->get_ts();
-  nf->netflow.fd = ev->get_fd_num();
+  // process flows span sockets, so they carry no fd (nor client port)
+  nf->netflow.fd =
+      (m_cxt->getFlowAggregation() == SFFlowAggregation::SFProcessFlows)
+          ? -1
+          : ev->get_fd_num();
   nf->netflow.endTs = 0;
   nf->netflow.procOID.hpid = proc->proc.oid.hpid;
   nf->netflow.procOID.createTS = proc->proc.oid.createTS;
-  nf->netflow.tid = ti->m_tid;
+  // aggregated flows belong to the process rather than to a thread
+  nf->netflow.tid =
+      (m_cxt->getFlowAggregation() == SFFlowAggregation::SFThreadFlows)
+          ? ti->m_tid
+          : proc->proc.oid.hpid;
   nf->netflow.tCapEffective = sinsp_utils::caps_to_string(ti->m_cap_effective);
   nf->netflow.tCapInheritable =
       sinsp_utils::caps_to_string(ti->m_cap_inheritable);
   nf->netflow.tCapPermitted = sinsp_utils::caps_to_string(ti->m_cap_permitted);
   nf->netflow.sip = fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip;
   nf->netflow.dip = fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip;
-  nf->netflow.sport = fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sport;
+  // process flows merge connections from any client port
+  nf->netflow.sport =
+      (m_cxt->getFlowAggregation() == SFFlowAggregation::SFProcessFlows)
+          ? 0
+          : fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sport;
   nf->netflow.dport = fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dport;
   nf->netflow.proto = getProtocol(fdinfo->get_l4proto());
   nf->netflow.numRRecvOps = 0;
@@ -112,21 +158,29 @@ inline void NetworkFlowProcessor::populateNetFlow(NetFlowObj *nf, OpFlags flag,
 }
 
 inline void NetworkFlowProcessor::updateNetFlow(NetFlowObj *nf, OpFlags flag,
-                                                sinsp_evt *ev) {
+                                                sinsp_evt *ev,
+                                                ProcessObj *proc) {
   nf->netflow.opFlags |= flag;
   nf->lastUpdate = utils::getCurrentTime(m_cxt);
+  ContainerRollup *rollup = proc->getRollup();
   if (flag == OP_WRITE_SEND) {
     nf->netflow.numWSendOps++;
     int res = utils::getSyscallResult(ev);
     if (res > 0) {
       nf->netflow.numWSendBytes += res;
     }
+    if (rollup != nullptr) {
+      rollup->netSend.add(res);
+    }
   } else if (flag == OP_READ_RECV) {
     nf->netflow.numRRecvOps++;
     int res = utils::getSyscallResult(ev);
     if (res > 0) {
       nf->netflow.numRRecvBytes += res;
     }
+    if (rollup != nullptr) {
+      rollup->netRecv.add(res);
+    }
   }
 }
 
@@ -137,14 +191,25 @@ inline void NetworkFlowProcessor::processNewFlow(sinsp_evt *ev,
   nf->exportTime = utils::getCurrentTime(m_cxt);
   nf->lastUpdate = utils::getCurrentTime(m_cxt);
   populateNetFlow(nf, flag, ev, proc);
-  updateNetFlow(nf, flag, ev);
-  if (flag != OP_CLOSE) {
+  if (m_cxt->isFanOut()) {
+    // read from the socket, since process flows drop the client port
+    uint32_t ip;
+    uint16_t port;
+    utils::getRemoteEndpoint(ev->get_fd_info(), ip, port);
+    m_processCxt->addFanOutEndpoint(proc, ip, port);
+  }
+  updateNetFlow(nf, flag, ev, proc);
+  if (flag != OP_CLOSE || isAggregated()) {
     proc->netflows[key] = nf;
     m_dfSet->insert(nf);
+    sfmemory::account(sfmemory::MemNetFlow, nf);
+    sfmemory::accountSubtables(proc);
   } else {
     removeAndWriteRelatedFlows(proc, &key, ev->get_ts());
     nf->netflow.endTs = ev->get_ts();
-    m_writer->writeNetFlow(&(nf->netflow), &(proc->proc));
+    if (!summarizeFlow(proc, nf)) {
+      m_writer->writeNetFlow(&(nf->netflow), &(proc->proc));
+    }
     delete nf;
   }
 }
@@ -152,7 +217,9 @@ inline void NetworkFlowProcessor::processNewFlow(sinsp_evt *ev,
 inline void NetworkFlowProcessor::removeAndWriteNetworkFlow(ProcessObj *proc,
                                                             NetFlowObj **nf,
                                                             NFKey *key) {
-  m_writer->writeNetFlow(&((*nf)->netflow), &(proc->proc));
+  if (!summarizeFlow(proc, *nf)) {
+    m_writer->writeNetFlow(&((*nf)->netflow), &(proc->proc));
+  }
   removeNetworkFlowFromSet(nf, false);
   removeNetworkFlow(proc, nf, key);
 }
@@ -161,14 +228,109 @@ inline void NetworkFlowProcessor::processExistingFlow(sinsp_evt *ev,
                                                       ProcessObj *proc,
                                                       OpFlags flag, NFKey key,
                                                       NetFlowObj *nf) {
-  updateNetFlow(nf, flag, ev);
-  if (flag == OP_CLOSE) {
+  updateNetFlow(nf, flag, ev, proc);
+  if (flag == OP_CLOSE && !isAggregated()) {
     removeAndWriteRelatedFlows(proc, &key, ev->get_ts());
     nf->netflow.endTs = ev->get_ts();
     removeAndWriteNetworkFlow(proc, &nf, &key);
   }
 }
 
+bool NetworkFlowProcessor::summarizeFlow(ProcessObj *proc, NetFlowObj *nf) {
+  if (!m_cxt->isConnSummary()) {
+    return false;
+  }
+  NFSummaryKey key{};
+  key.oid = nf->netflow.procOID;
+  key.dip = nf->netflow.dip;
+  key.dport = nf->netflow.dport;
+  key.proto = nf->netflow.proto;
+  NFSummaryObj *s = nullptr;
+  NFSummaryTable::iterator it = m_summaries.find(key);
+  if (it == m_summaries.end()) {
+    int maxPerProc = m_cxt->getConnSummaryMaxPerProc();
+    if (m_summaries.size() >=
+            static_cast<size_t>(m_cxt->getConnSummaryMaxKeys()) ||
+        (maxPerProc > 0 &&
+         proc->netSummaries >= static_cast<uint32_t>(maxPerProc))) {
+      sfmetrics::g_metrics.summaryOverflows++;
+      return false;
+    }
+    s = new NFSummaryObj();
+    s->netflow = nf->netflow;
+    m_summaries[key] = s;
+    proc->netSummaries++;
+  } else {
+    s = it->second;
+    NetworkFlow &sum = s->netflow;
+    // source endpoints, threads and fds that differ across the folded flows
+    // are cleared
+    if (sum.sip != nf->netflow.sip) {
+      sum.sip = 0;
+    }
+    if (sum.sport != nf->netflow.sport) {
+      sum.sport = 0;
+    }
+    if (sum.tid != nf->netflow.tid) {
+      sum.tid = 0;
+    }
+    if (sum.fd != nf->netflow.fd) {
+      sum.fd = -1;
+    }
+    sum.ts = std::min(sum.ts, nf->netflow.ts);
+    sum.endTs = std::max(sum.endTs, nf->netflow.endTs);
+    sum.opFlags |= nf->netflow.opFlags;
+    sum.numRRecvOps += nf->netflow.numRRecvOps;
+    sum.numWSendOps += nf->netflow.numWSendOps;
+    sum.numRRecvBytes += nf->netflow.numRRecvBytes;
+    sum.numWSendBytes += nf->netflow.numWSendBytes;
+  }
+  s->connections++;
+  sfmetrics::g_metrics.summarizedFlows++;
+  sfmemory::account(sfmemory::MemNetFlow, s);
+  return true;
+}
+
+int NetworkFlowProcessor::writeSummaries() {
+  int written = 0;
+  for (auto &it : m_summaries) {
+    NFSummaryObj *s = it.second;
+    ProcessObj *proc = m_processCxt->getProcess(&(s->netflow.procOID));
+    if (proc != nullptr) {
+      proc = m_processCxt->exportProcess(&(s->netflow.procOID));
+      proc->netSummaries = 0;
+    }
+    SF_DEBUG(m_logger, "Writing connection summary for "
+                           << s->netflow.procOID.hpid << " to " << it.first.dip
+                           << ":" << it.first.dport << " with "
+                           << s->connections << " connections");
+    m_writer->writeNetFlow(&(s->netflow),
+                           ((proc != nullptr) ? &(proc->proc) : nullptr));
+    sfsummary::Record rec("ConnectionSummary", s->netflow.endTs);
+    rec.addFlow(s->netflow);
+    rec.add("connections", s->connections);
+    m_writer->writeSummary(rec);
+    sfmemory::release(sfmemory::MemNetFlow, s);
+    delete s;
+    written++;
+  }
+  m_summaries.clear();
+  sfmetrics::g_metrics.summaryRecords += written;
+  return written;
+}
+
+int NetworkFlowProcessor::checkSummaries(time_t now) {
+  if (m_lastSummaryWrite == 0) {
+    m_lastSummaryWrite = now;
+    return 0;
+  }
+  if (difftime(now, m_lastSummaryWrite) < m_cxt->getNFExportInterval()) {
+    return 0;
+  }
+  m_lastSummaryWrite = now;
+  return writeSummaries();
+}
+
 int NetworkFlowProcessor::handleNetFlowEvent(sinsp_evt *ev, OpFlags flag) {
   sinsp_fdinfo_t *fdinfo = ev->get_fd_info();
   if (fdinfo == nullptr) {
@@ -238,6 +400,7 @@ int NetworkFlowProcessor::handleNetFlowEvent(sinsp_evt *ev, OpFlags flag) {
 void NetworkFlowProcessor::removeNetworkFlow(ProcessObj *proc, NetFlowObj **nf,
                                              NFKey *key) {
   proc->netflows.erase(*key);
+  sfmemory::release(sfmemory::MemNetFlow, *nf);
   delete *nf;
   nf = nullptr;
 }
@@ -245,9 +408,13 @@ void NetworkFlowProcessor::removeNetworkFlow(ProcessObj *proc, NetFlowObj **nf,
 void NetworkFlowProcessor::removeAndWriteRelatedFlows(ProcessObj *proc,
                                                       NFKey *key,
                                                       uint64_t endTs) {
+  // only per-thread flows have related flows on other threads
+  if (m_cxt->getFlowAggregation() != SFFlowAggregation::SFThreadFlows) {
+    return;
+  }
   std::vector<NetFlowObj *> nfobjs;
   for (NetworkFlowTable::iterator nfi = proc->netflows.begin();
-       nfi != proc->netflows.end(); nfi++) {
+       nfi != proc->netflows.end();) {
     if (nfi->first.tid != key->tid && nfi->first.ip1 == key->ip1 &&
         nfi->first.port1 == key->port1 && nfi->first.ip2 == key->ip2 &&
         nfi->first.port2 == key->port2 && nfi->first.fd == key->fd) {
@@ -259,7 +426,9 @@ void NetworkFlowProcessor::removeAndWriteRelatedFlows(ProcessObj *proc,
       }
       SF_DEBUG(m_logger,
                "Removing related network flow on thread: " << nfi->first.tid);
-      proc->netflows.erase(nfi);
+      nfi = sftable::eraseNext(proc->netflows, nfi);
+    } else {
+      nfi++;
     }
   }
   for (auto it = nfobjs.begin(); it != nfobjs.end(); it++) {
@@ -274,27 +443,37 @@ int NetworkFlowProcessor::removeAndWriteNFFromProc(ProcessObj *proc,
                                                    int64_t tid) {
   SF_DEBUG(m_logger, "CALLING removeAndWriteNFFromProc");
   int deleted = 0;
+  // aggregated flows outlive the thread that opened them, and are written
+  // when the process exits
+  if (tid != -1 &&
+      m_cxt->getFlowAggregation() != SFFlowAggregation::SFThreadFlows) {
+    return deleted;
+  }
+  // the flows are taken out of the table before writing them, since writing
+  // related flows erases other entries from the table
+  std::vector<NetFlowObj *> nfobjs;
   for (NetworkFlowTable::iterator nfi = proc->netflows.begin();
-       nfi != proc->netflows.end(); nfi++) {
+       nfi != proc->netflows.end();) {
     if (tid == -1 || tid == nfi->second->netflow.tid) {
-      nfi->second->netflow.endTs = utils::getSinspTime(m_cxt);
-      if (tid != -1) {
-        static NFKey k;
-        canonicalizeKey(nfi->second, &k);
-        removeAndWriteRelatedFlows(proc, &k, nfi->second->netflow.endTs);
-      }
-      nfi->second->netflow.opFlags |= OP_TRUNCATE;
-      SF_DEBUG(m_logger, "Writing NETFLOW!");
-      m_writer->writeNetFlow(&(nfi->second->netflow), &(proc->proc));
-      NetFlowObj *nfo = nfi->second;
-      proc->netflows.erase(nfi);
-      SF_DEBUG(m_logger, "Set size: " << m_dfSet->size());
-      deleted += removeNetworkFlowFromSet(&nfo, true);
-      SF_DEBUG(m_logger, "After Set size: " << m_dfSet->size());
+      nfobjs.push_back(nfi->second);
+      nfi = sftable::eraseNext(proc->netflows, nfi);
+    } else {
+      nfi++;
     }
   }
-  if (tid == -1) {
-    proc->netflows.clear();
+  for (NetFlowObj *nfo : nfobjs) {
+    nfo->netflow.endTs = utils::getSinspTime(m_cxt);
+    if (tid != -1) {
+      static NFKey k;
+      canonicalizeKey(nfo, &k);
+      removeAndWriteRelatedFlows(proc, &k, nfo->netflow.endTs);
+    }
+    nfo->netflow.opFlags |= OP_TRUNCATE;
+    SF_DEBUG(m_logger, "Writing NETFLOW!");
+    m_writer->writeNetFlow(&(nfo->netflow), &(proc->proc));
+    SF_DEBUG(m_logger, "Set size: " << m_dfSet->size());
+    deleted += removeNetworkFlowFromSet(&nfo, true);
+    SF_DEBUG(m_logger, "After Set size: " << m_dfSet->size());
   }
   return deleted;
 }
@@ -310,6 +489,7 @@ int NetworkFlowProcessor::removeNetworkFlowFromSet(NetFlowObj **nfo,
         SF_DEBUG(m_logger, "Removing netflow element from multiset.");
         m_dfSet->erase(iter);
         if (deleteNetFlow) {
+          sfmemory::release(sfmemory::MemNetFlow, *nfo);
           delete *nfo;
           nfo = nullptr;
         }
@@ -323,6 +503,7 @@ int NetworkFlowProcessor::removeNetworkFlowFromSet(NetFlowObj **nfo,
     SF_ERROR(m_logger, "Cannot find Netflow Object in data flow set. Deleting. "
                        "This should not happen");
     if (deleteNetFlow) {
+      sfmemory::release(sfmemory::MemNetFlow, *nfo);
       delete *nfo;
       nfo = nullptr;
     }
@@ -345,16 +526,38 @@ void NetworkFlowProcessor::removeNetworkFlow(DataFlowObj *dfo) {
                                               << nfo->netflow.procOID.createTS
                                               << " This shouldn't happen!");
   } else {
+    // intervals held back by the export policy are written before expiring,
+    // after the process (as in exportNetworkFlow) since the last record of
+    // the flow may be in an earlier output file
+    if (nfo->skippedExports > 0) {
+      nfo->netflow.endTs = utils::getSinspTime(m_cxt);
+      m_processCxt->exportProcess(&(nfo->netflow.procOID));
+      m_writer->writeNetFlow(&(nfo->netflow), &(proc->proc));
+    }
     removeNetworkFlow(proc, &nfo, &key);
   }
 }
 
 void NetworkFlowProcessor::exportNetworkFlow(DataFlowObj *dfo, time_t /*now*/) {
   auto *nfo = static_cast<NetFlowObj *>(dfo);
+  SFExportPolicy policy = m_cxt->getNetFlowExport();
+  bool active = (nfo->netflow.numRRecvOps + nfo->netflow.numWSendOps) > 0;
+  if (sfexport::skipExport(nfo, policy, m_cxt->getNetFlowKeepAlive(),
+                           active)) {
+    SF_DEBUG(m_logger, "Skipping periodic export of network flow");
+    return;
+  }
   nfo->netflow.endTs = utils::getSinspTime(m_cxt);
   ProcessObj *proc = m_processCxt->exportProcess(&(nfo->netflow.procOID));
+  sfexport::CapStrings caps;
+  if (policy == SFExportPolicy::SFExportHeartbeat) {
+    caps.take(nfo->netflow);
+  }
   m_writer->writeNetFlow(&(nfo->netflow),
                          ((proc != nullptr) ? &(proc->proc) : nullptr));
+  if (policy == SFExportPolicy::SFExportHeartbeat) {
+    caps.restore(nfo->netflow);
+  }
   SF_DEBUG(m_logger, "Reupping network flow");
   nfo->netflow.ts = utils::getSinspTime(m_cxt);
   nfo->netflow.endTs = 0;
@@ -36,13 +36,17 @@ private:
   process::ProcessContext *m_processCxt;
   writer::SysFlowWriter *m_writer;
   DataFlowSet *m_dfSet;
+  NFSummaryTable m_summaries;
+  time_t m_lastSummaryWrite;
   DEFINE_LOGGER();
   void canonicalizeKey(sinsp_fdinfo_t *fdinfo, NFKey *key, uint64_t tid,
                        uint64_t fd);
   void canonicalizeKey(NetFlowObj *nf, NFKey *key);
+  void aggregateKey(NFKey *key, int proto);
   void populateNetFlow(NetFlowObj *nf, OpFlags flag, sinsp_evt *ev,
                        ProcessObj *proc);
-  void updateNetFlow(NetFlowObj *nf, OpFlags flag, sinsp_evt *ev);
+  void updateNetFlow(NetFlowObj *nf, OpFlags flag, sinsp_evt *ev,
+                     ProcessObj *proc);
   void processExistingFlow(sinsp_evt *ev, ProcessObj *proc, OpFlags flag,
                            NFKey key, NetFlowObj *nf);
   void processNewFlow(sinsp_evt *ev, ProcessObj *proc, OpFlags flag, NFKey key);
@@ -51,6 +55,13 @@ private:
   int32_t getProtocol(scap_l4_proto proto);
   int removeNetworkFlowFromSet(NetFlowObj **nfo, bool deleteNetFlow);
   void removeAndWriteRelatedFlows(ProcessObj *proc, NFKey *key, uint64_t endTs);
+  bool summarizeFlow(ProcessObj *proc, NetFlowObj *nf);
+  // aggregated flows span sockets, so a close only ends one of them: it is
+  // recorded in the op flags, and the flow is written on export intervals,
+  // on expiry and when the process exits
+  inline bool isAggregated() {
+    return m_cxt->getFlowAggregation() != SFFlowAggregation::SFThreadFlows;
+  }
 
 public:
   NetworkFlowProcessor(context::SysFlowContext *cxt,
@@ -62,6 +73,10 @@ public:
   int removeAndWriteNFFromProc(ProcessObj *proc, int64_t tid);
   void removeNetworkFlow(DataFlowObj *dfo);
   void exportNetworkFlow(DataFlowObj *dfo, time_t now);
+  // writes the connection summaries once per export interval
+  int checkSummaries(time_t now);
+  int writeSummaries();
+  inline int getNumSummaries() { return m_summaries.size(); }
 };
 } // namespace networkflow
 #endif
@@ -18,6 +18,7 @@
  **/
 
 #include "processcontext.h"
+#include "sfmetrics.h"
 
 using process::ProcessContext;
 
@@ -26,13 +27,15 @@ ProcessContext::ProcessContext(context::SysFlowContext *cxt,
                                container::ContainerContext *ccxt,
                                file::FileContext *fileCxt,
                                writer::SysFlowWriter *writer)
-    : m_procs(PROC_TABLE_SIZE), m_delProcQue() {
+    : m_procs(cxt->getProcTableSize()), m_delProcQue() {
   m_cxt = cxt;
   OID *emptyoidkey = utils::getOIDEmptyKey();
   OID *deloidkey = utils::getOIDDelKey();
   m_delProcTime = utils::getCurrentTime(m_cxt);
-  m_procs.set_empty_key(emptyoidkey);
-  m_procs.set_deleted_key(deloidkey);
+  m_procs.set_empty_key(*emptyoidkey);
+  m_procs.set_deleted_key(*deloidkey);
+  sftable::configure(m_procs, m_cxt->getProcTableSize(),
+                     m_cxt->getTableMaxLoad());
   m_containerCxt = ccxt;
   m_writer = writer;
   m_fileCxt = fileCxt;
@@ -51,7 +54,13 @@ ProcessFlowSet *ProcessContext::getPFSet() { return &m_pfSet; }
 
 ProcessObj *ProcessContext::createProcess(sinsp_threadinfo *ti, sinsp_evt *ev,
                                           SFObjectState state) {
-  auto *p = new ProcessObj();
+  ProcessObj *p = m_procPool.create();
+  if (m_cxt->getFlowTableSize() > 0 || m_cxt->getTableMaxLoad() > 0) {
+    sftable::configure(p->netflows, m_cxt->getFlowTableSize(),
+                       m_cxt->getTableMaxLoad());
+    sftable::configure(p->fileflows, m_cxt->getFlowTableSize(),
+                       m_cxt->getTableMaxLoad());
+  }
   sinsp_threadinfo *mainthread = ti->get_main_thread();
   if (mainthread == nullptr) {
     mainthread = ti;
@@ -132,6 +141,9 @@ ProcessObj *ProcessContext::createProcess(sinsp_threadinfo *ti, sinsp_evt *ev,
   if (cont != nullptr) {
     p->proc.containerId.set_string(cont->cont.id);
     cont->refs++;
+    if (m_cxt->isContainerRollup()) {
+      sfmemory::getExt(p)->rollup = &(sfmemory::getExt(cont)->rollup);
+    }
   } else {
     p->proc.containerId.set_null();
   }
@@ -143,7 +155,7 @@ void ProcessContext::printAncestors(Process *proc) {
 
   while (!poid.is_null()) {
     OID key = poid.get_OID();
-    ProcessTable::iterator p = m_procs.find(&(key));
+    ProcessTable::iterator p = m_procs.find(key);
     if (p != m_procs.end()) {
       poid = p->second->proc.poid;
       SF_DEBUG(m_logger, "-->" << p->second->proc.oid.hpid << " "
@@ -162,7 +174,7 @@ bool ProcessContext::isAncestor(OID *oid, Process *proc) {
 
   while (!poid.is_null()) {
     OID key = poid.get_OID();
-    ProcessTable::iterator p = m_procs.find(&(key));
+    ProcessTable::iterator p = m_procs.find(key);
     if (p != m_procs.end()) {
       OID o = p->second->proc.oid;
       if (oid->hpid == o.hpid && oid->createTS == o.createTS) {
@@ -190,9 +202,15 @@ void ProcessContext::reupContainer(sinsp_threadinfo *ti, ProcessObj *proc) {
     }
   }
   ContainerObj *cont = m_containerCxt->getContainer(ti);
+  if (proc->ext != nullptr) {
+    proc->ext->rollup = nullptr;
+  }
   if (cont != nullptr) {
     proc->proc.containerId.set_string(cont->cont.id);
     cont->refs++;
+    if (m_cxt->isContainerRollup()) {
+      sfmemory::getExt(proc)->rollup = &(sfmemory::getExt(cont)->rollup);
+    }
   } else {
     proc->proc.containerId.set_null();
   }
@@ -202,7 +220,7 @@ ProcessObj *ProcessContext::getProcess(int64_t pid) {
   ProcessTable::iterator it;
 
   for (it = m_procs.begin(); it != m_procs.end(); it++) {
-    if (it->first->hpid == pid) {
+    if (it->first.hpid == pid) {
       return it->second;
     }
   }
@@ -210,6 +228,71 @@ ProcessObj *ProcessContext::getProcess(int64_t pid) {
   return nullptr;
 }
 
+bool ProcessContext::writeCachedAncestors(sinsp_threadinfo *ti,
+                                          ProcessObj *proc) {
+  uint64_t gen = m_writer->getGeneration();
+  std::vector<ProcessObj *> processes;
+  processes.push_back(proc);
+  // every link of the cached chain is checked against the current parent in
+  // the thread table, walked as in getProcess, since any ancestor may have
+  // exited or been reparented since the chain was resolved. Past the end of
+  // the thread table chain (ancestors found by pid), links are checked
+  // against the parent OIDs in the process table. Collection stops at the
+  // first ancestor already in the current file.
+  sinsp_threadinfo *mt = ti->get_main_thread();
+  sinsp_threadinfo *pt = (mt != nullptr ? mt : ti)->get_parent_thread();
+  Process::poid_t link = proc->proc.poid;
+  bool collect = true;
+  for (auto &oid : proc->ancestors) {
+    while (pt != nullptr && pt->m_tid != -1) {
+      if (!pt->is_main_thread() && pt->get_main_thread() != nullptr) {
+        pt = pt->get_main_thread();
+      }
+      if (pt->m_clone_ts != 0 || pt->m_pid != 0) {
+        break;
+      }
+      pt = pt->get_parent_thread();
+    }
+    bool live = (pt != nullptr && pt->m_tid != -1);
+    ProcessTable::iterator it = m_procs.find(oid);
+    if (it == m_procs.end() ||
+        (live && (pt->m_pid != oid.hpid ||
+                  static_cast<int64_t>(pt->m_clone_ts) != oid.createTS)) ||
+        (!live && (link.is_null() || link.get_OID().hpid != oid.hpid ||
+                   link.get_OID().createTS != oid.createTS))) {
+      SF_DEBUG(m_logger, "Cached ancestor " << oid.hpid << " for process "
+                                            << proc->proc.oid.hpid
+                                            << " is stale.")
+      proc->invalidateAncestors();
+      return false;
+    }
+    link = it->second->proc.poid;
+    if (live) {
+      pt = pt->get_parent_thread();
+    }
+    if (it->second->generation == gen) {
+      collect = false;
+    }
+    if (collect) {
+      processes.push_back(it->second);
+    }
+  }
+
+  reupContainer(ti, proc);
+  for (auto it = processes.rbegin(); it != processes.rend(); ++it) {
+    ProcessObj *p = (*it);
+    if (p != proc) {
+      p->proc.state = SFObjectState::REUP;
+      if (!p->proc.containerId.is_null()) {
+        m_containerCxt->exportContainer(p->proc.containerId.get_string());
+      }
+    }
+    m_writer->writeProcess(&(p->proc));
+    p->generation = gen;
+  }
+  return true;
+}
+
 ProcessObj *ProcessContext::getProcess(sinsp_evt *ev, SFObjectState state,
                                        bool &created) {
   sinsp_threadinfo *ti = ev->get_thread_info();
@@ -221,26 +304,39 @@ ProcessObj *ProcessContext::getProcess(sinsp_evt *ev, SFObjectState state,
   key.createTS = mt->m_clone_ts;
   key.hpid = mt->m_pid;
   created = true;
+  uint64_t gen = m_writer->getGeneration();
 
   SF_DEBUG(m_logger,
            "Get process - PID: " << mt->m_pid << " ts: " << mt->m_clone_ts
                                  << " Exepath: " << mt->m_exepath << " Exe: "
                                  << mt->m_exe << " MTCI " << mt->m_container_id
                                  << " TICI: " << ti->m_container_id)
-  ProcessTable::iterator proc = m_procs.find(&key);
+  ProcessTable::iterator proc = m_procs.find(key);
   ProcessObj *process = nullptr;
   if (proc != m_procs.end()) {
     created = false;
 
-    if (proc->second->written) {
+    if (proc->second->generation == gen) {
       return proc->second;
     }
 
     process = proc->second;
     process->proc.state = SFObjectState::REUP;
+
+    // common case after a rotation: replay the cached ancestor chain unless
+    // the process was reparented since it was resolved.
+    if (process->ancestorsValid && process->ancestorsPtid == mt->m_ptid &&
+        writeCachedAncestors(ti, process)) {
+      return process;
+    }
   }
 
   std::vector<ProcessObj *> processes;
+  // ancestor OIDs discovered during this walk, and the position in that chain
+  // of each process pushed into the vector above.
+  std::vector<OID> chain;
+  std::vector<std::pair<size_t, int64_t>> chainPos;
+  bool complete = true;
   if (process == nullptr) {
     // use the curretn thread here rather than the main thread because it
     // appears the main thread does not always get the container id right away.
@@ -254,6 +350,7 @@ ProcessObj *ProcessContext::getProcess(sinsp_evt *ev, SFObjectState state,
                          << " Exepath: " << mt->m_exepath
                          << " Exe: " << mt->m_exe);
   processes.push_back(process);
+  chainPos.emplace_back(0, mt->m_ptid);
 
   sinsp_threadinfo *ct = mt;
   mt = mt->get_parent_thread();
@@ -278,13 +375,18 @@ ProcessObj *ProcessContext::getProcess(sinsp_evt *ev, SFObjectState state,
                                         << " Exepath: " << mt->m_exepath
                                         << " Exe: " << mt->m_exe)
     ProcessObj *parent = nullptr;
-    ProcessTable::iterator proc2 = m_procs.find(&key);
+    ProcessTable::iterator proc2 = m_procs.find(key);
     if (proc2 != m_procs.end()) {
       SF_DEBUG(m_logger, "Found parent - PID: " << mt->m_pid
                                                 << " ts: " << mt->m_clone_ts
                                                 << " Exepath: " << mt->m_exepath
                                                 << " Exe: " << mt->m_exe)
-      if (proc2->second->written) {
+      if (proc2->second->generation == gen) {
+        ProcessObj *written = proc2->second;
+        chain.push_back(written->proc.oid);
+        chain.insert(chain.end(), written->ancestors.begin(),
+                     written->ancestors.end());
+        complete = written->ancestorsValid;
         break;
       } else {
         parent = proc2->second;
@@ -304,6 +406,8 @@ ProcessObj *ProcessContext::getProcess(sinsp_evt *ev, SFObjectState state,
 
     parent->children.insert(processes.back()->proc.oid);
     processes.push_back(parent);
+    chain.push_back(parent->proc.oid);
+    chainPos.emplace_back(chain.size(), mt->m_ptid);
     ct = mt;
     mt = mt->get_parent_thread();
   }
@@ -321,10 +425,11 @@ ProcessObj *ProcessContext::getProcess(sinsp_evt *ev, SFObjectState state,
                                                    << " Create TS "
                                                    << prt->proc.oid.createTS
                                                    << " Exe: " << prt->proc.exe)
-      if (!prt->written) {
+      if (prt->generation != gen) {
         SF_DEBUG(m_logger, "Writing to process vector...")
         processes.push_back(prt);
       }
+      chain.push_back(prt->proc.oid);
 
       prt->children.insert(o);
       o.hpid = prt->proc.oid.hpid;
@@ -339,13 +444,27 @@ ProcessObj *ProcessContext::getProcess(sinsp_evt *ev, SFObjectState state,
     }
   }
 
+  // memoize the resolved chain for the process and the ancestors walked
+  // through libsinsp so that later re-emits skip the walk
+  for (size_t i = 0; i < chainPos.size(); i++) {
+    ProcessObj *p = processes[i];
+    p->ancestors.assign(chain.begin() + chainPos[i].first, chain.end());
+    p->ancestorsValid = complete;
+    p->ancestorsPtid = chainPos[i].second;
+  }
+
   SF_DEBUG(m_logger, "Size of process table: " << m_procs.size())
   for (auto it = processes.rbegin(); it != processes.rend(); ++it) {
     SF_DEBUG(m_logger, "Writing process " << (*it)->proc.exe << " "
                                           << (*it)->proc.oid.hpid);
-    m_procs[&((*it)->proc.oid)] = (*it);
+    m_procs[(*it)->proc.oid] = (*it);
+    sfmemory::account(sfmemory::MemProcess, *it);
+    sfmemory::accountSubtables(*it);
     m_writer->writeProcess(&((*it)->proc));
-    (*it)->written = true;
+    (*it)->generation = gen;
+    if ((*it)->sweepGen == 0) {
+      queueForSweep(*it);
+    }
   }
 
   SF_DEBUG(m_logger, "New size of process table: " << m_procs.size())
@@ -353,7 +472,7 @@ ProcessObj *ProcessContext::getProcess(sinsp_evt *ev, SFObjectState state,
 }
 
 ProcessObj *ProcessContext::getProcess(OID *oid) {
-  ProcessTable::iterator proc = m_procs.find(oid);
+  ProcessTable::iterator proc = m_procs.find(*oid);
   if (proc != m_procs.end()) {
     return proc->second;
   }
@@ -372,9 +491,9 @@ ProcessObj *ProcessContext::exportProcess(OID *oid) {
     m_containerCxt->exportContainer(p->proc.containerId.get_string());
   }
 
-  if (!p->written) {
+  if (p->generation != m_writer->getGeneration()) {
     m_writer->writeProcess(&(p->proc));
-    p->written = true;
+    p->generation = m_writer->getGeneration();
   }
 
   return p;
@@ -414,52 +533,60 @@ void ProcessContext::updateProcess(Process *proc, sinsp_evt *ev,
   proc->groupName = mainthread->m_group.name;
 }
 
-void ProcessContext::clearProcesses() {
-  for (ProcessTable::iterator it = m_procs.begin(); it != m_procs.end(); ++it) {
-    if (it->second->netflows.empty() && it->second->fileflows.empty() &&
-        it->second->children.empty() && it->second->pfo == nullptr) {
-      ProcessObj *proc = it->second;
-      Process::poid_t poid = proc->proc.poid;
-      ProcessObj *curProc = proc;
-
-      while (!poid.is_null()) {
-        OID key = poid.get_OID();
-        ProcessTable::iterator p = m_procs.find(&key);
-        if (p != m_procs.end()) {
-          ProcessObj *parentProc = p->second;
-          parentProc->children.erase(curProc->proc.oid);
-          if (parentProc->children.empty() && parentProc->netflows.empty() &&
-              parentProc->fileflows.empty() && parentProc->pfo == nullptr) {
-            curProc = parentProc;
-            poid = curProc->proc.poid;
-          } else {
-            break;
-          }
-
-        } else {
-          break;
-        }
-      }
-      if (!proc->proc.containerId.is_null()) {
-        m_containerCxt->derefContainer(proc->proc.containerId.get_string());
-      }
-      m_procs.erase(it);
-      delete proc;
-    } else {
-      it->second->written = false;
-    }
+void ProcessContext::queueForSweep(ProcessObj *proc) {
+  proc->sweepGen = m_writer->getGeneration();
+  m_sweepQue.emplace_back(proc->proc.oid, proc->sweepGen);
+}
+
+void ProcessContext::removeIdleProcess(ProcessObj *proc) {
+  if (!proc->proc.containerId.is_null()) {
+    m_containerCxt->derefContainer(proc->proc.containerId.get_string());
   }
-  for (ProcessTable::iterator it = m_procs.begin(); it != m_procs.end(); ++it) {
-    if (it->second->netflows.empty() && it->second->fileflows.empty() &&
-        it->second->children.empty() && it->second->pfo == nullptr) {
-      ProcessObj *proc = it->second;
-      if (!proc->proc.containerId.is_null()) {
-        m_containerCxt->derefContainer(proc->proc.containerId.get_string());
+  m_procs.erase(proc->proc.oid);
+  sfmemory::release(sfmemory::MemProcess, proc);
+  m_procPool.destroy(proc);
+}
+
+int ProcessContext::sweepProcesses(int budget) {
+  uint64_t gen = m_writer->getGeneration();
+  int deleted = 0;
+  while (budget > 0 && !m_sweepQue.empty() && m_sweepQue.front().second < gen) {
+    OID key = m_sweepQue.front().first;
+    uint64_t queued = m_sweepQue.front().second;
+    m_sweepQue.pop_front();
+    budget--;
+    ProcessTable::iterator it = m_procs.find(key);
+    if (it == m_procs.end() || it->second->sweepGen != queued) {
+      continue;
+    }
+    ProcessObj *proc = it->second;
+    if (!isIdle(proc) || proc->generation == gen) {
+      queueForSweep(proc);
+      continue;
+    }
+    // unlink from the parent and collect ancestors left without children
+    Process::poid_t poid = proc->proc.poid;
+    OID oid = proc->proc.oid;
+    removeIdleProcess(proc);
+    deleted++;
+    while (!poid.is_null()) {
+      OID pkey = poid.get_OID();
+      ProcessTable::iterator p = m_procs.find(pkey);
+      if (p == m_procs.end()) {
+        break;
+      }
+      ProcessObj *parentProc = p->second;
+      parentProc->children.erase(oid);
+      if (!isIdle(parentProc) || parentProc->generation == gen) {
+        break;
       }
-      m_procs.erase(it);
-      delete proc;
+      poid = parentProc->proc.poid;
+      oid = parentProc->proc.oid;
+      removeIdleProcess(parentProc);
+      deleted++;
     }
   }
+  return deleted;
 }
 
 void ProcessContext::printStats() {
@@ -480,9 +607,9 @@ void ProcessContext::writeProcessAndAncestors(ProcessObj *proc) {
 
   while (!poid.is_null()) {
     OID key = poid.get_OID();
-    ProcessTable::iterator p = m_procs.find(&key);
+    ProcessTable::iterator p = m_procs.find(key);
     if (p != m_procs.end()) {
-      if (!p->second->written) {
+      if (p->second->generation != m_writer->getGeneration()) {
         processes.push_back(p->second);
       }
       poid = p->second->proc.poid;
@@ -498,7 +625,7 @@ void ProcessContext::writeProcessAndAncestors(ProcessObj *proc) {
       m_containerCxt->exportContainer(proc->proc.containerId.get_string());
     }
     m_writer->writeProcess(&((*it)->proc));
-    (*it)->written = true;
+    (*it)->generation = m_writer->getGeneration();
   }
 }
 
@@ -516,7 +643,7 @@ void ProcessContext::clearAllProcesses() {
   for (ProcessTable::iterator it = m_procs.begin(); it != m_procs.end(); ++it) {
     if (((!it->second->netflows.empty()) || (!it->second->fileflows.empty()) ||
          (it->second->pfo != nullptr)) &&
-        !it->second->written) {
+        it->second->generation != m_writer->getGeneration()) {
       writeProcessAndAncestors(it->second);
     }
 
@@ -525,6 +652,7 @@ void ProcessContext::clearAllProcesses() {
       nfi->second->netflow.opFlags |= OP_TRUNCATE;
       nfi->second->netflow.endTs = utils::getSinspTime(m_cxt);
       m_writer->writeNetFlow(&(nfi->second->netflow), &(it->second->proc));
+      sfmemory::release(sfmemory::MemNetFlow, nfi->second);
       delete nfi->second;
     }
 
@@ -535,6 +663,7 @@ void ProcessContext::clearAllProcesses() {
       FileObj *file = m_fileCxt->exportFile(ffi->second->filekey);
       m_writer->writeFileFlow(&(ffi->second->fileflow), &(it->second->proc),
                               &(file->file));
+      sfmemory::release(sfmemory::MemFileFlow, ffi->second);
       delete ffi->second;
     }
 
@@ -544,14 +673,19 @@ void ProcessContext::clearAllProcesses() {
       SF_DEBUG(m_logger, "Writing processflow")
       m_writer->writeProcessFlow(&(it->second->pfo->procflow),
                                  &(it->second->proc));
+      sfmemory::release(sfmemory::MemProcFlow, it->second->pfo);
       delete it->second->pfo;
       it->second->pfo = nullptr;
     }
+    writeCoalescedFlows(it->second);
+    writeFanOut(it->second);
   }
 
   for (ProcessTable::iterator it = m_procs.begin(); it != m_procs.end(); ++it) {
-    delete it->second;
+    sfmemory::release(sfmemory::MemProcess, it->second);
+    m_procPool.destroy(it->second);
   }
+  m_procs.clear();
 
   for (auto it = m_delProcQue.begin(); it != m_delProcQue.end(); ++it) {
     delete (*it);
@@ -559,6 +693,116 @@ void ProcessContext::clearAllProcesses() {
   }
 }
 
+int ProcessContext::writeCoalescedFlows(ProcessObj *proc) {
+  if (proc->ext == nullptr || proc->ext->coalesced.empty()) {
+    return 0;
+  }
+  if (proc->generation != m_writer->getGeneration()) {
+    writeProcessAndAncestors(proc);
+  }
+  int written = 0;
+  for (FFCoalescedObj *c : proc->ext->coalesced) {
+    FileObj *file = m_fileCxt->exportFile(c->filekey);
+    m_writer->writeFileFlow(&(c->fileflow), &(proc->proc),
+                            ((file != nullptr) ? &(file->file) : nullptr));
+    sfsummary::Record rec("CoalescedFileFlow", c->fileflow.endTs);
+    rec.addFlow(c->fileflow);
+    rec.add("flows", c->flows);
+    m_writer->writeSummary(rec);
+    if (file != nullptr) {
+      file->refs--;
+    }
+    sfmemory::release(sfmemory::MemFileFlow, c);
+    delete c;
+    written++;
+  }
+  proc->ext->coalesced.clear();
+  sfmetrics::g_metrics.coalescedRecords += written;
+  return written;
+}
+
+// writes the counts held by the writer for processes without a later flow,
+// e.g., before the output rotates
+int ProcessContext::writeProcessCounts() {
+  std::vector<OID> oids = m_writer->getCountedProcesses();
+  for (OID &oid : oids) {
+    if (getProcess(&oid) != nullptr) {
+      exportProcess(&oid);
+    }
+    m_writer->writeCounts(oid);
+  }
+  return oids.size();
+}
+
+ProcessExt *ProcessContext::getFanOutExt(ProcessObj *proc) {
+  ProcessExt *ext = sfmemory::getExt(proc);
+  if (ext->fanOut == nullptr) {
+    ext->fanOut = std::make_unique<sfhll::FanOutSketch>();
+    sfmemory::account(sfmemory::MemProcess, proc);
+  }
+  return ext;
+}
+
+void ProcessContext::addFanOutEndpoint(ProcessObj *proc, uint32_t ip,
+                                       uint16_t port) {
+  ProcessExt *ext = getFanOutExt(proc);
+  if (ext->fanOut->addEndpoint(ip, port) && !ext->fanOutDirty) {
+    ext->fanOutDirty = true;
+    m_fanOutProcs.push_back(proc->proc.oid);
+  }
+  if (ext->rollup != nullptr) {
+    ext->rollup->fanOut.addEndpoint(ip, port);
+  }
+}
+
+void ProcessContext::addFanOutFile(ProcessObj *proc, const std::string &path) {
+  ProcessExt *ext = getFanOutExt(proc);
+  if (ext->fanOut->addFile(path) && !ext->fanOutDirty) {
+    ext->fanOutDirty = true;
+    m_fanOutProcs.push_back(proc->proc.oid);
+  }
+  if (ext->rollup != nullptr) {
+    ext->rollup->fanOut.addFile(path);
+  }
+}
+
+int ProcessContext::writeFanOut(ProcessObj *proc) {
+  if (proc->ext == nullptr || !proc->ext->fanOutDirty) {
+    return 0;
+  }
+  // the process record precedes its estimates in the output file
+  if (proc->generation != m_writer->getGeneration()) {
+    writeProcessAndAncestors(proc);
+  }
+  const sfhll::FanOutSketch &fanOut = *(proc->ext->fanOut);
+  sfsummary::Record rec("ProcessFanOut",
+                        static_cast<int64_t>(utils::getSinspTime(m_cxt)));
+  rec.addOID("procOID", proc->proc.oid);
+  rec.add("exe", proc->proc.exe);
+  if (!proc->proc.containerId.is_null()) {
+    rec.add("containerId", proc->proc.containerId.get_string());
+  }
+  rec.add("distinctIPs", fanOut.ips.estimate());
+  rec.add("distinctPorts", fanOut.ports.estimate());
+  rec.add("distinctFiles", fanOut.files.estimate());
+  m_writer->writeSummary(rec);
+  proc->ext->fanOutDirty = false;
+  sfmetrics::g_metrics.fanOutRecords++;
+  return 1;
+}
+
+int ProcessContext::writeFanOuts() {
+  int written = 0;
+  for (OID &oid : m_fanOutProcs) {
+    ProcessObj *proc = getProcess(&oid);
+    if (proc != nullptr) {
+      written += writeFanOut(proc);
+    }
+  }
+  m_fanOutProcs.clear();
+  return written;
+}
+
 void ProcessContext::markForDeletion(ProcessObj **proc) {
   OIDObj *o = new OIDObj((*proc)->proc.oid);
   o->exportTime = utils::getCurrentTime(m_cxt);
@@ -570,7 +814,7 @@ void ProcessContext::deleteProcess(ProcessObj **proc) {
   Process::poid_t poid = (*proc)->proc.poid;
   if (!poid.is_null()) {
     OID key = poid.get_OID();
-    ProcessTable::iterator p = m_procs.find(&key);
+    ProcessTable::iterator p = m_procs.find(key);
     if (p != m_procs.end()) {
       p->second->children.erase((*proc)->proc.oid);
     }
@@ -583,9 +827,12 @@ void ProcessContext::deleteProcess(ProcessObj **proc) {
   if ((*proc)->pfo != nullptr) {
     removeProcessFromSet(*proc, false);
   }
+  writeCoalescedFlows(*proc);
+  writeFanOut(*proc);
 
-  m_procs.erase(&((*proc)->proc.oid));
-  delete *proc;
+  m_procs.erase((*proc)->proc.oid);
+  sfmemory::release(sfmemory::MemProcess, *proc);
+  m_procPool.destroy(*proc);
   *proc = nullptr;
 }
 
@@ -610,6 +857,7 @@ int ProcessContext::removeProcessFromSet(ProcessObj *proc, bool checkForErr) {
   }
 
   if (proc->pfo != nullptr) {
+    sfmemory::release(sfmemory::MemProcFlow, proc->pfo);
     delete proc->pfo;
     proc->pfo = nullptr;
   }
@@ -24,12 +24,12 @@
 #include "filecontext.h"
 #include "logger.h"
 #include "op_flags.h"
+#include "sfmemory.h"
 #include "sysflow.h"
 #include "sysflowcontext.h"
 #include "utils.h"
 #include <sinsp.h>
 
-#define PROC_TABLE_SIZE 50000
 #define PROC_DEL_EXPIRED 1.0
 namespace process {
 class ProcessContext {
@@ -37,14 +37,33 @@ private:
   context::SysFlowContext *m_cxt;
   writer::SysFlowWriter *m_writer;
   container::ContainerContext *m_containerCxt;
+  ProcessPool m_procPool;
   ProcessTable m_procs;
   file::FileContext *m_fileCxt;
   OIDQueue m_delProcQue;
+  ProcessSweepQueue m_sweepQue;
   ProcessFlowSet m_pfSet;
   time_t m_delProcTime;
+  // processes whose fan-out estimates changed in the current interval
+  std::vector<OID> m_fanOutProcs;
   DEFINE_LOGGER();
+  ProcessExt *getFanOutExt(ProcessObj *proc);
   void writeProcessAndAncestors(ProcessObj *proc);
   void reupContainer(sinsp_threadinfo *ti, ProcessObj *proc);
+  bool writeCachedAncestors(sinsp_threadinfo *ti, ProcessObj *proc);
+  void queueForSweep(ProcessObj *proc);
+  void removeIdleProcess(ProcessObj *proc);
+  // processes with pending connection summaries, coalesced flows, fan-out
+  // estimates or held counts are kept until these are written, so that they
+  // are never written without their process. These are flushed every export
+  // interval, so a process is held out of the sweep for at most one interval.
+  inline bool isIdle(ProcessObj *proc) {
+    return proc->netflows.empty() && proc->fileflows.empty() &&
+           proc->children.empty() && proc->pfo == nullptr &&
+           proc->netSummaries == 0 &&
+           (proc->ext == nullptr || !proc->ext->pending()) &&
+           !m_writer->hasCounts(proc->proc.oid);
+  }
 
 public:
   ProcessContext(context::SysFlowContext *cxt,
@@ -59,15 +78,33 @@ public:
   ProcessObj *getProcess(int64_t pid);
   void printAncestors(Process *proc);
   bool isAncestor(OID *oid, Process *proc);
-  void clearProcesses();
+  int sweepProcesses(int budget);
   void clearAllProcesses();
   void deleteProcess(ProcessObj **proc);
   void markForDeletion(ProcessObj **proc);
   ProcessObj *exportProcess(OID *oid);
+  int writeCoalescedFlows(ProcessObj *proc);
+  int writeProcessCounts();
+  void addFanOutEndpoint(ProcessObj *proc, uint32_t ip, uint16_t port);
+  void addFanOutFile(ProcessObj *proc, const std::string &path);
+  int writeFanOut(ProcessObj *proc);
+  int writeFanOuts();
+  inline ContainerObj *getContainer(const std::string &id) {
+    return m_containerCxt->getContainer(id);
+  }
   void printNetworkFlow(ProcessObj *proc);
   void printStats();
   int removeProcessFromSet(ProcessObj *proc, bool checkForErr);
   inline int getSize() { return m_procs.size(); }
+  // includes the free slots of the process pool
+  inline int64_t getMemBytes() {
+    return sfmemory::g_memory.bytes[sfmemory::MemProcess] +
+           sfmemory::bucketBytes(m_procs) +
+           (m_procPool.capacity() - m_procPool.size()) * sizeof(ProcessObj);
+  }
+  inline bool shrinkTable() {
+    return sftable::shrink(m_procs, m_cxt->getProcTableSize());
+  }
   inline int getNumNetworkFlows() {
     int total = 0;
     for (ProcessTable::iterator it = m_procs.begin(); it != m_procs.end();
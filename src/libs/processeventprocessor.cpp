@@ -52,6 +52,11 @@ void ProcessEventProcessor::writeCloneEvent(sinsp_evt *ev) {
   m_procEvt.tCapPermitted = sinsp_utils::caps_to_string(ti->m_cap_permitted);
   m_procEvt.ret = utils::getSyscallResult(ev);
   m_procEvt.args.clear();
+  // child side of a process clone
+  ContainerRollup *rollup = proc->getRollup();
+  if (rollup != nullptr && m_procEvt.ret == 0 && ti->is_main_thread()) {
+    rollup->procsSpawned++;
+  }
   m_writer->writeProcessEvent(&m_procEvt, &(proc->proc));
 }
 
@@ -61,9 +66,10 @@ void ProcessEventProcessor::writeSetUIDEvent(sinsp_evt *ev) {
   ProcessObj *proc = m_processCxt->getProcess(ev, SFObjectState::REUP, created);
   if (!created) {
     m_processCxt->updateProcess(&(proc->proc), ev, SFObjectState::MODIFIED);
+    sfmemory::account(sfmemory::MemProcess, proc);
     SF_DEBUG(m_logger, "Writing modified process..." << proc->proc.exe);
     m_writer->writeProcess(&(proc->proc));
-    proc->written = true;
+    proc->generation = m_writer->getGeneration();
   }
   m_procEvt.opFlags = OP_SETUID;
   m_procEvt.ts = ev->get_ts();
@@ -104,6 +110,7 @@ void ProcessEventProcessor::writeExitEvent(sinsp_evt *ev) {
   m_writer->writeProcessEvent(&m_procEvt, &(proc->proc));
   // delete the process from the proc table after an exit
   if (ti->is_main_thread()) {
+    m_writer->writeCounts(proc->proc.oid);
     // m_processCxt->deleteProcess(&proc);
     m_processCxt->markForDeletion(&proc);
   }
@@ -119,11 +126,13 @@ void ProcessEventProcessor::writeExecEvent(sinsp_evt *ev) {
   // will only see the EXEC of this process, and the getProcess above will
   // actually create it.  So the question is do we want to add another process
   // record just to mark it modified at this point?
+  proc->invalidateAncestors();
   if (!created) {
     m_processCxt->updateProcess(&(proc->proc), ev, SFObjectState::MODIFIED);
+    sfmemory::account(sfmemory::MemProcess, proc);
     SF_DEBUG(m_logger, "Writing modified process..." << proc->proc.exe);
     m_writer->writeProcess(&(proc->proc));
-    proc->written = true;
+    proc->generation = m_writer->getGeneration();
   }
 
   m_procEvt.opFlags = OP_EXEC;
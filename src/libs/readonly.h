@@ -42,7 +42,8 @@ inline bool prefix_match(std::string path, std::string match) {
   return true;
 }
 
-#define SHOULD_WRITE(ff, proc, file)                                           \
+// declares match, set if the file read mode filters out the flow
+#define FILTER_READ(ff, match)                                                 \
   int readMode = m_cxt->getFileRead();                                         \
   bool match = false;                                                          \
   if ((readMode == FILE_READS_DISABLED || readMode == FILE_READS_SELECT) &&    \
@@ -60,7 +61,10 @@ inline bool prefix_match(std::string path, std::string match) {
     } else {                                                                   \
       match = true;                                                            \
     }                                                                          \
-  }                                                                            \
+  }
+
+#define SHOULD_WRITE(ff, proc, file)                                           \
+  FILTER_READ(ff, match)                                                       \
   if (!match) {                                                                \
     m_writer->writeFileFlow(&(ff->fileflow), proc, file);                      \
   }
@@ -0,0 +1,105 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#include "samplingcontroller.h"
+#include "sfmetrics.h"
+#include "utils.h"
+#include <algorithm>
+
+using sampling::SamplingController;
+
+CREATE_LOGGER(SamplingController, "sysflow.sampling");
+
+SamplingController::SamplingController(context::SysFlowContext *cxt,
+                                       int minRatio, int maxRatio)
+    : m_cxt(cxt), m_minRatio(minRatio), m_maxRatio(maxRatio),
+      m_calmIntervals(0), m_lastCheck(0), m_lastEvents(0), m_lastDrops(0),
+      m_changeTs(0), m_oldRatio(0), m_changeDropRate(0), m_changeLag(0) {}
+
+double SamplingController::getLag() {
+  if (m_cxt->timeStamp == 0) {
+    return 0;
+  }
+  struct timespec ts {};
+  clock_gettime(CLOCK_REALTIME, &ts);
+  auto now = static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+  return std::max<int64_t>(now - static_cast<int64_t>(m_cxt->timeStamp), 0) /
+         1e9;
+}
+
+bool SamplingController::checkSampling() {
+  time_t curTime = utils::getCurrentTime(m_cxt);
+  if (difftime(curTime, m_lastCheck) < SAMPLING_INTERVAL) {
+    return false;
+  }
+  bool first = (m_lastCheck == 0);
+  m_lastCheck = curTime;
+
+  scap_stats stats{};
+  m_cxt->getInspector()->get_capture_stats(&stats);
+  uint64_t events = stats.n_evts - m_lastEvents;
+  uint64_t drops = stats.n_drops - m_lastDrops;
+  m_lastEvents = stats.n_evts;
+  m_lastDrops = stats.n_drops;
+  if (first) {
+    return false;
+  }
+
+  double dropRate =
+      (events + drops > 0) ? static_cast<double>(drops) / (events + drops) : 0;
+  double lag = getLag();
+  int ratio = m_cxt->getSamplingRatio();
+  int newRatio = ratio;
+  if (dropRate > SAMPLING_DROP_HIGH || lag > SAMPLING_LAG_HIGH) {
+    m_calmIntervals = 0;
+    newRatio = std::min(ratio * 2, m_maxRatio);
+  } else if (drops == 0 && lag < SAMPLING_LAG_LOW) {
+    if (++m_calmIntervals >= SAMPLING_CALM_INTERVALS) {
+      m_calmIntervals = 0;
+      newRatio = std::max(ratio / 2, m_minRatio);
+    }
+  } else {
+    m_calmIntervals = 0;
+  }
+
+  if (newRatio == ratio) {
+    return false;
+  }
+  SF_INFO(m_logger, "Changing sampling ratio from "
+                        << ratio << " to " << newRatio
+                        << ". Drop rate: " << dropRate << " Lag (s): " << lag)
+  m_cxt->setSamplingRatio(newRatio);
+  sfmetrics::g_metrics.samplingChanges++;
+  m_changeTs = static_cast<int64_t>(utils::getSinspTime(m_cxt));
+  m_oldRatio = ratio;
+  m_changeDropRate = dropRate;
+  m_changeLag = lag;
+  return true;
+}
+
+// summary values are integers, so the drop rate is in parts per million and
+// the lag in milliseconds
+sfsummary::Record SamplingController::getChangeRecord() {
+  sfsummary::Record rec("SamplingRatio", m_changeTs);
+  rec.add("oldRatio", m_oldRatio);
+  rec.add("ratio", m_cxt->getSamplingRatio());
+  rec.add("dropRatePpm", static_cast<int64_t>(m_changeDropRate * 1e6));
+  rec.add("lagMs", static_cast<int64_t>(m_changeLag * 1e3));
+  return rec;
+}
@@ -0,0 +1,73 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#ifndef _SF_SAMPLING_
+#define _SF_SAMPLING_
+#include "logger.h"
+#include "sfsummary.h"
+#include "sysflowcontext.h"
+#include <ctime>
+
+// the controller looks at drops and lag every SAMPLING_INTERVAL seconds
+#define SAMPLING_INTERVAL 5.0
+// fraction of events dropped by the driver above which sampling increases
+#define SAMPLING_DROP_HIGH 0.01
+// processing lag (event age, in secs) above which sampling increases, and
+// below which it may decrease again
+#define SAMPLING_LAG_HIGH 2.0
+#define SAMPLING_LAG_LOW 0.2
+// consecutive calm intervals required before sampling decreases
+#define SAMPLING_CALM_INTERVALS 6
+// largest sampling ratio supported by the drivers
+#define SAMPLING_MAX_RATIO 128
+
+namespace sampling {
+// Feedback controller for the kernel sampling ratio in dropping mode. The
+// ratio is doubled when the driver drops events or the collector falls
+// behind, and halved again after a few calm intervals, within the ratio set
+// with samplingRatio and maxSamplingRatio.
+class SamplingController {
+private:
+  context::SysFlowContext *m_cxt;
+  int m_minRatio;
+  int m_maxRatio;
+  int m_calmIntervals;
+  time_t m_lastCheck;
+  uint64_t m_lastEvents;
+  uint64_t m_lastDrops;
+  // the last ratio change, and the drop rate and lag that caused it
+  int64_t m_changeTs;
+  int m_oldRatio;
+  double m_changeDropRate;
+  double m_changeLag;
+  DEFINE_LOGGER();
+  double getLag();
+
+public:
+  SamplingController(context::SysFlowContext *cxt, int minRatio,
+                     int maxRatio);
+  virtual ~SamplingController() = default;
+  // returns true if the sampling ratio was changed
+  bool checkSampling();
+  // SamplingRatio summary record of the last ratio change
+  sfsummary::Record getChangeRecord();
+};
+} // namespace sampling
+
+#endif
@@ -0,0 +1,71 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#ifndef _SF_BENCH_
+#define _SF_BENCH_
+#include <cstdint>
+#include <ctime>
+
+// Benchmark counters and per-stage timers. They are only compiled in when
+// building with BENCH=1 (-DSF_BENCH), so that regular builds pay nothing.
+namespace sfbench {
+
+enum BenchStage {
+  StageNext,     // inspector next()
+  StageDispatch, // everything after next(), including writer time
+  StageEncode,   // avro encoding of records
+  StageCompress, // block compression and flush to the output file
+  NumStages
+};
+
+struct BenchStats {
+  uint64_t numEvents{0};
+  uint64_t numRecords{0};
+  uint64_t stageNs[NumStages]{};
+};
+
+inline BenchStats g_stats;
+
+inline uint64_t getTimeNs() {
+  struct timespec ts {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+class StageTimer {
+private:
+  BenchStage m_stage;
+  uint64_t m_start;
+
+public:
+  explicit StageTimer(BenchStage stage)
+      : m_stage(stage), m_start(getTimeNs()) {}
+  ~StageTimer() { g_stats.stageNs[m_stage] += getTimeNs() - m_start; }
+};
+} // namespace sfbench
+
+#ifdef SF_BENCH
+#define SF_BENCH_STAGE(stage) sfbench::StageTimer sfBenchTimer(sfbench::stage);
+#define SF_BENCH_COUNT(counter) sfbench::g_stats.counter++;
+#else
+#define SF_BENCH_STAGE(stage)
+#define SF_BENCH_COUNT(counter)
+#endif
+
+#endif
@@ -37,4 +37,4 @@ int SFCallbackWriter::initialize() {
   return 0;
 }
 
-void SFCallbackWriter::reset(time_t curTime) { writeHeader(); }
+void SFCallbackWriter::doReset(time_t curTime) { writeHeader(); }
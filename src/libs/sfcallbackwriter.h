@@ -33,6 +33,7 @@ private:
   sysflowprocessor::SysFlowProcessor *m_sysflowProc;
   SysFlowCallback m_callback;
   sysflow::SFHeader m_header;
+  void doReset(time_t curTime);
 
 public:
   SFCallbackWriter(context::SysFlowContext *cxt, time_t start,
@@ -63,7 +64,6 @@ public:
     }
   }
   int initialize();
-  void reset(time_t curTime);
   bool needsReset() { return false; }
 };
 } // namespace writer
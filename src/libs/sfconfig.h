@@ -25,6 +25,14 @@
 
 enum SFSysCallMode { SFFlowMode, SFConsumerMode, SFNoFilesMode };
 enum DriverType { EBPF, CORE_EBPF, KMOD, NO_DRIVER };
+enum SFFlowAggregation { SFThreadFlows, SFSocketFlows, SFProcessFlows };
+enum SFRateLimitScope { SFRateLimitProcess, SFRateLimitContainer };
+enum SFExportPolicy {
+  SFExportFull,
+  SFExportKeepAlive,
+  SFExportHeartbeat,
+  SFExportSuppress
+};
 
 using SysFlowCallback = std::function<void(
     sysflow::SFHeader *, sysflow::Container *, sysflow::Process *,
@@ -119,6 +127,130 @@ struct SysFlowConfig {
   // Set the driver type to EBPF (traditional ebpf driver), KMOD (kernel
   // module), CORE_EBPF (CORE ebpf driver), NO_DRIVER (reading from a file)
   DriverType driverType;
+  // Path to a drop filter rules file. Events matching any rule are dropped
+  // before any table lookup takes place. One rule per line in the form
+  // "<type> <value>", where type is one of exe, container, path (prefix
+  // match on the fd name), port (source or destination port) or uid. Lines
+  // starting with '#' are ignored. Leave empty to disable the filter.
+  std::string dropFilterPath;
+  // Path to a metrics file in the Prometheus text format (e.g., in the node
+  // exporter textfile collector directory), rewritten every metricsInterval
+  // seconds with table sizes, records written, writer errors, capture drops
+  // and sweep times. Leave empty to disable metrics.
+  std::string metricsFile;
+  // Interval in secs between metrics file updates.
+  int metricsInterval;
+  // Path of the summary record file (JSON lines with the counts, rollups and
+  // sketches that SysFlow records have no fields for). Rotates with the
+  // output, with the reset time appended. Leave empty to write summaries to
+  // "<output file>.summary" next to each SysFlow file; socket and callback
+  // outputs have no summaries unless it is set.
+  std::string summaryFile;
+  // Upper bound of the sampling ratio for adaptive sampling. When greater
+  // than samplingRatio, the sampling ratio of dropping mode is raised (up to
+  // this bound) when the driver drops events or the collector falls behind,
+  // and lowered back to samplingRatio when the load subsides. Each change
+  // starts a new output segment with a new SysFlow header. Set to 0 to keep
+  // a fixed sampling ratio. Must be a power of 2 up to 128.
+  int maxSamplingRatio;
+  // Time one in latencySampling calls of each pipeline stage for the latency
+  // histograms. Only used when the libraries are built with LATENCY=1.
+  int latencySampling;
+  // Initial capacities (in entries) of the process, container, pod and file
+  // tables, and of the network and file flow tables of each process. Larger
+  // capacities avoid rehashing during warm-up on large nodes; smaller ones
+  // save memory on small nodes. Set to 0 to use the defaults (50000
+  // processes, 100 containers, 100 pods, and the table minimum for files
+  // and flows).
+  int procTableSize;
+  int contTableSize;
+  int podTableSize;
+  int fileTableSize;
+  int flowTableSize;
+  // Load factor (between 0.1 and 0.95) at which the tables double their
+  // buckets. Set to 0 to use the default of the table backend (0.5 for
+  // dense_hash_map, 0.8 for the flat tables).
+  float tableMaxLoad;
+  // Compact the process, container, pod and file tables when they fall
+  // below a quarter of their load, once the sweep following a file
+  // rotation has removed stale entries.
+  bool shrinkTables;
+  // Size the process and file tables at startup from the number of
+  // processes and open file descriptors found in /proc (live capture only).
+  // Overrides procTableSize and fileTableSize.
+  bool autoSizeTables;
+  // Sets how network flows are aggregated. SFThreadFlows (default): one flow
+  // per thread and socket. SFSocketFlows: threads sharing a socket share a
+  // flow, with their op and byte counters merged. SFProcessFlows: all
+  // sockets of a process between the same client ip and server ip, port and
+  // protocol share a flow, whatever the client port (for a client, one flow
+  // per remote endpoint; for a server, one per connecting host and local
+  // service port). Aggregated flows carry the process id as tid, are kept
+  // open when a socket closes, and are written every export interval, on
+  // expiry and on process exit. Process flows carry -1 as fd and 0 as client
+  // port (sport).
+  SFFlowAggregation flowAggregation;
+  // Maximum number of connection summaries. When greater than 0, completed
+  // network flows of a process to the same destination ip, port and
+  // protocol are folded into one summary flow per export interval, with
+  // their counters summed. Flows beyond the limit are written as usual.
+  // Set to 0 (default) to write every flow.
+  int connSummaryMaxKeys;
+  // Maximum number of connection summaries per process (0 for no limit)
+  int connSummaryMaxPerProc;
+  // Maximum number of coalesced file flows per process. When greater than 0,
+  // completed file flows of a process on the same file with the same open
+  // flags are merged into one flow, written once per export interval, on
+  // file rotation and on process exit. Flows beyond the limit are written
+  // as usual. Set to 0 (default) to write every flow.
+  int fileCoalesceMax;
+  // Deduplicate mmap file flows: the first map of a (container, path) in an
+  // output file is written as a file flow, and later maps of the same file
+  // by any process are only counted (in the collector metrics).
+  bool mmapDedup;
+  // Children per parent per second above which the clone, exec and exit
+  // events of new children are folded into fork summary records of the
+  // parent, one per child exe and args, written once per export interval.
+  // Folded children have no Process record of their own. Set to 0 (default)
+  // to disable.
+  int forkStormThreshold;
+  // Interval (in secs) at which long-lived flows are exported, and idle time
+  // (in secs) after which they are removed. Set to 0 for the defaults (30
+  // and 60 secs).
+  int flowExportInterval;
+  int flowExpireInterval;
+  // Periodic export policy of network and file flows. SFExportFull
+  // (default): a record every export interval with activity.
+  // SFExportKeepAlive: a record every keep-alive number of intervals.
+  // SFExportHeartbeat: periodic records without the capability strings.
+  // SFExportSuppress: no record for intervals without reads or writes.
+  // Skipped intervals are merged into the next record of the flow.
+  SFExportPolicy netFlowExport;
+  SFExportPolicy fileFlowExport;
+  // Export intervals per keep-alive record (0 for the default of 4)
+  int netFlowKeepAlive;
+  int fileFlowKeepAlive;
+  // Keep per container (and per pod, when k8s is enabled) counters of
+  // network and file I/O and process activity, written as rollup records
+  // every export interval
+  bool containerRollup;
+  // Number of heavy hitter files, destination endpoints, executables and
+  // containers tracked per export interval with count-min sketches. The
+  // tables are exported as metrics and logged with the stats, along with drop
+  // filter suggestions. Set to 0 to disable
+  int heavyHitterK;
+  // Also write the heavy hitters of each export interval as a record
+  bool heavyHitterRecords;
+  // Estimate the distinct remote IPs, remote ports and file paths of each
+  // process (and container, with rollups) with HyperLogLog sketches
+  bool fanOut;
+  // Userspace rate limit (in data events per second) of each process or
+  // container, on top of the kernel-side dropMode and samplingRatio. Events
+  // over the limit are dropped and counted per process. Set to 0 to disable
+  int rateLimit;
+  // Largest burst of data events let through (0 for one second of rateLimit)
+  int rateLimitBurst;
+  SFRateLimitScope rateLimitScope;
 }; // SysFlowConfig
 
 #endif
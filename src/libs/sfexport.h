@@ -0,0 +1,95 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#ifndef _SF_EXPORT_
+#define _SF_EXPORT_
+#include "datatypes.h"
+#include "sfconfig.h"
+#include <string>
+#include <utility>
+
+// Export policies applied when long-lived flows are re-exported on the
+// export interval. Skipped intervals are not lost: the flow keeps its start
+// time, op flags and counters, which go into the next record written.
+namespace sfexport {
+
+// parses one of full, keepalive, heartbeat, or suppress; returns def if the
+// name is unknown.
+inline SFExportPolicy parsePolicy(const std::string &name,
+                                  SFExportPolicy def) {
+  if (name == "full") {
+    return SFExportPolicy::SFExportFull;
+  } else if (name == "keepalive") {
+    return SFExportPolicy::SFExportKeepAlive;
+  } else if (name == "heartbeat") {
+    return SFExportPolicy::SFExportHeartbeat;
+  } else if (name == "suppress") {
+    return SFExportPolicy::SFExportSuppress;
+  }
+  return def;
+}
+
+// returns true if the periodic export of a flow is skipped. active tells
+// whether the flow had read or write operations since its last record.
+inline bool skipExport(DataFlowObj *dfo, SFExportPolicy policy, int keepAlive,
+                       bool active) {
+  switch (policy) {
+  case SFExportPolicy::SFExportKeepAlive:
+    if (++dfo->skippedExports < static_cast<uint32_t>(keepAlive)) {
+      return true;
+    }
+    break;
+  case SFExportPolicy::SFExportSuppress:
+    if (!active) {
+      dfo->skippedExports++;
+      return true;
+    }
+    break;
+  default:
+    break;
+  }
+  dfo->skippedExports = 0;
+  return false;
+}
+
+// thread capabilities of a flow, moved out of heartbeat records and back
+class CapStrings {
+private:
+  std::string m_permitted;
+  std::string m_effective;
+  std::string m_inheritable;
+
+public:
+  template <typename T> void take(T &flow) {
+    m_permitted = std::move(flow.tCapPermitted);
+    m_effective = std::move(flow.tCapEffective);
+    m_inheritable = std::move(flow.tCapInheritable);
+    flow.tCapPermitted.clear();
+    flow.tCapEffective.clear();
+    flow.tCapInheritable.clear();
+  }
+  template <typename T> void restore(T &flow) {
+    flow.tCapPermitted = std::move(m_permitted);
+    flow.tCapEffective = std::move(m_effective);
+    flow.tCapInheritable = std::move(m_inheritable);
+  }
+};
+} // namespace sfexport
+
+#endif
@@ -18,11 +18,22 @@
  **/
 
 #include "sffilewriter.h"
+#include <sys/stat.h>
 
 using writer::SFFileWriter;
 
+namespace {
+uint64_t getFileSize(const std::string &path) {
+  struct stat st {};
+  if (stat(path.c_str(), &st) != 0) {
+    return 0;
+  }
+  return st.st_size;
+}
+} // namespace
+
 SFFileWriter::SFFileWriter(context::SysFlowContext *cxt, time_t start)
-    : writer::SysFlowWriter(cxt, start), m_dfw(nullptr) {
+    : writer::SysFlowWriter(cxt, start), m_dfw(nullptr), m_closedBytes(0) {
   m_sysfSchema = utils::loadSchema();
 }
 
@@ -36,9 +47,9 @@ SFFileWriter::~SFFileWriter() {
 int SFFileWriter::initialize() {
   time_t curTime = time(nullptr);
   std::string ofile = getFileName(curTime);
-  m_dfw = new avro::DataFileWriter<SysFlow>(ofile.c_str(), m_sysfSchema,
-                                            COMPRESS_BLOCK_SIZE,
-                                            avro::Codec::DEFLATE_CODEC);
+  m_dfw = new avro::DataFileWriterBase(ofile.c_str(), m_sysfSchema,
+                                       COMPRESS_BLOCK_SIZE,
+                                       avro::Codec::DEFLATE_CODEC);
   setHeaderFile(ofile);
   writeHeader();
   return 0;
@@ -62,15 +73,30 @@ std::string SFFileWriter::getFileName(time_t curTime) {
   return ofile;
 }
 
-void SFFileWriter::reset(time_t curTime) {
+void SFFileWriter::doReset(time_t curTime) {
   std::string ofile = getFileName(curTime);
-  setHeaderFile(ofile);
+  if (ofile == m_cxt->getOutputFile()) {
+    // without rotation a prefix only names the first file, later segments
+    // get a timestamp like rotated files
+    ofile += "." + std::to_string(curTime);
+  }
   m_numRecs = 0;
   m_dfw->close();
+  m_closedBytes += getFileSize(m_hdrFile);
+  setHeaderFile(ofile);
   delete m_dfw;
-  m_dfw = new avro::DataFileWriter<SysFlow>(ofile.c_str(), m_sysfSchema,
-                                            COMPRESS_BLOCK_SIZE,
-                                            avro::Codec::DEFLATE_CODEC);
-  m_start = curTime;
+  m_dfw = new avro::DataFileWriterBase(ofile.c_str(), m_sysfSchema,
+                                       COMPRESS_BLOCK_SIZE,
+                                       avro::Codec::DEFLATE_CODEC);
+  // a reset without rotation (e.g., after a socket reconnect or a sampling
+  // ratio change) must not turn on rotation
+  if (m_start > 0) {
+    m_start = curTime;
+  }
   writeHeader();
 }
+
+// only counts blocks already flushed to the current file
+uint64_t SFFileWriter::getBytesWritten() {
+  return m_closedBytes + getFileSize(m_hdrFile);
+}
@@ -24,6 +24,8 @@
 #include "avro/Decoder.hh"
 #include "avro/Encoder.hh"
 #include "avro/ValidSchema.hh"
+#include "sfbench.h"
+#include "sflatency.h"
 #include "sysflow.h"
 #include "sysflowcontext.h"
 #include "sysflowwriter.h"
@@ -36,8 +38,11 @@ namespace writer {
 class SFFileWriter : public writer::SysFlowWriter {
 private:
   avro::ValidSchema m_sysfSchema;
-  avro::DataFileWriter<SysFlow> *m_dfw;
+  avro::DataFileWriterBase *m_dfw;
+  // bytes written to files closed on rotation
+  uint64_t m_closedBytes;
   std::string getFileName(time_t curTime);
+  void doReset(time_t curTime);
 
 public:
   SFFileWriter(context::SysFlowContext *cxt, time_t start);
@@ -46,10 +51,23 @@ public:
                     sysflow::File *) {
     write(flow);
   }
-  inline void write(SysFlow *flow) { m_dfw->write(*flow); }
+  // same steps as avro::DataFileWriter<T>::write, kept apart so that block
+  // compression can be timed separately from record encoding.
+  inline void write(SysFlow *flow) {
+    {
+      SF_BENCH_STAGE(StageCompress)
+      SF_LATENCY_STAGE(LatFlush)
+      m_dfw->syncIfNeeded();
+    }
+    SF_BENCH_STAGE(StageEncode)
+    SF_LATENCY_STAGE(LatEncode)
+    avro::encode(m_dfw->encoder(), *flow);
+    m_dfw->incr();
+    SF_BENCH_COUNT(numRecords)
+  }
   int initialize();
-  void reset(time_t curTime);
   bool needsReset() { return false; }
+  uint64_t getBytesWritten();
 };
 } // namespace writer
 #endif
@@ -0,0 +1,113 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#ifndef _SF_HLL_
+#define _SF_HLL_
+#include "xxhash.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+// registers of a sketch are indexed by the top HLL_PRECISION bits of a hash
+#define HLL_PRECISION 7
+#define HLL_REGISTERS (1 << HLL_PRECISION)
+
+// HyperLogLog distinct counts with 128 one-byte registers, for a standard
+// error of about 9%. Sketches merge by taking the register maximum, so the
+// sketches of processes add up to the sketch of their container or pod.
+namespace sfhll {
+
+class HyperLogLog {
+private:
+  std::array<uint8_t, HLL_REGISTERS> m_regs{};
+
+public:
+  // adds a hash, returning true if the sketch changed
+  inline bool add(uint64_t hash) {
+    uint32_t idx = hash >> (64 - HLL_PRECISION);
+    // the sentinel bit bounds the rank when the remaining bits are all zero
+    uint64_t rest = (hash << HLL_PRECISION) | (1ULL << (HLL_PRECISION - 1));
+    auto rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+    if (rank > m_regs[idx]) {
+      m_regs[idx] = rank;
+      return true;
+    }
+    return false;
+  }
+  inline bool add(const void *data, size_t len) {
+    return add(XXH3_64bits(data, len));
+  }
+  inline void merge(const HyperLogLog &h) {
+    for (int i = 0; i < HLL_REGISTERS; i++) {
+      m_regs[i] = std::max(m_regs[i], h.m_regs[i]);
+    }
+  }
+  inline bool empty() const {
+    for (uint8_t r : m_regs) {
+      if (r != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+  uint64_t estimate() const {
+    const double m = HLL_REGISTERS;
+    double sum = 0;
+    int zeros = 0;
+    for (uint8_t r : m_regs) {
+      sum += std::ldexp(1.0, -r);
+      zeros += (r == 0);
+    }
+    double e = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+    // linear counting is more accurate for small cardinalities
+    if (e <= 2.5 * m && zeros > 0) {
+      e = m * std::log(m / zeros);
+    }
+    return static_cast<uint64_t>(std::llround(e));
+  }
+};
+
+// distinct remote IPs, remote ports and file paths seen by a process or
+// container
+struct FanOutSketch {
+  HyperLogLog ips;
+  HyperLogLog ports;
+  HyperLogLog files;
+  inline bool empty() const {
+    return ips.empty() && ports.empty() && files.empty();
+  }
+  inline void merge(const FanOutSketch &s) {
+    ips.merge(s.ips);
+    ports.merge(s.ports);
+    files.merge(s.files);
+  }
+  // adds a remote endpoint, returning true if the sketch changed
+  inline bool addEndpoint(uint32_t ip, uint16_t port) {
+    bool changed = ips.add(&ip, sizeof(ip));
+    return ports.add(&port, sizeof(port)) || changed;
+  }
+  inline bool addFile(const std::string &path) {
+    return files.add(path.data(), path.size());
+  }
+};
+} // namespace sfhll
+
+#endif
@@ -0,0 +1,145 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#ifndef _SF_LATENCY_
+#define _SF_LATENCY_
+#include "sfbench.h"
+#include <algorithm>
+#include <cstdint>
+
+// Per-stage latency histograms for production nodes. One in sampleRate calls
+// of each stage is timed, so the unsampled cost is a counter increment. They
+// are only compiled in when building with LATENCY=1 (-DSF_LATENCY).
+namespace sflatency {
+
+enum LatencyStage {
+  LatDispatch,  // syscall switch in the main loop, including handlers
+  LatDataEvent, // DataFlowProcessor::handleDataEvent
+  LatProcEvent, // ControlFlowProcessor::handleProcEvent
+  LatWrite,     // SysFlowWriter::write*, including encoding and flushes
+  LatEncode,    // avro encoding of records
+  LatFlush,     // block compression and flush, or socket send
+  NumLatencyStages
+};
+
+inline const char *getStageName(LatencyStage stage) {
+  static const char *names[NumLatencyStages] = {
+      "dispatch", "data_event", "proc_event", "write", "encode", "flush"};
+  return names[stage];
+}
+
+// Log-linear histogram of ns values: exact below 2^SUB_BITS, then
+// 2^SUB_BITS buckets per power of two, so recorded values are within
+// 1/2^SUB_BITS of their true value over the whole 64-bit range.
+class Histogram {
+public:
+  static constexpr int SUB_BITS = 4;
+  static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+  static constexpr int NUM_BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+  inline void record(uint64_t ns) {
+    m_counts[bucketOf(ns)]++;
+    m_count++;
+    m_sum += ns;
+    m_max = std::max(m_max, ns);
+  }
+  inline uint64_t getCount() const { return m_count; }
+  inline uint64_t getSum() const { return m_sum; }
+  inline uint64_t getMax() const { return m_max; }
+
+  // upper bound of the bucket holding the value at quantile q (0 to 1)
+  uint64_t percentile(double q) const {
+    if (m_count == 0) {
+      return 0;
+    }
+    auto rank = static_cast<uint64_t>(q * m_count);
+    rank = std::min(std::max<uint64_t>(rank, 1), m_count);
+    uint64_t seen = 0;
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+      seen += m_counts[b];
+      if (seen >= rank) {
+        return std::min(bucketUpper(b), m_max);
+      }
+    }
+    return m_max;
+  }
+
+private:
+  uint64_t m_counts[NUM_BUCKETS]{};
+  uint64_t m_count{0};
+  uint64_t m_sum{0};
+  uint64_t m_max{0};
+
+  static inline int bucketOf(uint64_t v) {
+    if (v < SUB_BUCKETS) {
+      return static_cast<int>(v);
+    }
+    int exp = 63 - __builtin_clzll(v);
+    return ((exp - SUB_BITS + 1) << SUB_BITS) |
+           static_cast<int>((v >> (exp - SUB_BITS)) & (SUB_BUCKETS - 1));
+  }
+
+  static inline uint64_t bucketUpper(int b) {
+    if (b < SUB_BUCKETS) {
+      return b;
+    }
+    int exp = (b >> SUB_BITS) + SUB_BITS - 1;
+    int shift = exp - SUB_BITS;
+    uint64_t lower = (1ULL << exp) |
+                     (static_cast<uint64_t>(b & (SUB_BUCKETS - 1)) << shift);
+    return lower + (1ULL << shift) - 1;
+  }
+};
+
+struct LatencyStats {
+  uint32_t sampleRate{1};
+  uint32_t ticks[NumLatencyStages]{};
+  Histogram hist[NumLatencyStages];
+};
+
+inline LatencyStats g_latency;
+
+class StageTimer {
+private:
+  LatencyStage m_stage;
+  uint64_t m_start;
+
+public:
+  explicit StageTimer(LatencyStage stage) : m_stage(stage), m_start(0) {
+    if (++g_latency.ticks[stage] >= g_latency.sampleRate) {
+      g_latency.ticks[stage] = 0;
+      m_start = sfbench::getTimeNs();
+    }
+  }
+  ~StageTimer() {
+    if (m_start != 0) {
+      g_latency.hist[m_stage].record(sfbench::getTimeNs() - m_start);
+    }
+  }
+};
+} // namespace sflatency
+
+#ifdef SF_LATENCY
+#define SF_LATENCY_STAGE(stage)                                                \
+  sflatency::StageTimer sfLatencyTimer(sflatency::stage);
+#else
+#define SF_LATENCY_STAGE(stage)
+#endif
+
+#endif
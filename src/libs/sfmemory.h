@@ -0,0 +1,225 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#ifndef _SF_MEMORY_
+#define _SF_MEMORY_
+#include "datatypes.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Approximate memory accounting for the collector tables. The bytes held by
+// each object (the object itself, its strings, vectors and maps, and the
+// bucket arrays of per-process subtables) are tallied incrementally when
+// objects are created, updated and destroyed. The bucket arrays of the
+// top-level tables are added from their bucket counts when stats are read.
+// Allocator overhead is not included.
+namespace sfmemory {
+
+enum MemTable {
+  MemContainer,
+  MemPod,
+  MemProcess,
+  MemFile,
+  MemNetFlow,
+  MemFileFlow,
+  MemProcFlow,
+  NumMemTables
+};
+
+struct MemoryStats {
+  int64_t bytes[NumMemTables]{};
+};
+
+inline MemoryStats g_memory;
+
+// entries and approximate bytes of a table, as reported in stats
+struct TableStats {
+  MemTable table;
+  uint64_t entries;
+  int64_t bytes;
+};
+
+inline const char *getTableName(MemTable table) {
+  static const char *names[NumMemTables] = {
+      "container", "pod",       "process",  "file",
+      "net_flow",  "file_flow", "proc_flow"};
+  return names[table];
+}
+
+// red-black tree node overhead of std::set and std::map entries
+const size_t TREE_NODE_BYTES = 4 * sizeof(void *);
+
+// heap bytes of a string, zero when it fits in the inline buffer
+inline size_t stringBytes(const std::string &s) {
+  static const size_t inlineCapacity = std::string().capacity();
+  return s.capacity() > inlineCapacity ? s.capacity() + 1 : 0;
+}
+
+template <typename T> inline size_t vectorBytes(const std::vector<T> &v) {
+  return v.capacity() * sizeof(T);
+}
+
+template <typename T> inline size_t bucketBytes(const T &table) {
+  return table.bucket_count() * sizeof(typename T::value_type);
+}
+
+inline size_t mapBytes(const std::map<std::string, std::string> &m) {
+  size_t bytes = 0;
+  for (const auto &kv : m) {
+    bytes += TREE_NODE_BYTES + sizeof(kv) + stringBytes(kv.first) +
+             stringBytes(kv.second);
+  }
+  return bytes;
+}
+
+inline size_t objectBytes(const ProcessObj &p) {
+  const Process &proc = p.proc;
+  size_t bytes = sizeof(ProcessObj) + stringBytes(proc.exe) +
+                 stringBytes(proc.exeArgs) + stringBytes(proc.userName) +
+                 stringBytes(proc.groupName) + stringBytes(proc.cwd) +
+                 vectorBytes(proc.env) + vectorBytes(p.ancestors) +
+                 bucketBytes(p.children);
+  if (p.ext != nullptr) {
+    bytes += sizeof(ProcessExt) +
+             ((p.ext->fanOut != nullptr) ? sizeof(sfhll::FanOutSketch) : 0);
+  }
+  for (const auto &e : proc.env) {
+    bytes += stringBytes(e);
+  }
+  return bytes;
+}
+
+// container ids, file keys and pod uids are held twice: in the object and as
+// the table key
+inline size_t objectBytes(const ContainerObj &c) {
+  return sizeof(ContainerObj) + 2 * stringBytes(c.cont.id) +
+         stringBytes(c.cont.name) + stringBytes(c.cont.image) +
+         stringBytes(c.cont.imageid) +
+         ((c.ext != nullptr) ? sizeof(ContainerExt) : 0);
+}
+
+inline size_t objectBytes(const PodObj &p) {
+  const Pod &pod = p.pod;
+  // the shared_ptr control block is allocated along with the object
+  size_t bytes = sizeof(PodObj) + 2 * sizeof(void *) + 2 * stringBytes(pod.id) +
+                 stringBytes(pod.name) + stringBytes(pod.nodeName) +
+                 stringBytes(pod.namespace_) + vectorBytes(pod.hostIP) +
+                 vectorBytes(pod.internalIP) + mapBytes(pod.labels) +
+                 mapBytes(pod.selectors) + vectorBytes(pod.services);
+  for (const auto &srv : pod.services) {
+    bytes += stringBytes(srv.name) + stringBytes(srv.id) +
+             stringBytes(srv.namespace_) + vectorBytes(srv.clusterIP) +
+             vectorBytes(srv.portList);
+  }
+  return bytes;
+}
+
+inline size_t objectBytes(const FileObj &f) {
+  return sizeof(FileObj) + 2 * stringBytes(f.key) + stringBytes(f.file.path);
+}
+
+// flows are also referenced from the data flow (or process flow) set
+inline size_t objectBytes(const NetFlowObj & /*nf*/) {
+  return sizeof(NetFlowObj) + TREE_NODE_BYTES + sizeof(void *);
+}
+
+inline size_t objectBytes(const NFSummaryObj &s) {
+  return sizeof(NFSummaryObj) + stringBytes(s.netflow.tCapPermitted) +
+         stringBytes(s.netflow.tCapEffective) +
+         stringBytes(s.netflow.tCapInheritable);
+}
+
+inline size_t objectBytes(const ForkSummaryObj &s) {
+  return sizeof(ForkSummaryObj) + stringBytes(s.exe) + stringBytes(s.exeArgs);
+}
+
+inline size_t objectBytes(const FileFlowObj &ff) {
+  return sizeof(FileFlowObj) + TREE_NODE_BYTES + sizeof(void *) +
+         stringBytes(ff.filekey) + 2 * stringBytes(ff.flowkey) +
+         stringBytes(ff.fileflow.tCapPermitted) +
+         stringBytes(ff.fileflow.tCapEffective) +
+         stringBytes(ff.fileflow.tCapInheritable);
+}
+
+inline size_t objectBytes(const FFCoalescedObj &c) {
+  return sizeof(FFCoalescedObj) + stringBytes(c.filekey) +
+         stringBytes(c.fileflow.tCapPermitted) +
+         stringBytes(c.fileflow.tCapEffective) +
+         stringBytes(c.fileflow.tCapInheritable);
+}
+
+inline size_t objectBytes(const ProcessFlowObj & /*pf*/) {
+  return sizeof(ProcessFlowObj) + TREE_NODE_BYTES + sizeof(void *);
+}
+
+// (re)computes the bytes of an object after it is created or updated
+template <typename T> inline void account(MemTable table, T *obj) {
+  auto bytes = static_cast<int64_t>(objectBytes(*obj));
+  g_memory.bytes[table] += bytes - obj->memBytes;
+  obj->memBytes = bytes;
+}
+
+// re-accounts the bucket arrays of the flow tables of a process, which only
+// change when flows are added
+inline void accountSubtables(ProcessObj *p) {
+  auto nf = static_cast<int64_t>(bucketBytes(p->netflows));
+  auto ff = static_cast<int64_t>(bucketBytes(p->fileflows));
+  g_memory.bytes[MemNetFlow] += nf - p->netflowBucketBytes;
+  g_memory.bytes[MemFileFlow] += ff - p->fileflowBucketBytes;
+  p->netflowBucketBytes = nf;
+  p->fileflowBucketBytes = ff;
+}
+
+// removes the bytes of an object about to be destroyed
+template <typename T> inline void release(MemTable table, T *obj) {
+  g_memory.bytes[table] -= obj->memBytes;
+  obj->memBytes = 0;
+}
+
+// allocates the optional state of a process or container on its first use
+// by a feature, and accounts its bytes
+inline ProcessExt *getExt(ProcessObj *p) {
+  if (p->ext == nullptr) {
+    p->ext = std::make_unique<ProcessExt>();
+    account(MemProcess, p);
+  }
+  return p->ext.get();
+}
+
+inline ContainerExt *getExt(ContainerObj *c) {
+  if (c->ext == nullptr) {
+    c->ext = std::make_unique<ContainerExt>();
+    account(MemContainer, c);
+  }
+  return c->ext.get();
+}
+
+// processes also release the bucket arrays of their flow tables
+inline void release(MemTable table, ProcessObj *p) {
+  release<ProcessObj>(table, p);
+  g_memory.bytes[MemNetFlow] -= p->netflowBucketBytes;
+  g_memory.bytes[MemFileFlow] -= p->fileflowBucketBytes;
+  p->netflowBucketBytes = 0;
+  p->fileflowBucketBytes = 0;
+}
+} // namespace sfmemory
+
+#endif
@@ -0,0 +1,102 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#include "sfmetrics.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+using sfmetrics::MetricsFile;
+
+namespace {
+const char *RECORD_TYPE_NAMES[sfmetrics::NumRecordTypes] = {
+    "header",     "container", "process",    "file",
+    "proc_event", "net_flow",  "file_flow",  "file_event",
+    "proc_flow",  "pod",       "k8s_event",  "summary"};
+// largest integer that a double holds exactly
+const double MAX_EXACT_INT = 9007199254740992.0;
+} // namespace
+
+const char *sfmetrics::getRecordTypeName(RecordType type) {
+  return RECORD_TYPE_NAMES[type];
+}
+
+void sfmetrics::appendLabelValue(std::string &out, const std::string &s) {
+  for (char c : s) {
+    if (c == '\\' || c == '"') {
+      out += '\\';
+    } else if (c == '\n') {
+      out += "\\n";
+      continue;
+    }
+    out += c;
+  }
+}
+
+void MetricsFile::addFamily(const std::string &name, const std::string &type,
+                            const std::string &help) {
+  if (name != m_lastName) {
+    m_out << "# HELP " << name << " " << help << "\n"
+          << "# TYPE " << name << " " << type << "\n";
+    m_lastName = name;
+  }
+}
+
+void MetricsFile::addSample(const std::string &name, const std::string &labels,
+                            double value) {
+  m_out << name;
+  if (!labels.empty()) {
+    m_out << "{" << labels << "}";
+  }
+  if (std::floor(value) == value && std::fabs(value) < MAX_EXACT_INT) {
+    m_out << " " << static_cast<int64_t>(value) << "\n";
+  } else {
+    m_out << " " << value << "\n";
+  }
+}
+
+void MetricsFile::summary(
+    const std::string &name, const std::string &help,
+    const std::vector<std::pair<double, double>> &quantiles, double sum,
+    uint64_t count, const std::string &labels) {
+  addFamily(name, "summary", help);
+  std::string sep = labels.empty() ? "" : ",";
+  for (const auto &q : quantiles) {
+    std::ostringstream quantile;
+    quantile << labels << sep << "quantile=\"" << q.first << "\"";
+    addSample(name, quantile.str(), q.second);
+  }
+  addSample(name + "_sum", labels, sum);
+  addSample(name + "_count", labels, count);
+}
+
+bool MetricsFile::commit() {
+  std::string tmpPath = m_path + ".tmp";
+  std::ofstream out(tmpPath, std::ios::trunc);
+  if (!out.is_open()) {
+    return false;
+  }
+  out << m_out.str();
+  out.close();
+  if (out.fail()) {
+    std::remove(tmpPath.c_str());
+    return false;
+  }
+  return std::rename(tmpPath.c_str(), m_path.c_str()) == 0;
+}
@@ -0,0 +1,138 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#ifndef _SF_METRICS_
+#define _SF_METRICS_
+#include "sfbench.h"
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Collector metrics. Counters are plain integers bumped from the (single
+// threaded) event loop; gauges such as table sizes are read when the metrics
+// file is written, so the hot path only pays for a few increments.
+namespace sfmetrics {
+
+enum RecordType {
+  RecHeader,
+  RecContainer,
+  RecProcess,
+  RecFile,
+  RecProcessEvent,
+  RecNetworkFlow,
+  RecFileFlow,
+  RecFileEvent,
+  RecProcessFlow,
+  RecPod,
+  RecK8sEvent,
+  RecSummary,
+  NumRecordTypes
+};
+
+struct Metrics {
+  uint64_t records[NumRecordTypes]{};
+  uint64_t writerErrors{0};
+  uint64_t reconnects{0};
+  uint64_t samplingChanges{0};
+  // table sweeps and flow expiry scans
+  uint64_t sweeps{0};
+  uint64_t sweepNs{0};
+  uint64_t sweptEntities{0};
+  uint64_t expiryScans{0};
+  uint64_t expiryNs{0};
+  uint64_t expiredRecords{0};
+  // network connection summaries
+  uint64_t summarizedFlows{0};
+  uint64_t summaryRecords{0};
+  uint64_t summaryOverflows{0};
+  // coalesced file flows
+  uint64_t coalescedFlows{0};
+  uint64_t coalescedRecords{0};
+  uint64_t coalesceOverflows{0};
+  // mmaps of files already mapped in the current output file
+  uint64_t dedupedMmaps{0};
+  // fork storm summaries
+  uint64_t forkStormEvents{0};
+  uint64_t forkSummaryRecords{0};
+  // container and pod rollup records
+  uint64_t rollupRecords{0};
+  // process fan-out estimate records
+  uint64_t fanOutRecords{0};
+  // events suppressed by the userspace rate limiter
+  uint64_t rateLimitedEvents{0};
+};
+
+inline Metrics g_metrics;
+
+inline void countRecord(RecordType type) { g_metrics.records[type]++; }
+
+inline void recordSweep(uint64_t startNs, int swept) {
+  g_metrics.sweeps++;
+  g_metrics.sweepNs += sfbench::getTimeNs() - startNs;
+  g_metrics.sweptEntities += swept;
+}
+
+inline void recordExpiryScan(uint64_t startNs, int expired) {
+  g_metrics.expiryScans++;
+  g_metrics.expiryNs += sfbench::getTimeNs() - startNs;
+  g_metrics.expiredRecords += expired;
+}
+
+const char *getRecordTypeName(RecordType type);
+
+// appends a string to a Prometheus label value; the text format only escapes
+// backslashes, double quotes and newlines.
+void appendLabelValue(std::string &out, const std::string &s);
+
+// Builds a metrics file in the Prometheus text exposition format, as read by
+// the node exporter textfile collector. The file is written to a temporary
+// file first and renamed, so scrapers never see a partial file.
+class MetricsFile {
+private:
+  std::string m_path;
+  std::ostringstream m_out;
+  std::string m_lastName;
+  void addFamily(const std::string &name, const std::string &type,
+                 const std::string &help);
+  void addSample(const std::string &name, const std::string &labels,
+                 double value);
+
+public:
+  explicit MetricsFile(const std::string &path) : m_path(path) {}
+  inline void counter(const std::string &name, const std::string &help,
+                      double value, const std::string &labels = "") {
+    addFamily(name, "counter", help);
+    addSample(name, labels, value);
+  }
+  inline void gauge(const std::string &name, const std::string &help,
+                    double value, const std::string &labels = "") {
+    addFamily(name, "gauge", help);
+    addSample(name, labels, value);
+  }
+  // quantiles holds (quantile, value) pairs
+  void summary(const std::string &name, const std::string &help,
+               const std::vector<std::pair<double, double>> &quantiles,
+               double sum, uint64_t count, const std::string &labels = "");
+  bool commit();
+};
+} // namespace sfmetrics
+
+#endif
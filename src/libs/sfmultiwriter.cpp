@@ -29,15 +29,20 @@ SFMultiWriter::~SFMultiWriter() {}
 
 int SFMultiWriter::initialize() {
   m_fileWriter.initialize();
+  setHeaderFile(m_fileWriter.getHeaderFile());
   m_sockWriter.setHeaderFile(m_fileWriter.getHeaderFile());
   m_sockWriter.initialize();
   return 0;
 }
 
-void SFMultiWriter::reset(time_t curTime) {
+void SFMultiWriter::doReset(time_t curTime) {
   m_fileWriter.reset(curTime);
+  setHeaderFile(m_fileWriter.getHeaderFile());
   m_sockWriter.setHeaderFile(m_fileWriter.getHeaderFile());
   m_sockWriter.reset(curTime);
   m_numRecs = 0;
-  m_start = curTime;
+  // see SFFileWriter::doReset
+  if (m_start > 0) {
+    m_start = curTime;
+  }
 }
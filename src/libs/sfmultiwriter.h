@@ -31,6 +31,7 @@ private:
   SFSocketWriter m_sockWriter;
   SFFileWriter m_fileWriter;
   DEFINE_LOGGER();
+  void doReset(time_t curTime);
 
 public:
   SFMultiWriter(context::SysFlowContext *cxt, time_t start);
@@ -44,10 +45,12 @@ public:
     m_fileWriter.write(flow);
   }
   int initialize();
-  void reset(time_t curTime);
   bool needsReset() {
     return m_sockWriter.needsReset() || m_fileWriter.needsReset();
   }
+  uint64_t getBytesWritten() {
+    return m_sockWriter.getBytesWritten() + m_fileWriter.getBytesWritten();
+  }
 };
 } // namespace writer
 #endif
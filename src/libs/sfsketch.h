@@ -0,0 +1,184 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#ifndef _SF_SKETCH_
+#define _SF_SKETCH_
+#include "xxhash.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// sketch dimensions: SKETCH_DEPTH rows of SKETCH_WIDTH counters each
+#define SKETCH_DEPTH 4
+#define SKETCH_WIDTH 4096
+// largest top-K table
+#define HEAVY_HITTERS_MAX 1000
+// a heavy hitter is suggested as a drop filter rule when it holds at least
+// this share of the events of a window of at least HH_SUGGEST_MIN_EVENTS
+#define HH_SUGGEST_SHARE 0.1
+#define HH_SUGGEST_MIN_EVENTS 1000
+
+// Bounded-memory heavy hitter tracking over the event stream. A count-min
+// sketch estimates the number of events of every key seen in a window, and
+// a top-K table keeps the keys with the largest estimates. Keys are hashed
+// once; their names are only built when they enter the top-K table.
+namespace sfsketch {
+
+enum SketchType {
+  SketchFile,
+  SketchEndpoint,
+  SketchExe,
+  SketchContainer,
+  NumSketches
+};
+
+inline const char *getSketchName(SketchType type) {
+  static const char *names[NumSketches] = {"file", "endpoint", "exe",
+                                           "container"};
+  return names[type];
+}
+
+struct HeavyHitter {
+  uint64_t hash;
+  uint64_t count;
+  std::string key;
+};
+
+// count-min sketch with conservative update: only the smallest counters of
+// a key are incremented, which tightens the overestimate of light keys.
+class CountMin {
+private:
+  std::vector<uint32_t> m_counters;
+
+public:
+  CountMin() : m_counters(SKETCH_DEPTH * SKETCH_WIDTH, 0) {}
+  // adds an event of a key and returns its estimated count
+  inline uint32_t add(uint64_t hash) {
+    uint32_t *cells[SKETCH_DEPTH];
+    uint64_t h2 = (hash >> 32) | 1;
+    uint32_t min = UINT32_MAX;
+    for (int i = 0; i < SKETCH_DEPTH; i++) {
+      cells[i] = &m_counters[i * SKETCH_WIDTH +
+                             ((hash + i * h2) & (SKETCH_WIDTH - 1))];
+      min = std::min(min, *cells[i]);
+    }
+    if (min == UINT32_MAX) {
+      return min;
+    }
+    for (uint32_t *cell : cells) {
+      if (*cell == min) {
+        (*cell)++;
+      }
+    }
+    return min + 1;
+  }
+  inline void clear() { std::fill(m_counters.begin(), m_counters.end(), 0); }
+};
+
+class TopK {
+private:
+  std::vector<HeavyHitter> m_top;
+  size_t m_k;
+  uint64_t m_min{0};
+
+public:
+  explicit TopK(size_t k) : m_k(k) { m_top.reserve(k); }
+  // offers a key with its estimated count. key() builds the name of the key,
+  // and is only called when the key enters the table.
+  template <typename F>
+  inline void offer(uint64_t hash, uint64_t count, F key) {
+    if (m_top.size() == m_k && count <= m_min) {
+      return;
+    }
+    auto it = std::find_if(m_top.begin(), m_top.end(),
+                           [hash](const HeavyHitter &h) {
+                             return h.hash == hash;
+                           });
+    if (it != m_top.end()) {
+      it->count = count;
+    } else if (m_top.size() < m_k) {
+      m_top.push_back({hash, count, key()});
+    } else {
+      it = std::min_element(m_top.begin(), m_top.end(),
+                            [](const HeavyHitter &a, const HeavyHitter &b) {
+                              return a.count < b.count;
+                            });
+      *it = {hash, count, key()};
+    }
+    if (m_top.size() == m_k) {
+      m_min = std::min_element(m_top.begin(), m_top.end(),
+                               [](const HeavyHitter &a, const HeavyHitter &b) {
+                                 return a.count < b.count;
+                               })
+                  ->count;
+    }
+  }
+  // returns the heavy hitters sorted by decreasing count
+  inline std::vector<HeavyHitter> sorted() const {
+    std::vector<HeavyHitter> top = m_top;
+    std::sort(top.begin(), top.end(),
+              [](const HeavyHitter &a, const HeavyHitter &b) {
+                return a.count > b.count;
+              });
+    return top;
+  }
+  inline void clear() {
+    m_top.clear();
+    m_min = 0;
+  }
+};
+
+// Sketches of files, destination endpoints, executables and containers over
+// a window of events. The top-K tables of the last complete window are kept
+// for the stats and metrics readers.
+class HeavyHitters {
+private:
+  CountMin m_sketches[NumSketches];
+  std::vector<TopK> m_top;
+  std::vector<HeavyHitter> m_last[NumSketches];
+  uint64_t m_events{0};
+  uint64_t m_lastEvents{0};
+
+public:
+  explicit HeavyHitters(size_t k) : m_top(NumSketches, TopK(k)) {}
+  template <typename F>
+  inline void add(SketchType type, const char *data, size_t len, F key) {
+    uint64_t hash = XXH3_64bits(data, len);
+    m_top[type].offer(hash, m_sketches[type].add(hash), key);
+  }
+  inline void countEvent() { m_events++; }
+  // ends the current window, keeping its top-K tables
+  inline void rotate() {
+    for (int i = 0; i < NumSketches; i++) {
+      m_last[i] = m_top[i].sorted();
+      m_top[i].clear();
+      m_sketches[i].clear();
+    }
+    m_lastEvents = m_events;
+    m_events = 0;
+  }
+  inline const std::vector<HeavyHitter> &getLast(SketchType type) const {
+    return m_last[type];
+  }
+  inline uint64_t getLastEvents() const { return m_lastEvents; }
+};
+} // namespace sfsketch
+
+#endif
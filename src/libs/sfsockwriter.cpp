@@ -25,7 +25,7 @@ CREATE_LOGGER(SFSocketWriter, "sysflow.sfsocketwriter");
 
 SFSocketWriter::SFSocketWriter(context::SysFlowContext *cxt, time_t start)
     : writer::SysFlowWriter(cxt, start), m_sock(0), m_errTimer(0),
-      m_reconnectInterval(CONNECT_INTERVAL), m_reset(false) {
+      m_reconnectInterval(CONNECT_INTERVAL), m_reset(false), m_bytesOut(0) {
   m_sockPath = m_cxt->getSocketFile();
 }
 
@@ -49,6 +49,7 @@ int SFSocketWriter::connectSocket() {
   if ((m_sock = socket(AF_UNIX, SOCK_SEQPACKET, 0)) < 0) {
     SF_ERROR(m_logger, "Unable to create domain socket object. Error Code: "
                            << std::strerror(errno));
+    sfmetrics::g_metrics.writerErrors++;
     return -1;
   }
   memset(&addr, 0, sizeof(addr));
@@ -58,14 +59,18 @@ int SFSocketWriter::connectSocket() {
     SF_ERROR(m_logger, "Unable to connect to domain socket: "
                            << m_sockPath
                            << ". Error Code: " << std::strerror(errno));
+    sfmetrics::g_metrics.writerErrors++;
     return -1;
   }
   return 0;
 }
 
-void SFSocketWriter::reset(time_t curTime) {
+void SFSocketWriter::doReset(time_t curTime) {
   m_numRecs = 0;
-  m_start = curTime;
+  // see SFFileWriter::doReset
+  if (m_start > 0) {
+    m_start = curTime;
+  }
   writeHeader();
   m_reset = false;
 }
@@ -48,8 +48,10 @@ private:
   time_t m_errTimer;
   time_t m_reconnectInterval;
   bool m_reset;
+  uint64_t m_bytesOut;
   DEFINE_LOGGER();
   int connectSocket();
+  void doReset(time_t curTime);
 
 public:
   SFSocketWriter(context::SysFlowContext *cxt, time_t start);
@@ -62,14 +64,21 @@ public:
 
   inline void write(SysFlow *flow) {
     if (m_errTimer == 0) {
-      avro::encode(*m_encoder, *flow);
-      m_encoder->flush();
+      {
+        SF_LATENCY_STAGE(LatEncode)
+        avro::encode(*m_encoder, *flow);
+        m_encoder->flush();
+      }
+      SF_LATENCY_STAGE(LatFlush)
       if (send(m_sock, (const void *)m_stringStream.str().c_str(),
                m_stringStream.str().size(), 0) < 0) {
         SF_ERROR(m_logger, "Unable to send on domain socket:  "
                                << m_sockPath
                                << ". Error Code: " << std::strerror(errno));
+        sfmetrics::g_metrics.writerErrors++;
         m_errTimer = time(nullptr);
+      } else {
+        m_bytesOut += m_stringStream.str().size();
       }
       m_stringStream.str("");
       m_stringStream.clear();
@@ -86,6 +95,7 @@ public:
           m_errTimer = 0;
           m_reconnectInterval = CONNECT_INTERVAL;
           m_reset = true;
+          sfmetrics::g_metrics.reconnects++;
         } else {
           m_reconnectInterval = 2 * m_reconnectInterval;
           if (m_reconnectInterval > 8 * CONNECT_INTERVAL) {
@@ -100,8 +110,8 @@ public:
     }
   }
   int initialize();
-  void reset(time_t curTime);
   bool needsReset() { return m_reset; }
+  uint64_t getBytesWritten() { return m_bytesOut; }
 };
 } // namespace writer
 #endif
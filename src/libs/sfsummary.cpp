@@ -0,0 +1,116 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#include "sfsummary.h"
+#include "utils.h"
+
+using sfsummary::Record;
+using sfsummary::SummaryWriter;
+
+namespace {
+const char *PROCESS_COUNT_NAMES[sfsummary::NumProcessCounts] = {"mmaps",
+                                                                "suppressed"};
+} // namespace
+
+const char *sfsummary::getProcessCountName(ProcessCount count) {
+  return PROCESS_COUNT_NAMES[count];
+}
+
+Record::Record(const char *type, int64_t ts) {
+  m_json = "{\"version\":" + std::to_string(SF_SUMMARY_VERSION) +
+           ",\"type\":\"" + type + "\",\"ts\":" + std::to_string(ts);
+}
+
+void Record::addKey(const char *key) {
+  m_json += ",\"";
+  m_json += key;
+  m_json += "\":";
+}
+
+void Record::add(const char *key, const std::string &val) {
+  addKey(key);
+  m_json += '"';
+  utils::appendEscaped(m_json, val);
+  m_json += '"';
+}
+
+void Record::addOID(const char *key, const OID &oid) {
+  addKey(key);
+  m_json += "{\"hpid\":" + std::to_string(oid.hpid) +
+            ",\"createTS\":" + std::to_string(oid.createTS) + "}";
+}
+
+void Record::addJSON(const char *key, const std::string &json) {
+  addKey(key);
+  m_json += json;
+}
+
+void Record::addFlow(const sysflow::NetworkFlow &nf) {
+  m_json += ",\"flow\":{\"type\":\"NetworkFlow\"";
+  addOID("procOID", nf.procOID);
+  add("tid", nf.tid);
+  add("fd", nf.fd);
+  add("ts", nf.ts);
+  add("endTs", nf.endTs);
+  m_json += "}";
+}
+
+void Record::addFlow(const sysflow::FileFlow &ff) {
+  static const char HEX[] = "0123456789abcdef";
+  m_json += ",\"flow\":{\"type\":\"FileFlow\"";
+  addOID("procOID", ff.procOID);
+  add("tid", ff.tid);
+  add("fd", ff.fd);
+  add("ts", ff.ts);
+  add("endTs", ff.endTs);
+  addKey("fileOID");
+  m_json += '"';
+  for (uint8_t b : ff.fileOID) {
+    m_json += HEX[b >> 4];
+    m_json += HEX[b & 0xf];
+  }
+  m_json += "\"}";
+}
+
+void Record::addFlow(const sysflow::ProcessFlow &pf) {
+  m_json += ",\"flow\":{\"type\":\"ProcessFlow\"";
+  addOID("procOID", pf.procOID);
+  add("ts", pf.ts);
+  add("endTs", pf.endTs);
+  m_json += "}";
+}
+
+void Record::addCounts(const ProcessCounts &counts) {
+  for (int i = 0; i < NumProcessCounts; i++) {
+    if (counts.counts[i] > 0) {
+      add(getProcessCountName(static_cast<ProcessCount>(i)), counts.counts[i]);
+    }
+  }
+}
+
+bool SummaryWriter::open(const std::string &path) {
+  m_out.open(path, std::ios::trunc);
+  return m_out.is_open();
+}
+
+void SummaryWriter::close() {
+  if (m_out.is_open()) {
+    m_out.close();
+  }
+}
@@ -0,0 +1,91 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#ifndef _SF_SUMMARY_
+#define _SF_SUMMARY_
+#include "sysflow.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <type_traits>
+
+// Version of the summary record format, bumped on incompatible changes.
+#define SF_SUMMARY_VERSION 1
+
+// Summary records carry what the SysFlow schema has no fields for: counts
+// folded into flows, rollups, sketches and rate limit accounting. They are
+// written as JSON lines to a summary file that rotates with the SysFlow
+// output. Every record starts with the format version, its type and a
+// timestamp; records about a SysFlow flow name it in a "flow" member, and
+// are written right after the flow. See "Summary records" in LIBS.md.
+namespace sfsummary {
+
+// Per process counts of events that are not written as records of their
+// own. They are held until the next flow of the process is written, and
+// written with it in a ProcessCounts record.
+enum ProcessCount { CountMmaps, CountSuppressed, NumProcessCounts };
+
+struct ProcessCounts {
+  uint64_t counts[NumProcessCounts]{};
+};
+
+const char *getProcessCountName(ProcessCount count);
+
+class Record {
+private:
+  std::string m_json;
+  void addKey(const char *key);
+
+public:
+  Record(const char *type, int64_t ts);
+  template <typename T> inline void add(const char *key, T val) {
+    static_assert(std::is_integral<T>::value, "summary values are integers");
+    addKey(key);
+    m_json += std::to_string(val);
+  }
+  void add(const char *key, const std::string &val);
+  inline void add(const char *key, const char *val) {
+    add(key, std::string(val));
+  }
+  void addOID(const char *key, const sysflow::OID &oid);
+  // appends a member whose value is already JSON (e.g., an array)
+  void addJSON(const char *key, const std::string &json);
+  // names the flow the record is about, by record type, process OID, thread,
+  // fd (and file OID) and timestamps
+  void addFlow(const sysflow::NetworkFlow &nf);
+  void addFlow(const sysflow::FileFlow &ff);
+  void addFlow(const sysflow::ProcessFlow &pf);
+  // appends the non-zero counts
+  void addCounts(const ProcessCounts &counts);
+  inline std::string str() const { return m_json + "}"; }
+};
+
+class SummaryWriter {
+private:
+  std::ofstream m_out;
+
+public:
+  inline bool isOpen() { return m_out.is_open(); }
+  bool open(const std::string &path);
+  void close();
+  inline void write(const Record &rec) { m_out << rec.str() << '\n'; }
+};
+} // namespace sfsummary
+
+#endif
@@ -0,0 +1,410 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#ifndef _SF_TABLE_
+#define _SF_TABLE_
+#include <algorithm>
+#include <cstdint>
+#include <google/dense_hash_map>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Hash table layer for the collector caches. By default tables are
+// google::dense_hash_maps; building with FLAT_TABLES=1 (-DSF_FLAT_TABLES)
+// switches them to FlatMap, which needs no empty or deleted sentinel keys
+// and leaves no tombstones behind on erase.
+namespace sftable {
+
+// Open addressing map with robin hood probing and backward shift deletion.
+// Probe sequences never wrap around: the slot array has an overflow tail
+// past the last bucket, and the table grows when a probe would run past it.
+// As a result, erasing an entry only moves entries stored after it one slot
+// back, so erase(iterator) returns the next entry to visit and forward
+// iteration stays valid while erasing.
+template <typename K, typename V, typename Hash, typename Eq> class FlatMap {
+public:
+  typedef K key_type;
+  typedef V data_type;
+  typedef std::pair<K, V> value_type;
+  typedef std::size_t size_type;
+  typedef Hash hasher;
+  typedef Eq key_equal;
+
+  class iterator {
+  private:
+    FlatMap *m_map;
+    size_type m_pos;
+    friend class FlatMap;
+
+  public:
+    iterator() : m_map(nullptr), m_pos(0) {}
+    iterator(FlatMap *map, size_type pos) : m_map(map), m_pos(pos) {}
+    value_type &operator*() const { return m_map->m_slots[m_pos]; }
+    value_type *operator->() const { return &m_map->m_slots[m_pos]; }
+    iterator &operator++() {
+      m_pos = m_map->nextUsed(m_pos + 1);
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator it = *this;
+      ++(*this);
+      return it;
+    }
+    bool operator==(const iterator &it) const { return m_pos == it.m_pos; }
+    bool operator!=(const iterator &it) const { return m_pos != it.m_pos; }
+  };
+
+  explicit FlatMap(size_type n = 0, const Hash &hash = Hash(),
+                   const Eq &eq = Eq())
+      : m_hash(hash), m_eq(eq), m_size(0), m_maxLoad(DEFAULT_MAX_LOAD) {
+    allocate(bucketsFor(n));
+  }
+
+  // sentinels are not needed; kept for compatibility with dense_hash_map
+  void set_empty_key(const K & /*key*/) {}
+  void set_deleted_key(const K & /*key*/) {}
+
+  iterator begin() { return iterator(this, nextUsed(0)); }
+  iterator end() { return iterator(this, m_slots.size()); }
+  size_type size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  size_type bucket_count() const { return m_mask + 1; }
+  float max_load_factor() const { return m_maxLoad; }
+  // sets the load factor at which the table doubles its buckets, growing
+  // right away if the table is already above it
+  void max_load_factor(float maxLoad) {
+    m_maxLoad = maxLoad;
+    m_maxSize = (m_mask + 1) * m_maxLoad;
+    if (m_size > m_maxSize) {
+      rehash(bucketsFor(m_size));
+    }
+  }
+
+  iterator find(const K &key) {
+    size_type pos = m_hash(key) & m_mask;
+    for (uint8_t dist = 1; dist <= m_dist[pos]; dist++, pos++) {
+      if (m_eq(m_slots[pos].first, key)) {
+        return iterator(this, pos);
+      }
+    }
+    return end();
+  }
+
+  std::pair<iterator, bool> insert(const value_type &kv) {
+    iterator it = find(kv.first);
+    if (it != end()) {
+      return std::make_pair(it, false);
+    }
+    return std::make_pair(iterator(this, add(value_type(kv))), true);
+  }
+
+  V &operator[](const K &key) {
+    iterator it = find(key);
+    if (it == end()) {
+      it = iterator(this, add(value_type(key, V())));
+    }
+    return it->second;
+  }
+
+  size_type erase(const K &key) {
+    iterator it = find(key);
+    if (it == end()) {
+      return 0;
+    }
+    erase(it);
+    return 1;
+  }
+
+  iterator erase(iterator it) {
+    size_type pos = it.m_pos;
+    while (m_dist[pos + 1] > 1) {
+      m_slots[pos] = std::move(m_slots[pos + 1]);
+      m_dist[pos] = m_dist[pos + 1] - 1;
+      pos++;
+    }
+    m_slots[pos] = value_type();
+    m_dist[pos] = 0;
+    m_size--;
+    return iterator(this, nextUsed(it.m_pos));
+  }
+
+  void clear() {
+    std::fill(m_dist.begin(), m_dist.end(), 0);
+    std::fill(m_slots.begin(), m_slots.end(), value_type());
+    m_size = 0;
+  }
+
+  // makes room for n entries without growing
+  void resize(size_type n) {
+    size_type buckets = bucketsFor(std::max(n, m_size));
+    if (buckets > m_mask + 1) {
+      rehash(buckets);
+    }
+  }
+
+  // rebuilds the table with the fewest buckets that hold max(n, size())
+  // entries, if that is fewer than it has now
+  void compact(size_type n) {
+    size_type buckets = bucketsFor(std::max(n, m_size));
+    if (buckets < m_mask + 1) {
+      rehash(buckets);
+    }
+  }
+
+private:
+  // default load factor at which the table doubles its buckets
+  static constexpr float DEFAULT_MAX_LOAD = 0.8f;
+  // longest probe sequence (in slots) and size of the overflow tail
+  static constexpr size_type MAX_DIST = 128;
+  static constexpr size_type MIN_BUCKETS = 16;
+
+  Hash m_hash;
+  Eq m_eq;
+  size_type m_size;
+  size_type m_mask;
+  size_type m_maxSize;
+  float m_maxLoad;
+  std::vector<value_type> m_slots;
+  // probe distance + 1 of the entry in each slot, 0 for empty slots; the
+  // extra last element is a guard for backward shifts
+  std::vector<uint8_t> m_dist;
+
+  size_type bucketsFor(size_type n) const {
+    size_type buckets = MIN_BUCKETS;
+    while (buckets * m_maxLoad < n) {
+      buckets <<= 1;
+    }
+    return buckets;
+  }
+
+  void allocate(size_type buckets) {
+    size_type numSlots = buckets + std::min(buckets, MAX_DIST);
+    m_mask = buckets - 1;
+    m_maxSize = buckets * m_maxLoad;
+    m_slots.assign(numSlots, value_type());
+    m_dist.assign(numSlots + 1, 0);
+  }
+
+  size_type nextUsed(size_type pos) const {
+    while (pos < m_slots.size() && m_dist[pos] == 0) {
+      pos++;
+    }
+    return pos;
+  }
+
+  void rehash(size_type buckets) {
+    std::vector<value_type> slots;
+    std::vector<uint8_t> dist;
+    slots.swap(m_slots);
+    dist.swap(m_dist);
+    allocate(buckets);
+    for (size_type i = 0; i < slots.size(); i++) {
+      if (dist[i] != 0) {
+        place(std::move(slots[i]));
+      }
+    }
+  }
+
+  // adds a new entry and returns its slot
+  size_type add(value_type &&kv) {
+    if (m_size + 1 > m_maxSize) {
+      rehash((m_mask + 1) << 1);
+    }
+    m_size++;
+    return place(std::move(kv));
+  }
+
+  // stores kv, displacing entries closer to their home bucket, and returns
+  // the slot of kv
+  size_type place(value_type &&kv) {
+    size_type pos = m_hash(kv.first) & m_mask;
+    size_type placed = m_slots.size();
+    uint8_t dist = 1;
+    while (m_dist[pos] != 0) {
+      if (m_dist[pos] < dist) {
+        std::swap(kv, m_slots[pos]);
+        std::swap(dist, m_dist[pos]);
+        if (placed == m_slots.size()) {
+          placed = pos;
+        }
+      }
+      pos++;
+      dist++;
+      if (pos == m_slots.size() || dist > MAX_DIST) {
+        // the displaced entry doesn't fit: grow and find the new slot of
+        // the entry being added
+        K key = (placed == m_slots.size()) ? kv.first : m_slots[placed].first;
+        rehash((m_mask + 1) << 1);
+        place(std::move(kv));
+        return find(key).m_pos;
+      }
+    }
+    m_slots[pos] = std::move(kv);
+    m_dist[pos] = dist;
+    return (placed == m_slots.size()) ? pos : placed;
+  }
+};
+
+// Allocates objects from contiguous slabs of SLAB_SIZE objects, so that
+// objects created together share cache lines and pages instead of being
+// spread across the heap. Objects never move once created, and destroyed
+// objects are recycled (most recently freed first) before a new slab is
+// allocated. Slabs are only released when the pool is destroyed, after all
+// objects have been destroyed by their owner.
+template <typename T, std::size_t SLAB_SIZE = 1024> class SlabPool {
+public:
+  typedef std::size_t size_type;
+
+  SlabPool() : m_free(nullptr), m_size(0) {}
+  ~SlabPool() {
+    for (Slot *slab : m_slabs) {
+      delete[] slab;
+    }
+  }
+  SlabPool(const SlabPool &) = delete;
+  SlabPool &operator=(const SlabPool &) = delete;
+
+  template <typename... Args> T *create(Args &&...args) {
+    if (m_free == nullptr) {
+      grow();
+    }
+    Slot *slot = m_free;
+    m_free = slot->next;
+    try {
+      T *obj = new (slot->storage) T(std::forward<Args>(args)...);
+      m_size++;
+      return obj;
+    } catch (...) {
+      slot->next = m_free;
+      m_free = slot;
+      throw;
+    }
+  }
+
+  void destroy(T *obj) {
+    obj->~T();
+    Slot *slot = reinterpret_cast<Slot *>(obj);
+    slot->next = m_free;
+    m_free = slot;
+    m_size--;
+  }
+
+  size_type size() const { return m_size; }
+  size_type capacity() const { return m_slabs.size() * SLAB_SIZE; }
+
+private:
+  union Slot {
+    Slot *next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  std::vector<Slot *> m_slabs;
+  Slot *m_free;
+  size_type m_size;
+
+  void grow() {
+    Slot *slab = new Slot[SLAB_SIZE];
+    m_slabs.push_back(slab);
+    for (size_type i = SLAB_SIZE; i > 0; i--) {
+      slab[i - 1].next = m_free;
+      m_free = &slab[i - 1];
+    }
+  }
+};
+
+#ifdef SF_FLAT_TABLES
+template <typename K, typename V, typename Hash, typename Eq>
+using HashMap = FlatMap<K, V, Hash, Eq>;
+#else
+template <typename K, typename V, typename Hash, typename Eq>
+using HashMap = google::dense_hash_map<K, V, Hash, Eq>;
+#endif
+
+// Erases the entry at it and returns an iterator to the next entry, so that
+// tables can be erased from while iterating with either backend.
+template <typename K, typename V, typename Hash, typename Eq>
+inline typename FlatMap<K, V, Hash, Eq>::iterator
+eraseNext(FlatMap<K, V, Hash, Eq> &table,
+          typename FlatMap<K, V, Hash, Eq>::iterator it) {
+  return table.erase(it);
+}
+
+template <typename K, typename V, typename Hash, typename Eq>
+inline typename google::dense_hash_map<K, V, Hash, Eq>::iterator
+eraseNext(google::dense_hash_map<K, V, Hash, Eq> &table,
+          typename google::dense_hash_map<K, V, Hash, Eq>::iterator it) {
+  // dense_hash_map marks erased entries as deleted in place, so iterators
+  // stay valid
+  table.erase(it++);
+  return it;
+}
+
+// Sets the load factor at which a table grows.
+template <typename K, typename V, typename Hash, typename Eq>
+inline void setMaxLoad(FlatMap<K, V, Hash, Eq> &table, float maxLoad) {
+  table.max_load_factor(maxLoad);
+}
+
+template <typename K, typename V, typename Hash, typename Eq>
+inline void setMaxLoad(google::dense_hash_map<K, V, Hash, Eq> &table,
+                       float maxLoad) {
+  // keeps the ratio between the shrink and grow thresholds of the defaults
+  // (0.2 and 0.5)
+  table.set_resizing_parameters(maxLoad * 0.4f, maxLoad);
+}
+
+// Rebuilds a table with the fewest buckets that hold max(n, size()) entries.
+template <typename K, typename V, typename Hash, typename Eq>
+inline void compact(FlatMap<K, V, Hash, Eq> &table, std::size_t n) {
+  table.compact(n);
+}
+
+template <typename K, typename V, typename Hash, typename Eq>
+inline void compact(google::dense_hash_map<K, V, Hash, Eq> &table,
+                    std::size_t n) {
+  // copies are sized to fit their entries, and drop deleted entries
+  google::dense_hash_map<K, V, Hash, Eq> copy(table);
+  copy.resize(n);
+  table.swap(copy);
+}
+
+// Applies the configured initial capacity and maximum load factor (0 keeps
+// the backend default) to a table.
+template <typename Table>
+inline void configure(Table &table, std::size_t n, float maxLoad) {
+  if (maxLoad > 0) {
+    setMaxLoad(table, maxLoad);
+  }
+  table.resize(n);
+}
+
+// Compacts a table filled to less than a quarter of its grow threshold,
+// keeping room for at least n entries. Returns true if the table shrank.
+template <typename Table> inline bool shrink(Table &table, std::size_t n) {
+  double capacity = table.bucket_count() * table.max_load_factor();
+  if (table.size() * 4 >= capacity || n * 2 >= capacity) {
+    return false;
+  }
+  compact(table, std::max(n, static_cast<std::size_t>(table.size())));
+  return true;
+}
+} // namespace sftable
+
+#endif
@@ -18,18 +18,42 @@
  **/
 
 #include "sysflowcontext.h"
+#include "sfexport.h"
 #include "engine/bpf/bpf_public.h"
 #include "modutils.h"
+#include "samplingcontroller.h"
 #include "sfmodes.h"
+#include "sfsketch.h"
+#include "sysflowexception.h"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <dirent.h>
 #include <utility>
 
 using context::SysFlowContext;
 
 CREATE_LOGGER(SysFlowContext, "sysflow.sysflowcontext");
 
+namespace {
+// an integer setting and its valid (inclusive) range
+struct IntSetting {
+  const char *name;
+  int value;
+  int min;
+  int max;
+};
+
+void throwInvalid(const std::string &what, const std::string &value) {
+  throw sfexception::SysFlowException(what + ", got " + value,
+                                      sfexception::InvalidConfiguration);
+}
+} // namespace
+
 SysFlowContext::SysFlowContext(SysFlowConfig *config)
     : m_nfExportInterval(30), m_nfExpireInterval(60), m_offline(false),
-      m_statsInterval(30), m_nodeIP(), m_k8sEnabled(false) {
+      m_statsInterval(30), m_nodeIP(), m_k8sEnabled(false),
+      m_droppingMode(false), m_samplingRatio(1) {
   m_config = config;
   m_offline = !config->scapInputPath.empty();
   if (!m_offline) {
@@ -89,6 +113,8 @@ SysFlowContext::SysFlowContext(SysFlowConfig *config)
     SF_INFO(m_logger, "Starting dropping mode with sampling rate: "
                           << config->samplingRatio)
     m_inspector->start_dropping_mode(config->samplingRatio);
+    m_droppingMode = true;
+    m_samplingRatio = config->samplingRatio;
   }
 
   const char *fileOnly = std::getenv(FILE_ONLY);
@@ -113,6 +139,189 @@ SysFlowContext::SysFlowContext(SysFlowConfig *config)
     SF_INFO(m_logger, "Enabled process flow mode")
   }
 
+  const char *dropFilter = std::getenv(SF_DROP_FILTER);
+  if (dropFilter != nullptr) {
+    config->dropFilterPath = std::string(dropFilter);
+  }
+
+  const char *maxSampling = std::getenv(SF_MAX_SAMPLING_RATIO);
+  if (maxSampling != nullptr) {
+    config->maxSamplingRatio = std::atoi(maxSampling);
+  }
+
+  const char *metricsFile = std::getenv(SF_METRICS_FILE);
+  if (metricsFile != nullptr) {
+    config->metricsFile = std::string(metricsFile);
+  }
+
+  const char *summaryFile = std::getenv(SF_SUMMARY_FILE);
+  if (summaryFile != nullptr) {
+    config->summaryFile = std::string(summaryFile);
+  }
+
+  const char *latencySampling = std::getenv(SF_LATENCY_SAMPLING);
+  if (latencySampling != nullptr) {
+    config->latencySampling = std::atoi(latencySampling);
+  }
+
+  const char *aggregation = std::getenv(SF_FLOW_AGGREGATION);
+  if (aggregation != nullptr && strcmp(aggregation, "thread") == 0) {
+    config->flowAggregation = SFFlowAggregation::SFThreadFlows;
+  } else if (aggregation != nullptr && strcmp(aggregation, "socket") == 0) {
+    config->flowAggregation = SFFlowAggregation::SFSocketFlows;
+  } else if (aggregation != nullptr && strcmp(aggregation, "process") == 0) {
+    config->flowAggregation = SFFlowAggregation::SFProcessFlows;
+  }
+  if (config->flowAggregation == SFFlowAggregation::SFSocketFlows) {
+    SF_INFO(m_logger, "Network flows aggregated per socket")
+  } else if (config->flowAggregation == SFFlowAggregation::SFProcessFlows) {
+    SF_INFO(m_logger, "Network flows aggregated per process")
+  }
+
+  const char *summaryKeys = std::getenv(SF_CONN_SUMMARY_MAX_KEYS);
+  if (summaryKeys != nullptr) {
+    config->connSummaryMaxKeys = std::atoi(summaryKeys);
+  }
+  const char *summaryPerProc = std::getenv(SF_CONN_SUMMARY_MAX_PER_PROC);
+  if (summaryPerProc != nullptr) {
+    config->connSummaryMaxPerProc = std::atoi(summaryPerProc);
+  }
+  if (config->connSummaryMaxKeys > 0) {
+    SF_INFO(m_logger, "Summarizing completed network flows, up to "
+                          << config->connSummaryMaxKeys << " summaries")
+  }
+
+  const char *coalesceMax = std::getenv(SF_FILE_COALESCE_MAX);
+  if (coalesceMax != nullptr) {
+    config->fileCoalesceMax = std::atoi(coalesceMax);
+  }
+  if (config->fileCoalesceMax > 0) {
+    SF_INFO(m_logger, "Coalescing completed file flows, up to "
+                          << config->fileCoalesceMax << " per process")
+  }
+
+  const char *mmapDedup = std::getenv(SF_MMAP_DEDUP);
+  if (mmapDedup != nullptr && strcmp(mmapDedup, "1") == 0) {
+    config->mmapDedup = true;
+  } else if (mmapDedup != nullptr) {
+    config->mmapDedup = false;
+  }
+
+  const char *forkStorm = std::getenv(SF_FORK_STORM_THRESHOLD);
+  if (forkStorm != nullptr) {
+    config->forkStormThreshold = std::atoi(forkStorm);
+  }
+  if (config->forkStormThreshold > 0) {
+    SF_INFO(m_logger, "Summarizing fork storms above "
+                          << config->forkStormThreshold
+                          << " children per parent per second")
+  }
+
+  const char *exportInterval = std::getenv(SF_FLOW_EXPORT_INTERVAL);
+  if (exportInterval != nullptr) {
+    config->flowExportInterval = std::atoi(exportInterval);
+  }
+  const char *expireInterval = std::getenv(SF_FLOW_EXPIRE_INTERVAL);
+  if (expireInterval != nullptr) {
+    config->flowExpireInterval = std::atoi(expireInterval);
+  }
+  if (config->flowExportInterval != 0) {
+    m_nfExportInterval = config->flowExportInterval;
+  }
+  if (config->flowExpireInterval != 0) {
+    m_nfExpireInterval = config->flowExpireInterval;
+  }
+  const char *netExport = std::getenv(SF_NET_FLOW_EXPORT);
+  if (netExport != nullptr) {
+    config->netFlowExport =
+        sfexport::parsePolicy(netExport, config->netFlowExport);
+  }
+  const char *fileExport = std::getenv(SF_FILE_FLOW_EXPORT);
+  if (fileExport != nullptr) {
+    config->fileFlowExport =
+        sfexport::parsePolicy(fileExport, config->fileFlowExport);
+  }
+  if (config->netFlowExport != SFExportPolicy::SFExportFull ||
+      config->fileFlowExport != SFExportPolicy::SFExportFull) {
+    SF_INFO(m_logger, "Flow export policies enabled, net: "
+                          << config->netFlowExport
+                          << " file: " << config->fileFlowExport)
+  }
+
+  const char *rollup = std::getenv(SF_CONTAINER_ROLLUP);
+  if (rollup != nullptr && strcmp(rollup, "1") == 0) {
+    config->containerRollup = true;
+  } else if (rollup != nullptr) {
+    config->containerRollup = false;
+  }
+  if (config->containerRollup) {
+    SF_INFO(m_logger, "Container activity rollups enabled")
+  }
+
+  const char *heavyHitters = std::getenv(SF_HEAVY_HITTERS);
+  if (heavyHitters != nullptr) {
+    config->heavyHitterK = std::atoi(heavyHitters);
+  }
+  const char *hhRecords = std::getenv(SF_HEAVY_HITTER_RECORDS);
+  if (hhRecords != nullptr && strcmp(hhRecords, "1") == 0) {
+    config->heavyHitterRecords = true;
+  } else if (hhRecords != nullptr) {
+    config->heavyHitterRecords = false;
+  }
+  if (config->heavyHitterK > 0) {
+    SF_INFO(m_logger, "Tracking top " << config->heavyHitterK
+                                      << " heavy hitters per sketch")
+  }
+
+  const char *fanOut = std::getenv(SF_FAN_OUT);
+  if (fanOut != nullptr && strcmp(fanOut, "1") == 0) {
+    config->fanOut = true;
+  } else if (fanOut != nullptr) {
+    config->fanOut = false;
+  }
+  if (config->fanOut) {
+    SF_INFO(m_logger, "Fan-out estimates enabled")
+  }
+
+  const char *rateLimit = std::getenv(SF_RATE_LIMIT);
+  if (rateLimit != nullptr) {
+    config->rateLimit = std::atoi(rateLimit);
+  }
+  const char *rateBurst = std::getenv(SF_RATE_LIMIT_BURST);
+  if (rateBurst != nullptr) {
+    config->rateLimitBurst = std::atoi(rateBurst);
+  }
+  const char *rateScope = std::getenv(SF_RATE_LIMIT_SCOPE);
+  if (rateScope != nullptr && strcmp(rateScope, "process") == 0) {
+    config->rateLimitScope = SFRateLimitScope::SFRateLimitProcess;
+  } else if (rateScope != nullptr && strcmp(rateScope, "container") == 0) {
+    config->rateLimitScope = SFRateLimitScope::SFRateLimitContainer;
+  }
+  if (config->rateLimit > 0) {
+    SF_INFO(m_logger,
+            "Data events rate limited to "
+                << config->rateLimit << "/s per "
+                << ((config->rateLimitScope ==
+                     SFRateLimitScope::SFRateLimitContainer)
+                        ? "container"
+                        : "process"))
+  }
+
+  const char *autoSize = std::getenv(SF_TABLE_AUTOSIZE);
+  if (autoSize != nullptr && strcmp(autoSize, "1") == 0) {
+    config->autoSizeTables = true;
+  } else if (autoSize != nullptr) {
+    config->autoSizeTables = false;
+  }
+
+  if (config->autoSizeTables) {
+    if (config->scapInputPath.empty()) {
+      autoSizeTables();
+    } else {
+      SF_INFO(m_logger, "Table auto-sizing ignored when reading a trace file")
+    }
+  }
+
   if (!isNoFilesMode()) {
     const char *fileRead = std::getenv(FILE_READ_MODE);
     if (fileRead != nullptr && strcmp(fileRead, "0") == 0) {
@@ -166,6 +375,55 @@ SysFlowContext::SysFlowContext(SysFlowConfig *config)
   m_callback = config->callback;
 }
 
+void SysFlowContext::autoSizeTables() {
+  DIR *proc = opendir("/proc");
+  if (proc == nullptr) {
+    SF_WARN(m_logger, "Unable to open /proc for table auto-sizing: "
+                          << std::strerror(errno))
+    return;
+  }
+  int64_t numProcs = 0;
+  int64_t numFds = 0;
+  struct dirent *entry;
+  while ((entry = readdir(proc)) != nullptr) {
+    if (!std::isdigit(static_cast<unsigned char>(entry->d_name[0]))) {
+      continue;
+    }
+    numProcs++;
+    std::string fdPath = std::string("/proc/") + entry->d_name + "/fd";
+    DIR *fds = opendir(fdPath.c_str());
+    if (fds == nullptr) {
+      continue;
+    }
+    struct dirent *fd;
+    while ((fd = readdir(fds)) != nullptr) {
+      if (fd->d_name[0] != '.') {
+        numFds++;
+      }
+    }
+    closedir(fds);
+  }
+  closedir(proc);
+
+  // leave room for the processes and files seen over a rotation interval
+  auto size = [](int64_t n) {
+    return static_cast<int>(
+        std::min<int64_t>(std::max<int64_t>(n * 2, AUTO_TABLE_MIN),
+                          AUTO_TABLE_MAX));
+  };
+  m_config->procTableSize = size(numProcs);
+  m_config->fileTableSize = size(numFds);
+  SF_INFO(m_logger, "Tables sized from /proc ("
+                        << numProcs << " processes, " << numFds
+                        << " fds). Process table: " << m_config->procTableSize
+                        << " File table: " << m_config->fileTableSize)
+}
+
+void SysFlowContext::setSamplingRatio(int ratio) {
+  m_inspector->start_dropping_mode(ratio);
+  m_samplingRatio = ratio;
+}
+
 SysFlowContext::~SysFlowContext() {
   if (m_inspector != nullptr) {
     m_inspector->close();
@@ -177,6 +435,77 @@ SysFlowContext::~SysFlowContext() {
   }
 }
 
+void SysFlowContext::validate() {
+  const IntSetting settings[] = {
+      {"Metrics interval", hasMetrics() ? getMetricsInterval() : 1, 1,
+       INT_MAX},
+      {"File table size", getFileTableSize(), 0, INT_MAX},
+      {"Flow table size", getFlowTableSize(), 0, INT_MAX},
+      {"Connection summary key limit", getConnSummaryMaxKeys(), 0, INT_MAX},
+      {"Connection summary per-process limit", getConnSummaryMaxPerProc(), 0,
+       INT_MAX},
+      {"Heavy hitters", getHeavyHitterK(), 0, HEAVY_HITTERS_MAX},
+      {"Rate limit", m_config->rateLimit, 0, INT_MAX},
+      {"Rate limit burst", m_config->rateLimitBurst, 0, INT_MAX},
+      {"Fork storm threshold", getForkStormThreshold(), 0, INT_MAX},
+      {"File coalescing limit", getFileCoalesceMax(), 0, INT_MAX},
+      {"Flow export interval", getNFExportInterval(), 1, INT_MAX},
+      {"Flow expire interval", getNFExpireInterval(), 1, INT_MAX},
+      {"Network flow keep-alive", getNetFlowKeepAlive(), 1, INT_MAX},
+      {"File flow keep-alive", getFileFlowKeepAlive(), 1, INT_MAX},
+#ifdef SF_LATENCY
+      {"Latency sampling", getLatencySampling(), 1, INT_MAX},
+#endif
+  };
+  for (const IntSetting &s : settings) {
+    if (s.value < s.min || s.value > s.max) {
+      std::string range = (s.max == INT_MAX)
+                              ? "at least " + std::to_string(s.min)
+                              : "between " + std::to_string(s.min) + " and " +
+                                    std::to_string(s.max);
+      throwInvalid(std::string(s.name) + " must be " + range,
+                   std::to_string(s.value));
+    }
+  }
+  if (isAdaptiveSampling()) {
+    for (int ratio : {getMinSamplingRatio(), getMaxSamplingRatio()}) {
+      if (ratio <= 0 || ratio > SAMPLING_MAX_RATIO ||
+          (ratio & (ratio - 1)) != 0) {
+        throwInvalid("Adaptive sampling ratios must be powers of 2 up to " +
+                         std::to_string(SAMPLING_MAX_RATIO),
+                     std::to_string(ratio));
+      }
+    }
+  }
+  float maxLoad = getTableMaxLoad();
+  if (maxLoad != 0 && (maxLoad < 0.1f || maxLoad > 0.95f)) {
+    throwInvalid("Table max load factor must be between 0.1 and 0.95",
+                 std::to_string(maxLoad));
+  }
+  // these features replace SysFlow records (or their counts) with summary
+  // records, which socket and callback outputs cannot carry
+  if (getSummaryFile().empty() && !isOutputFile()) {
+    const std::pair<const char *, bool> summarized[] = {
+        {"Connection summaries", isConnSummary()},
+        {"File flow coalescing", isFileCoalesce()},
+        {"Mmap deduplication", isMmapDedup()},
+        {"Fork storm summarization", getForkStormThreshold() > 0},
+        {"Container rollups", isContainerRollup()},
+        {"Heavy hitter records", isHeavyHitters() && isHeavyHitterRecords()},
+        {"Fan-out estimates", isFanOut()},
+        {"Rate limiting", getRateLimit() > 0},
+    };
+    for (const auto &f : summarized) {
+      if (f.second) {
+        throwInvalid(std::string(f.first) +
+                         " require a summary file with socket or callback "
+                         "output",
+                     "none");
+      }
+    }
+  }
+}
+
 std::string SysFlowContext::getExporterID() {
   if (m_config->exporterID.empty()) {
     const scap_machine_info *mi = m_inspector->get_machine_info();
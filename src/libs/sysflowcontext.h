@@ -43,10 +43,43 @@
 #define ENABLE_PROC_FLOW "ENABLE_PROC_FLOW"
 #define SF_K8S_API_URL "SF_K8S_API_URL"
 #define SF_K8S_API_CERT "SF_K8S_API_CERT"
+#define SF_DROP_FILTER "SF_DROP_FILTER"
+#define SF_METRICS_FILE "SF_METRICS_FILE"
+#define SF_SUMMARY_FILE "SF_SUMMARY_FILE"
+#define SF_LATENCY_SAMPLING "SF_LATENCY_SAMPLING"
+#define SF_MAX_SAMPLING_RATIO "SF_MAX_SAMPLING_RATIO"
+#define SF_TABLE_AUTOSIZE "SF_TABLE_AUTOSIZE"
+#define SF_FLOW_AGGREGATION "SF_FLOW_AGGREGATION"
+#define SF_CONN_SUMMARY_MAX_KEYS "SF_CONN_SUMMARY_MAX_KEYS"
+#define SF_CONN_SUMMARY_MAX_PER_PROC "SF_CONN_SUMMARY_MAX_PER_PROC"
+#define SF_FILE_COALESCE_MAX "SF_FILE_COALESCE_MAX"
+#define SF_MMAP_DEDUP "SF_MMAP_DEDUP"
+#define SF_FORK_STORM_THRESHOLD "SF_FORK_STORM_THRESHOLD"
+#define SF_FLOW_EXPORT_INTERVAL "SF_FLOW_EXPORT_INTERVAL"
+#define SF_FLOW_EXPIRE_INTERVAL "SF_FLOW_EXPIRE_INTERVAL"
+#define SF_NET_FLOW_EXPORT "SF_NET_FLOW_EXPORT"
+#define SF_FILE_FLOW_EXPORT "SF_FILE_FLOW_EXPORT"
+#define SF_CONTAINER_ROLLUP "SF_CONTAINER_ROLLUP"
+#define SF_HEAVY_HITTERS "SF_HEAVY_HITTERS"
+#define SF_HEAVY_HITTER_RECORDS "SF_HEAVY_HITTER_RECORDS"
+#define SF_FAN_OUT "SF_FAN_OUT"
+#define SF_RATE_LIMIT "SF_RATE_LIMIT"
+#define SF_RATE_LIMIT_BURST "SF_RATE_LIMIT_BURST"
+#define SF_RATE_LIMIT_SCOPE "SF_RATE_LIMIT_SCOPE"
+// export intervals per keep-alive record
+#define KEEPALIVE_INTERVALS 4
 #define SF_PROBE_BPF_FILEPATH ".falco/falco-bpf.o"
 #define SF_BPF_ENV_VARIABLE "FALCO_BPF_PROBE"
 #define DRIVER_HOME "HOME"
 
+// default initial capacities of the process, container and pod tables
+#define PROC_TABLE_SIZE 50000
+#define CONT_TABLE_SIZE 100
+#define K8S_TABLE_SIZE 100
+// bounds of table sizes set from /proc
+#define AUTO_TABLE_MIN 1024
+#define AUTO_TABLE_MAX 4000000
+
 namespace context {
 
 class SysFlowContext {
@@ -57,6 +90,8 @@ private:
   int m_statsInterval;
   std::string m_nodeIP;
   bool m_k8sEnabled;
+  bool m_droppingMode;
+  int m_samplingRatio;
   SysFlowCallback m_callback;
   SysFlowConfig *m_config;
   bool m_hasPrefix;
@@ -64,6 +99,7 @@ private:
   sinsp *m_inspector;
   DEFINE_LOGGER();
   void loadDriverInfo();
+  void autoSizeTables();
   void checkModule();
   void openInspector(libsinsp::events::set<ppm_sc_code> ppm_sc);
   libsinsp::events::set<ppm_sc_code>
@@ -96,6 +132,80 @@ public:
   inline bool isFileOnly() { return m_config->fileOnly; }
   inline int getFileRead() { return m_config->fileReadMode; }
   inline bool isK8sEnabled() { return m_k8sEnabled; }
+  inline bool hasDropFilter() { return !m_config->dropFilterPath.empty(); }
+  inline std::string getDropFilterPath() { return m_config->dropFilterPath; }
+  inline bool hasMetrics() { return !m_config->metricsFile.empty(); }
+  inline std::string getMetricsFile() { return m_config->metricsFile; }
+  inline int getMetricsInterval() { return m_config->metricsInterval; }
+  inline std::string getSummaryFile() { return m_config->summaryFile; }
+  inline int getLatencySampling() { return m_config->latencySampling; }
+  inline bool isDroppingMode() { return m_droppingMode; }
+  inline int getSamplingRatio() { return m_samplingRatio; }
+  inline int getMinSamplingRatio() { return m_config->samplingRatio; }
+  inline int getMaxSamplingRatio() { return m_config->maxSamplingRatio; }
+  inline int getProcTableSize() {
+    return m_config->procTableSize > 0 ? m_config->procTableSize
+                                       : PROC_TABLE_SIZE;
+  }
+  inline int getContTableSize() {
+    return m_config->contTableSize > 0 ? m_config->contTableSize
+                                       : CONT_TABLE_SIZE;
+  }
+  inline int getPodTableSize() {
+    return m_config->podTableSize > 0 ? m_config->podTableSize
+                                      : K8S_TABLE_SIZE;
+  }
+  inline int getFileTableSize() { return m_config->fileTableSize; }
+  inline int getFlowTableSize() { return m_config->flowTableSize; }
+  inline float getTableMaxLoad() { return m_config->tableMaxLoad; }
+  inline bool isShrinkTables() { return m_config->shrinkTables; }
+  inline SFFlowAggregation getFlowAggregation() {
+    return m_config->flowAggregation;
+  }
+  inline bool isConnSummary() { return m_config->connSummaryMaxKeys > 0; }
+  inline int getConnSummaryMaxKeys() { return m_config->connSummaryMaxKeys; }
+  inline int getConnSummaryMaxPerProc() {
+    return m_config->connSummaryMaxPerProc;
+  }
+  inline bool isFileCoalesce() { return m_config->fileCoalesceMax > 0; }
+  inline int getFileCoalesceMax() { return m_config->fileCoalesceMax; }
+  inline bool isMmapDedup() { return m_config->mmapDedup; }
+  inline bool isForkStormSummary() { return m_config->forkStormThreshold > 0; }
+  inline int getForkStormThreshold() { return m_config->forkStormThreshold; }
+  inline SFExportPolicy getNetFlowExport() { return m_config->netFlowExport; }
+  inline SFExportPolicy getFileFlowExport() {
+    return m_config->fileFlowExport;
+  }
+  inline int getNetFlowKeepAlive() {
+    return (m_config->netFlowKeepAlive != 0) ? m_config->netFlowKeepAlive
+                                             : KEEPALIVE_INTERVALS;
+  }
+  inline bool isContainerRollup() { return m_config->containerRollup; }
+  inline bool isHeavyHitters() { return m_config->heavyHitterK > 0; }
+  inline int getHeavyHitterK() { return m_config->heavyHitterK; }
+  inline bool isHeavyHitterRecords() { return m_config->heavyHitterRecords; }
+  inline bool isFanOut() { return m_config->fanOut; }
+  inline bool isRateLimit() { return m_config->rateLimit > 0; }
+  inline int getRateLimit() { return m_config->rateLimit; }
+  inline int getRateLimitBurst() {
+    return (m_config->rateLimitBurst != 0) ? m_config->rateLimitBurst
+                                           : m_config->rateLimit;
+  }
+  inline SFRateLimitScope getRateLimitScope() {
+    return m_config->rateLimitScope;
+  }
+  inline int getFileFlowKeepAlive() {
+    return (m_config->fileFlowKeepAlive != 0) ? m_config->fileFlowKeepAlive
+                                              : KEEPALIVE_INTERVALS;
+  }
+  inline bool isAdaptiveSampling() {
+    return m_droppingMode &&
+           m_config->maxSamplingRatio > m_config->samplingRatio;
+  }
+  void setSamplingRatio(int ratio);
+  // checks the numeric settings, throwing an InvalidConfiguration
+  // SysFlowException for the first one out of range
+  void validate();
   inline bool isConsumerMode() {
     return m_config->collectionMode == SFSysCallMode::SFConsumerMode;
   }
@@ -36,7 +36,8 @@ enum SysFlowError {
   DriverLibsMismatch,
   EventParsingError,
   ProcResourceNotFound,
-  OperationNotSupported
+  OperationNotSupported,
+  InvalidConfiguration
 };
 
 class SysFlowException : public std::runtime_error {
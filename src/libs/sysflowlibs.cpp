@@ -64,6 +64,39 @@ SysFlowConfig *sysflowlibscpp::InitializeSysFlowConfig() {
   conf->collectionMode = SFSysCallMode::SFFlowMode;
   conf->cpuBuffers = 0;
   conf->driverType = NO_DRIVER;
+  conf->dropFilterPath = "";
+  conf->metricsFile = "";
+  conf->metricsInterval = 15;
+  conf->summaryFile = "";
+  conf->latencySampling = 64;
+  conf->maxSamplingRatio = 0;
+  conf->procTableSize = 0;
+  conf->contTableSize = 0;
+  conf->podTableSize = 0;
+  conf->fileTableSize = 0;
+  conf->flowTableSize = 0;
+  conf->tableMaxLoad = 0;
+  conf->shrinkTables = false;
+  conf->autoSizeTables = false;
+  conf->flowAggregation = SFFlowAggregation::SFThreadFlows;
+  conf->connSummaryMaxKeys = 0;
+  conf->connSummaryMaxPerProc = 0;
+  conf->fileCoalesceMax = 0;
+  conf->mmapDedup = false;
+  conf->forkStormThreshold = 0;
+  conf->flowExportInterval = 0;
+  conf->flowExpireInterval = 0;
+  conf->netFlowExport = SFExportPolicy::SFExportFull;
+  conf->fileFlowExport = SFExportPolicy::SFExportFull;
+  conf->netFlowKeepAlive = 0;
+  conf->fileFlowKeepAlive = 0;
+  conf->containerRollup = false;
+  conf->heavyHitterK = 0;
+  conf->heavyHitterRecords = false;
+  conf->fanOut = false;
+  conf->rateLimit = 0;
+  conf->rateLimitBurst = 0;
+  conf->rateLimitScope = SFRateLimitScope::SFRateLimitProcess;
   return conf;
 }
 
@@ -83,6 +116,16 @@ int SysFlowDriver::run() {
   return 0;
 }
 
+int SysFlowDriver::getSamplingRatio() { return m_cxt->getSamplingRatio(); }
+
+std::vector<sysflowlibscpp::SysFlowTableStats> SysFlowDriver::getTableStats() {
+  std::vector<sysflowlibscpp::SysFlowTableStats> stats;
+  for (const auto &t : m_processor->getTableStats()) {
+    stats.push_back({sfmemory::getTableName(t.table), t.entries, t.bytes});
+  }
+  return stats;
+}
+
 std::string SysFlowDriver::getVersion() {
   std::stringstream str;
   str << SF_VERSION << "+" << SF_BUILD;
@@ -21,7 +21,9 @@
 #define __SYSFLOW_LIBS_C_PLUS_PLUS_API__
 #include "sfconfig.h"
 #include "sysflowexception.h"
+#include <cstdint>
 #include <string>
+#include <vector>
 namespace writer {
 class SysFlowWriter;
 }
@@ -37,6 +39,13 @@ namespace sysflowlibscpp {
 
 SysFlowConfig *InitializeSysFlowConfig();
 
+// number of entries and approximate bytes held by a collector table
+struct SysFlowTableStats {
+  std::string table;
+  uint64_t entries;
+  int64_t bytes;
+};
+
 class SysFlowDriver {
 private:
   context::SysFlowContext *m_cxt;
@@ -49,6 +58,12 @@ public:
   void exit();
   int run();
   std::string getVersion();
+  // sampling ratio of the records currently being exported; it only changes
+  // at SysFlow headers
+  int getSamplingRatio();
+  // entries and approximate memory of the container, pod, process, file and
+  // flow tables
+  std::vector<SysFlowTableStats> getTableStats();
 };
 
 } // namespace sysflowlibscpp
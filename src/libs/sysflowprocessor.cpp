@@ -35,6 +35,13 @@ SysFlowProcessor::SysFlowProcessor(context::SysFlowContext *cxt,
   }
 
   m_statsTime = 0;
+  m_sweepTime = 0;
+  m_shrinkPending = false;
+  m_metricsTime = 0;
+  m_cxt->validate();
+#ifdef SF_LATENCY
+  sflatency::g_latency.sampleRate = m_cxt->getLatencySampling();
+#endif
   if (writer == nullptr) {
     if (m_cxt->isDomainSocket() && m_cxt->isOutputFile()) {
       SF_INFO(m_logger, "Multi-writer (socket + file writer) loaded.")
@@ -66,18 +73,39 @@ SysFlowProcessor::SysFlowProcessor(context::SysFlowContext *cxt,
   }
 
   m_containerCxt = new container::ContainerContext(m_cxt, m_writer, m_k8sCxt);
-  m_fileCxt = new file::FileContext(m_containerCxt, m_writer);
+  m_fileCxt = new file::FileContext(m_cxt, m_containerCxt, m_writer);
   m_processCxt =
       new process::ProcessContext(m_cxt, m_containerCxt, m_fileCxt, m_writer);
   m_dfPrcr =
       new dataflow::DataFlowProcessor(m_cxt, m_writer, m_processCxt, m_fileCxt);
   m_ctrlPrcr = new controlflow::ControlFlowProcessor(m_cxt, m_writer,
                                                      m_processCxt, m_dfPrcr);
+
+  m_dropFilter = nullptr;
+  if (m_cxt->hasDropFilter()) {
+    m_dropFilter = new dropfilter::DropFilter(m_cxt->getDropFilterPath());
+  }
+
+  m_sampling = nullptr;
+  m_samplingChanged = false;
+  if (m_cxt->isAdaptiveSampling()) {
+    SF_INFO(m_logger, "Adaptive sampling enabled with sampling ratios from "
+                          << m_cxt->getMinSamplingRatio() << " to "
+                          << m_cxt->getMaxSamplingRatio())
+    m_sampling = new sampling::SamplingController(
+        m_cxt, m_cxt->getMinSamplingRatio(), m_cxt->getMaxSamplingRatio());
+  }
 }
 
 SysFlowProcessor::~SysFlowProcessor() {
   delete m_dfPrcr;
   delete m_ctrlPrcr;
+  if (m_dropFilter != nullptr) {
+    delete m_dropFilter;
+  }
+  if (m_sampling != nullptr) {
+    delete m_sampling;
+  }
   if (m_k8sCxt != nullptr) {
     delete m_k8sCxt;
   }
@@ -100,27 +128,145 @@ void SysFlowProcessor::printStats() {
                 << " FileFlow Table: " << m_dfPrcr->getFFSize()
                 << " ProcFlow Table: " << m_ctrlPrcr->getSize()
                 << " Num Records Written: " << m_writer->getNumRecs());
+    std::ostringstream mem;
+    int64_t total = 0;
+    for (const auto &t : getTableStats()) {
+      mem << " " << sfmemory::getTableName(t.table) << ": " << t.bytes / 1024;
+      total += t.bytes;
+    }
+    SF_INFO(m_logger, "Table Memory (KB):" << mem.str()
+                                           << " total: " << total / 1024);
+    if (m_dropFilter != nullptr) {
+      m_dropFilter->printStats();
+    }
+    if (m_cxt->isRateLimit()) {
+      SF_INFO(m_logger, "Rate Limited Events: "
+                            << sfmetrics::g_metrics.rateLimitedEvents);
+    }
+    const sfsketch::HeavyHitters *hh = m_dfPrcr->getHeavyHitters();
+    if (hh != nullptr) {
+      for (int i = 0; i < sfsketch::NumSketches; i++) {
+        auto type = static_cast<sfsketch::SketchType>(i);
+        std::ostringstream top;
+        for (const sfsketch::HeavyHitter &h : hh->getLast(type)) {
+          top << " " << h.key << ": " << h.count;
+        }
+        SF_INFO(m_logger, "Heavy hitters (" << sfsketch::getSketchName(type)
+                                            << ", of "
+                                            << hh->getLastEvents()
+                                            << " events):" << top.str());
+      }
+    }
+#ifdef SF_LATENCY
+    printLatencyStats();
+#endif
+  }
+}
+
+std::vector<sfmemory::TableStats> SysFlowProcessor::getTableStats() {
+  bool k8s = m_cxt->isK8sEnabled();
+  return {
+      {sfmemory::MemContainer, static_cast<uint64_t>(m_containerCxt->getSize()),
+       m_containerCxt->getMemBytes()},
+      {sfmemory::MemPod, static_cast<uint64_t>(k8s ? m_k8sCxt->getSize() : 0),
+       k8s ? m_k8sCxt->getMemBytes() : 0},
+      {sfmemory::MemProcess, static_cast<uint64_t>(m_processCxt->getSize()),
+       m_processCxt->getMemBytes()},
+      {sfmemory::MemFile, static_cast<uint64_t>(m_fileCxt->getSize()),
+       m_fileCxt->getMemBytes()},
+      {sfmemory::MemNetFlow, static_cast<uint64_t>(m_dfPrcr->getNFSize()),
+       sfmemory::g_memory.bytes[sfmemory::MemNetFlow]},
+      {sfmemory::MemFileFlow, static_cast<uint64_t>(m_dfPrcr->getFFSize()),
+       sfmemory::g_memory.bytes[sfmemory::MemFileFlow]},
+      {sfmemory::MemProcFlow, static_cast<uint64_t>(m_ctrlPrcr->getSize()),
+       sfmemory::g_memory.bytes[sfmemory::MemProcFlow]}};
+}
+
+void SysFlowProcessor::printLatencyStats() {
+  for (int i = 0; i < sflatency::NumLatencyStages; i++) {
+    const sflatency::Histogram &h = sflatency::g_latency.hist[i];
+    SF_INFO(m_logger,
+            "Latency (ns) "
+                << sflatency::getStageName(
+                       static_cast<sflatency::LatencyStage>(i))
+                << ": Samples: " << h.getCount()
+                << " p50: " << h.percentile(0.5)
+                << " p90: " << h.percentile(0.9)
+                << " p99: " << h.percentile(0.99)
+                << " p99.9: " << h.percentile(0.999)
+                << " Max: " << h.getMax());
+  }
+}
+
+void SysFlowProcessor::sweepTables() {
+  time_t curTime = utils::getCurrentTime(m_cxt);
+  if (difftime(curTime, m_sweepTime) < SWEEP_INTERVAL) {
+    return;
+  }
+  uint64_t start = sfbench::getTimeNs();
+  int numDeleted = m_processCxt->sweepProcesses(SWEEP_BUDGET);
+  numDeleted += m_containerCxt->sweepContainers(SWEEP_BUDGET);
+  if (m_cxt->isK8sEnabled()) {
+    numDeleted += m_k8sCxt->sweepPods(SWEEP_BUDGET);
+  }
+  numDeleted += m_fileCxt->sweepFiles(SWEEP_BUDGET);
+  sfmetrics::recordSweep(start, numDeleted);
+  if (numDeleted) {
+    SF_DEBUG(m_logger, "Entities removed by table sweep: " << numDeleted);
+  } else if (m_shrinkPending) {
+    // the sweep has caught up with the last rotation
+    shrinkTables();
+    m_shrinkPending = false;
   }
+  m_sweepTime = curTime;
 }
 
-void SysFlowProcessor::clearTables() {
-  m_processCxt->clearProcesses();
-  m_containerCxt->clearContainers();
+void SysFlowProcessor::shrinkTables() {
+  int numShrunk = m_processCxt->shrinkTable() + m_containerCxt->shrinkTable() +
+                  m_fileCxt->shrinkTable();
   if (m_cxt->isK8sEnabled()) {
-    m_k8sCxt->clearPods();
+    numShrunk += m_k8sCxt->shrinkTable();
+  }
+  if (numShrunk) {
+    SF_DEBUG(m_logger, "Tables compacted after rotation: " << numShrunk);
+  }
+}
+
+void SysFlowProcessor::checkSamplingRatio() {
+  if (m_sampling != nullptr && m_sampling->checkSampling()) {
+    m_samplingChanged = true;
   }
-  m_fileCxt->clearFiles();
 }
 
 bool SysFlowProcessor::checkAndRotateFile() {
   bool fileRotated = false;
   time_t curTime = utils::getCurrentTime(m_cxt);
 
-  if (m_writer->isExpired(curTime) || m_writer->needsReset()) {
+  if (m_writer->isExpired(curTime) || m_writer->needsReset() ||
+      m_samplingChanged) {
     printStats();
+    // connection summaries, coalesced flows and held process counts never
+    // span output files
+    if (m_cxt->isConnSummary()) {
+      m_dfPrcr->writeSummaries();
+    }
+    if (m_cxt->isFileCoalesce()) {
+      m_dfPrcr->writeCoalescedFlows();
+    }
+    m_processCxt->writeProcessCounts();
     m_writer->reset(curTime);
-    clearTables();
     fileRotated = true;
+    m_shrinkPending = m_cxt->isShrinkTables();
+    if (m_samplingChanged) {
+      // records before and after a sampling ratio change never share a
+      // header, so consumers can reweight them per output segment; the
+      // change is recorded in the summaries of the new segment
+      SF_INFO(m_logger, "Sampling ratio " << m_cxt->getSamplingRatio()
+                                          << " in effect from output "
+                                          << m_writer->getHeaderFile())
+      m_writer->writeSummary(m_sampling->getChangeRecord());
+      m_samplingChanged = false;
+    }
   }
 
   if (m_statsTime > 0) {
@@ -134,6 +280,160 @@ bool SysFlowProcessor::checkAndRotateFile() {
   return fileRotated;
 }
 
+void SysFlowProcessor::checkAndWriteMetrics() {
+  if (!m_cxt->hasMetrics()) {
+    return;
+  }
+  time_t curTime = utils::getCurrentTime(m_cxt);
+  if (difftime(curTime, m_metricsTime) < m_cxt->getMetricsInterval()) {
+    return;
+  }
+  writeMetrics();
+  m_metricsTime = curTime;
+}
+
+void SysFlowProcessor::writeMetrics() {
+  sfmetrics::MetricsFile metrics(m_cxt->getMetricsFile());
+  const sfmetrics::Metrics &m = sfmetrics::g_metrics;
+
+  std::vector<sfmemory::TableStats> tables = getTableStats();
+  for (const auto &t : tables) {
+    metrics.gauge("sysflow_table_entries",
+                  "Number of entries in the collector tables", t.entries,
+                  std::string("table=\"") + sfmemory::getTableName(t.table) +
+                      "\"");
+  }
+  for (const auto &t : tables) {
+    metrics.gauge("sysflow_table_bytes",
+                  "Approximate bytes held by the collector tables", t.bytes,
+                  std::string("table=\"") + sfmemory::getTableName(t.table) +
+                      "\"");
+  }
+
+  for (int i = 0; i < sfmetrics::NumRecordTypes; i++) {
+    auto type = static_cast<sfmetrics::RecordType>(i);
+    metrics.counter("sysflow_records_written_total",
+                    "SysFlow records written by type", m.records[i],
+                    std::string("type=\"") +
+                        sfmetrics::getRecordTypeName(type) + "\"");
+  }
+  metrics.counter("sysflow_output_bytes_total",
+                  "Bytes written to the SysFlow output files and socket",
+                  m_writer->getBytesWritten());
+  metrics.counter("sysflow_writer_errors_total",
+                  "Failed socket connects and sends", m.writerErrors);
+  metrics.counter("sysflow_writer_reconnects_total",
+                  "Successful reconnects to the SysFlow socket",
+                  m.reconnects);
+
+  scap_stats stats{};
+  m_cxt->getInspector()->get_capture_stats(&stats);
+  metrics.gauge("sysflow_sampling_ratio",
+                "Current sampling ratio of the driver dropping mode",
+                m_cxt->getSamplingRatio());
+  metrics.counter("sysflow_sampling_changes_total",
+                  "Sampling ratio changes made by adaptive sampling",
+                  m.samplingChanges);
+  metrics.counter("sysflow_capture_events_total",
+                  "Events read from the capture source", stats.n_evts);
+  metrics.counter("sysflow_capture_drops_total",
+                  "Events dropped by the driver", stats.n_drops);
+  metrics.counter("sysflow_capture_preemptions_total",
+                  "Driver preemptions", stats.n_preemptions);
+
+  metrics.counter("sysflow_sweeps_total", "Incremental table sweeps",
+                  m.sweeps);
+  metrics.counter("sysflow_sweep_seconds_total",
+                  "Time spent in incremental table sweeps",
+                  m.sweepNs / 1e9);
+  metrics.counter("sysflow_swept_entities_total",
+                  "Entities removed by table sweeps", m.sweptEntities);
+  metrics.counter("sysflow_expiry_scans_total", "Flow expiry scans",
+                  m.expiryScans);
+  metrics.counter("sysflow_expiry_seconds_total",
+                  "Time spent in flow expiry scans", m.expiryNs / 1e9);
+  metrics.counter("sysflow_expired_records_total",
+                  "Flows exported or removed by expiry scans",
+                  m.expiredRecords);
+  metrics.counter("sysflow_summarized_flows_total",
+                  "Completed network flows folded into connection summaries",
+                  m.summarizedFlows);
+  metrics.counter("sysflow_summary_records_total",
+                  "Connection summary records written", m.summaryRecords);
+  metrics.counter("sysflow_summary_overflows_total",
+                  "Completed network flows written in full because a "
+                  "connection summary limit was reached",
+                  m.summaryOverflows);
+  metrics.counter("sysflow_coalesced_file_flows_total",
+                  "Completed file flows merged into coalesced flows",
+                  m.coalescedFlows);
+  metrics.counter("sysflow_coalesced_records_total",
+                  "Coalesced file flow records written", m.coalescedRecords);
+  metrics.counter("sysflow_coalesce_overflows_total",
+                  "Completed file flows written in full because the per "
+                  "process coalescing limit was reached",
+                  m.coalesceOverflows);
+  metrics.counter("sysflow_deduplicated_mmaps_total",
+                  "Mmaps of files already mapped in the current output file",
+                  m.dedupedMmaps);
+  metrics.counter("sysflow_fork_storm_events_total",
+                  "Clone, exec and exit events folded into fork storm "
+                  "summaries",
+                  m.forkStormEvents);
+  metrics.counter("sysflow_fork_summary_records_total",
+                  "Fork storm summary process events written",
+                  m.forkSummaryRecords);
+  metrics.counter("sysflow_rollup_records_total",
+                  "Container and pod rollup records written", m.rollupRecords);
+  metrics.counter("sysflow_fan_out_records_total",
+                  "Process fan-out estimate records written",
+                  m.fanOutRecords);
+  metrics.counter("sysflow_rate_limited_events_total",
+                  "Data events suppressed by the userspace rate limiter",
+                  m.rateLimitedEvents);
+  const sfsketch::HeavyHitters *hh = m_dfPrcr->getHeavyHitters();
+  if (hh != nullptr) {
+    for (int i = 0; i < sfsketch::NumSketches; i++) {
+      auto type = static_cast<sfsketch::SketchType>(i);
+      int rank = 1;
+      for (const sfsketch::HeavyHitter &h : hh->getLast(type)) {
+        std::string labels = "sketch=\"";
+        labels += sfsketch::getSketchName(type);
+        labels += "\",rank=\"" + std::to_string(rank++) + "\",key=\"";
+        sfmetrics::appendLabelValue(labels, h.key);
+        labels += "\"";
+        metrics.gauge("sysflow_heavy_hitter_events",
+                      "Estimated events of the heavy hitters of the last "
+                      "export interval",
+                      h.count, labels);
+      }
+    }
+  }
+
+#ifdef SF_LATENCY
+  for (int i = 0; i < sflatency::NumLatencyStages; i++) {
+    const sflatency::Histogram &h = sflatency::g_latency.hist[i];
+    std::vector<std::pair<double, double>> quantiles;
+    for (double q : {0.5, 0.9, 0.99, 0.999}) {
+      quantiles.emplace_back(q, h.percentile(q) / 1e9);
+    }
+    metrics.summary("sysflow_stage_latency_seconds",
+                    "Sampled latency of the event pipeline stages", quantiles,
+                    h.getSum() / 1e9, h.getCount(),
+                    std::string("stage=\"") +
+                        sflatency::getStageName(
+                            static_cast<sflatency::LatencyStage>(i)) +
+                        "\"");
+  }
+#endif
+
+  if (!metrics.commit()) {
+    SF_ERROR(m_logger, "Unable to write metrics file "
+                           << m_cxt->getMetricsFile()
+                           << ". Error Code: " << std::strerror(errno));
+  }
+}
+
 int SysFlowProcessor::checkForExpiredRecords() {
   int numExpired = m_dfPrcr->checkForExpiredRecords();
   if (numExpired) {
@@ -145,6 +445,10 @@ int SysFlowProcessor::checkForExpiredRecords() {
     SF_DEBUG(m_logger, "Data Flow Records exported: " << numProcExpired);
   }
 
+  if (m_cxt->isContainerRollup()) {
+    numExpired += m_containerCxt->checkRollups(utils::getCurrentTime(m_cxt));
+  }
+
   return numExpired + numProcExpired;
 }
 
@@ -157,7 +461,11 @@ int SysFlowProcessor::run() {
   m_cxt->getInspector()->start_capture();
 
   while (true) {
-    res = m_cxt->getInspector()->next(&ev);
+    {
+      SF_BENCH_STAGE(StageNext)
+      res = m_cxt->getInspector()->next(&ev);
+    }
+    SF_BENCH_STAGE(StageDispatch)
     if (res == SCAP_TIMEOUT) {
       if (m_exit) {
         break;
@@ -165,7 +473,10 @@ int SysFlowProcessor::run() {
 
       checkForExpiredRecords();
       m_processCxt->checkForDeletion();
+      checkSamplingRatio();
       checkAndRotateFile();
+      sweepTables();
+      checkAndWriteMetrics();
       continue;
     } else if (res == SCAP_FILTERED_EVENT) {
       continue;
@@ -179,6 +490,7 @@ int SysFlowProcessor::run() {
     }
 
     m_cxt->timeStamp = ev->get_ts();
+    SF_BENCH_COUNT(numEvents)
 
     if (m_exit) {
       break;
@@ -186,12 +498,19 @@ int SysFlowProcessor::run() {
 
     checkForExpiredRecords();
     m_processCxt->checkForDeletion();
+    checkSamplingRatio();
     checkAndRotateFile();
+    sweepTables();
+    checkAndWriteMetrics();
 
     if (m_cxt->isFilterContainers() && !utils::isInContainer(ev)) {
       continue;
     }
 
+    if (m_dropFilter != nullptr && m_dropFilter->dropEvent(ev)) {
+      continue;
+    }
+
     if (m_cxt->getInspector()->m_k8s_client != nullptr &&
         m_cxt->getInspector()->m_k8s_client->get_capture_events().size() > 0) {
       SF_INFO(m_logger,
@@ -200,6 +519,7 @@ int SysFlowProcessor::run() {
                                       .size());
     }
 
+    SF_LATENCY_STAGE(LatDispatch)
     switch (ev->get_type()) {
       SF_EXECVE_ENTER()
       SF_EXECVE_EXIT(ev)
@@ -233,7 +553,29 @@ int SysFlowProcessor::run() {
 
   SF_INFO(m_logger, "Exiting event capture loop. Shutting down.");
   m_cxt->getInspector()->stop_capture();
+  if (m_cxt->isConnSummary()) {
+    m_dfPrcr->writeSummaries();
+  }
+  if (m_cxt->isFileCoalesce()) {
+    m_dfPrcr->writeCoalescedFlows();
+  }
+  if (m_cxt->isForkStormSummary()) {
+    m_ctrlPrcr->writeForkSummaries();
+  }
+  if (m_cxt->isContainerRollup()) {
+    m_containerCxt->writeRollups();
+  }
+  if (m_cxt->isHeavyHitters()) {
+    m_dfPrcr->writeHeavyHitters();
+  }
+  if (m_cxt->isFanOut()) {
+    m_ctrlPrcr->writeFanOuts();
+  }
+  m_processCxt->writeProcessCounts();
   printStats();
+  if (m_cxt->hasMetrics()) {
+    writeMetrics();
+  }
 
   return 0;
 }
@@ -22,12 +22,18 @@
 #include "containercontext.h"
 #include "controlflowprocessor.h"
 #include "dataflowprocessor.h"
+#include "dropfilter.h"
 #include "filecontext.h"
 #include "k8scontext.h"
 #include "k8seventprocessor.h"
 #include "logger.h"
 #include "processcontext.h"
+#include "samplingcontroller.h"
+#include "sfbench.h"
 #include "sffilewriter.h"
+#include "sflatency.h"
+#include "sfmemory.h"
+#include "sfmetrics.h"
 #include "sfmultiwriter.h"
 #include "sfsockwriter.h"
 #include "syscall_defs.h"
@@ -35,6 +41,13 @@
 #include <ctime>
 #include <stdlib.h>
 #include <string>
+#include <vector>
+
+// entities written before the last rotation and no longer referenced are
+// garbage collected incrementally, at most SWEEP_BUDGET queue entries per
+// table every SWEEP_INTERVAL seconds.
+#define SWEEP_INTERVAL 1.0
+#define SWEEP_BUDGET 20000
 
 namespace sysflowprocessor {
 class SysFlowProcessor {
@@ -46,6 +59,7 @@ public:
   int run();
   sysflow::Container *getContainer(const std::string &containerId);
   sysflow::Process *getProcess(sysflow::OID &oid);
+  std::vector<sfmemory::TableStats> getTableStats();
 
 private:
   DEFINE_LOGGER();
@@ -59,8 +73,19 @@ private:
   dataflow::DataFlowProcessor *m_dfPrcr;
   sfk8s::K8sContext *m_k8sCxt;
   k8sevent::K8sEventProcessor *m_k8sPrcr;
+  dropfilter::DropFilter *m_dropFilter;
+  sampling::SamplingController *m_sampling;
+  bool m_samplingChanged;
+  bool m_shrinkPending;
   time_t m_statsTime;
-  void clearTables();
+  time_t m_sweepTime;
+  time_t m_metricsTime;
+  void sweepTables();
+  void shrinkTables();
+  void checkSamplingRatio();
+  void checkAndWriteMetrics();
+  void writeMetrics();
+  void printLatencyStats();
   int checkForExpiredRecords();
   bool checkAndRotateFile();
   void printStats();
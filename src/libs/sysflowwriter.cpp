@@ -26,14 +26,82 @@ SysFlowWriter::SysFlowWriter(context::SysFlowContext *cxt, time_t start)
   m_cxt = cxt;
   m_start = start;
   m_version = utils::getSchemaVersion();
+  m_counts.set_empty_key(*utils::getOIDEmptyKey());
+  m_counts.set_deleted_key(*utils::getOIDDelKey());
+}
+
+void SysFlowWriter::reset(time_t curTime) {
+  doReset(curTime);
+  m_generation++;
+  // summaries rotate with the output
+  m_summary.close();
+  m_summaryFailed = false;
+  m_summarySuffix = "." + std::to_string(curTime);
+}
+
+// summaries go to the configured summary file (suffixed with the reset time
+// after the first reset), or else next to the SysFlow output file. Socket
+// and callback outputs need a summary file for the summarized features,
+// which is checked in SysFlowContext::validate.
+std::string SysFlowWriter::getSummaryPath() {
+  std::string summaryFile = m_cxt->getSummaryFile();
+  if (!summaryFile.empty()) {
+    return summaryFile + m_summarySuffix;
+  }
+  if (m_cxt->isOutputFile() && !m_hdrFile.empty()) {
+    return m_hdrFile + ".summary";
+  }
+  return "";
+}
+
+std::vector<OID> SysFlowWriter::getCountedProcesses() {
+  std::vector<OID> oids;
+  oids.reserve(m_counts.size());
+  for (const auto &it : m_counts) {
+    oids.push_back(it.first);
+  }
+  return oids;
+}
+
+void SysFlowWriter::writeCounts(const OID &oid) {
+  auto it = m_counts.find(oid);
+  if (it == m_counts.end()) {
+    return;
+  }
+  sfsummary::Record rec("ProcessCounts", utils::getSinspTime(m_cxt));
+  rec.addOID("procOID", oid);
+  rec.addCounts(it->second);
+  m_counts.erase(oid);
+  writeSummary(rec);
+}
+
+void SysFlowWriter::writeSummary(const sfsummary::Record &rec) {
+  if (!m_summary.isOpen()) {
+    if (m_summaryFailed) {
+      return;
+    }
+    std::string path = getSummaryPath();
+    if (path.empty() || !m_summary.open(path)) {
+      m_summaryFailed = true;
+      if (!path.empty()) {
+        sfmetrics::g_metrics.writerErrors++;
+      }
+      return;
+    }
+  }
+  SF_LATENCY_STAGE(LatWrite)
+  m_summary.write(rec);
+  sfmetrics::countRecord(sfmetrics::RecSummary);
 }
 
 void SysFlowWriter::writeHeader() {
+  SF_LATENCY_STAGE(LatWrite)
   m_header.version = m_version;
   m_header.exporter = m_cxt->getExporterID();
   m_header.ip = m_cxt->getNodeIP();
   m_header.filename = m_hdrFile;
   m_flow.rec.set_SFHeader(m_header);
   m_numRecs++;
+  sfmetrics::countRecord(sfmetrics::RecHeader);
   write(&m_flow);
 }
@@ -19,7 +19,11 @@
 
 #ifndef __SF_WRITER_
 #define __SF_WRITER_
+#include "datatypes.h"
 #include "op_flags.h"
+#include "sflatency.h"
+#include "sfmetrics.h"
+#include "sfsummary.h"
 #include "sysflow.h"
 #include "sysflowcontext.h"
 #include "utils.h"
@@ -46,7 +50,33 @@ protected:
   time_t m_start;
   int64_t m_version;
   std::string m_hdrFile;
+  // output generation, bumped on every reset. Entities stamped with the
+  // current generation have already been written to the current output.
+  uint64_t m_generation{1};
+  // summary record output, opened on the first record after each reset
+  sfsummary::SummaryWriter m_summary;
+  std::string m_summarySuffix;
+  bool m_summaryFailed{false};
+  std::string getSummaryPath();
+  // per process counts held for the next flow of the process
+  sftable::HashMap<OID, sfsummary::ProcessCounts, XXHasher<OID>, eqoid>
+      m_counts;
+  template <typename F> inline void attachCounts(const F &flow) {
+    if (m_counts.empty()) {
+      return;
+    }
+    auto it = m_counts.find(flow.procOID);
+    if (it != m_counts.end()) {
+      sfsummary::Record rec("ProcessCounts", utils::getSinspTime(m_cxt));
+      rec.addFlow(flow);
+      rec.addCounts(it->second);
+      m_counts.erase(flow.procOID);
+      writeSummary(rec);
+    }
+  }
   virtual void write(SysFlow *flow) = 0;
+  // starts a new output (rotated file, new socket stream header, ...)
+  virtual void doReset(time_t curTime) = 0;
   virtual void write(SysFlow *flow, Process *proc, File *file1 = nullptr,
                      File *file2 = nullptr) = 0;
 
@@ -54,73 +84,116 @@ public:
   SysFlowWriter(context::SysFlowContext *cxt, time_t start);
   virtual ~SysFlowWriter() {}
   inline int getNumRecs() { return m_numRecs; }
+  inline uint64_t getGeneration() { return m_generation; }
+  // bytes written to the output so far, for metrics
+  virtual uint64_t getBytesWritten() { return 0; }
   inline void writePod(Pod *pod) {
+    SF_LATENCY_STAGE(LatWrite)
     m_flow.rec.set_Pod(*pod);
     m_numRecs++;
+    sfmetrics::countRecord(sfmetrics::RecPod);
     write(&m_flow);
   }
   inline void setHeaderFile(std::string filename) { m_hdrFile = filename; }
   inline std::string getHeaderFile() { return m_hdrFile; }
   inline void writeContainer(Container *container) {
+    SF_LATENCY_STAGE(LatWrite)
     m_flow.rec.set_Container(*container);
     m_numRecs++;
+    sfmetrics::countRecord(sfmetrics::RecContainer);
     write(&m_flow);
   }
   inline void writeProcess(Process *proc) {
+    SF_LATENCY_STAGE(LatWrite)
     m_flow.rec.set_Process(*proc);
     m_numRecs++;
+    sfmetrics::countRecord(sfmetrics::RecProcess);
     write(&m_flow);
   }
   inline void writeProcessEvent(ProcessEvent *pe, Process *proc) {
+    SF_LATENCY_STAGE(LatWrite)
     m_flow.rec.set_ProcessEvent(*pe);
     m_numRecs++;
+    sfmetrics::countRecord(sfmetrics::RecProcessEvent);
     write(&m_flow, proc);
   }
   inline void writeNetFlow(NetworkFlow *nf, Process *proc) {
     if (nf->opFlags == 0 || nf->opFlags == OP_TRUNCATE) {
       return;
     }
+    SF_LATENCY_STAGE(LatWrite)
     m_flow.rec.set_NetworkFlow(*nf);
     m_numRecs++;
+    sfmetrics::countRecord(sfmetrics::RecNetworkFlow);
     write(&m_flow, proc);
+    attachCounts(*nf);
   }
   inline void writeProcessFlow(ProcessFlow *pf, Process *proc) {
     if (pf->opFlags == 0 || pf->opFlags == OP_TRUNCATE) {
       return;
     }
+    SF_LATENCY_STAGE(LatWrite)
     m_flow.rec.set_ProcessFlow(*pf);
     m_numRecs++;
+    sfmetrics::countRecord(sfmetrics::RecProcessFlow);
     write(&m_flow, proc);
+    attachCounts(*pf);
   }
   inline void writeFileFlow(FileFlow *ff, Process *proc, File *file) {
     if (ff->opFlags == 0 || ff->opFlags == OP_TRUNCATE) {
       return;
     }
+    SF_LATENCY_STAGE(LatWrite)
     m_flow.rec.set_FileFlow(*ff);
     m_numRecs++;
+    sfmetrics::countRecord(sfmetrics::RecFileFlow);
     write(&m_flow, proc, file);
+    attachCounts(*ff);
   }
   inline void writeFileEvent(FileEvent *fe, Process *proc, File *file) {
+    SF_LATENCY_STAGE(LatWrite)
     m_flow.rec.set_FileEvent(*fe);
     m_numRecs++;
+    sfmetrics::countRecord(sfmetrics::RecFileEvent);
     write(&m_flow, proc, file);
   }
   inline void writeFileEvent(FileEvent *fe, Process *proc, File *file1,
                              File *file2) {
+    SF_LATENCY_STAGE(LatWrite)
     m_flow.rec.set_FileEvent(*fe);
     m_numRecs++;
+    sfmetrics::countRecord(sfmetrics::RecFileEvent);
     write(&m_flow, proc, file1, file2);
   }
   inline void writeFile(sysflow::File *f) {
+    SF_LATENCY_STAGE(LatWrite)
     m_flow.rec.set_File(*f);
     m_numRecs++;
+    sfmetrics::countRecord(sfmetrics::RecFile);
     write(&m_flow);
   }
   inline void writeK8sEvent(sysflow::K8sEvent *k) {
+    SF_LATENCY_STAGE(LatWrite)
     m_flow.rec.set_K8sEvent(*k);
     m_numRecs++;
+    sfmetrics::countRecord(sfmetrics::RecK8sEvent);
     write(&m_flow);
   }
+  // writes a summary record to the summary file of the current output;
+  // SysFlowContext::validate rejects the summarized features when there is
+  // none (see getSummaryPath)
+  void writeSummary(const sfsummary::Record &rec);
+  inline void addCount(const OID &oid, sfsummary::ProcessCount count) {
+    m_counts[oid].counts[count]++;
+  }
+  inline bool hasCounts(const OID &oid) {
+    return !m_counts.empty() && m_counts.find(oid) != m_counts.end();
+  }
+  // processes with held counts
+  std::vector<OID> getCountedProcesses();
+  // writes the counts held for a process that has no flow to attach them
+  // to, naming the process instead
+  void writeCounts(const OID &oid);
   inline bool isExpired(time_t curTime) {
     if (m_start > 0) {
       double duration = getDuration(curTime);
@@ -132,7 +205,9 @@ public:
     return difftime(curTime, m_start);
   }
   virtual int initialize() = 0;
-  virtual void reset(time_t curTime) = 0;
+  // starts a new output and bumps the output generation, so that entities
+  // are written again before the records that reference them.
+  void reset(time_t curTime);
   virtual bool needsReset() = 0;
 };
 } // namespace writer
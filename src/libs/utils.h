@@ -25,6 +25,7 @@
 #include "sysflow.h"
 #include "sysflowcontext.h"
 #include <arpa/inet.h>
+#include <cstdio>
 #include <ctime>
 #include <fstream>
 #include <json/json.h>
@@ -103,6 +104,44 @@ inline void strToIP(const char *str, std::vector<int64_t> &ip) {
   }
 }
 
+// remote end of an IPv4 socket: tuples are stored client first, so it is the
+// source of server (accepted) sockets and the destination of client sockets
+inline void getRemoteEndpoint(sinsp_fdinfo_t *fdinfo, uint32_t &ip,
+                              uint16_t &port) {
+  const auto &fields = fdinfo->m_sockinfo.m_ipv4info.m_fields;
+  bool server = fdinfo->is_role_server();
+  ip = server ? fields.m_sip : fields.m_dip;
+  port = server ? fields.m_sport : fields.m_dport;
+}
+
+// remote end of an IPv6 socket, as above
+inline void getRemoteEndpoint(sinsp_fdinfo_t *fdinfo, ipv6addr &ip,
+                              uint16_t &port) {
+  const auto &fields = fdinfo->m_sockinfo.m_ipv6info.m_fields;
+  bool server = fdinfo->is_role_server();
+  ip = server ? fields.m_sip : fields.m_dip;
+  port = server ? fields.m_sport : fields.m_dport;
+}
+
+// appends a string to a JSON string value, escaping quotes, backslashes and
+// control characters
+inline void appendEscaped(std::string &out, const std::string &s) {
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    } else if (c == '\n') {
+      out += "\\n";
+      continue;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+      continue;
+    }
+    out += c;
+  }
+}
+
 #define CHAR_MAP_STR "0123456789abcdef"
 
 inline char *itoa(int val, int base) {
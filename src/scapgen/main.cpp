@@ -0,0 +1,123 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#include "scapwriter.h"
+#include "workloads.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#define DEFAULT_START_TS 1700000000000000000ULL
+#define DEFAULT_INTERVAL_NS 1000
+#define DEFAULT_FIRST_PID 100000
+
+static void usage(const std::string &name) {
+  std::cerr
+      << "Usage: " << name
+      << " [options] -t <template.scap> -w <out.scap> "
+         "<workload>[:key=value,...] ...\n"
+      << "Options:\n"
+      << "\t-h\t\t\tShow this help message and exit\n"
+      << "\t-t template scap file\tUncompressed scap file whose metadata "
+         "(machine info, process, fd, interface and user lists) is copied "
+         "to the output\n"
+      << "\t-w scap file\t\tThe scap file to which synthetic events are "
+         "written\n"
+      << "\t-s seed\t\t\tSeed for the pseudo-random choices of the workloads "
+         "(default: 1)\n"
+      << "\t-b start time\t\tTimestamp of the first event, in ns since epoch "
+         "(default: "
+      << DEFAULT_START_TS << ")\n"
+      << "\t-i interval\t\tTime between consecutive events, in ns (default: "
+      << DEFAULT_INTERVAL_NS << ")\n"
+      << "\t-p pid\t\t\tFirst pid assigned to synthetic processes (default: "
+      << DEFAULT_FIRST_PID << ")\n"
+      << "Workloads (run in the given order):\n"
+      << "\tforkstorm:procs=10000,exit=1\n"
+      << "\t\t\t\tShort-lived processes forked from the same shell\n"
+      << "\tserver:conns=100000,open=10000,port=8080,bytes=512\n"
+      << "\t\t\t\tServer accepting connections from distinct clients\n"
+      << "\tfilescan:procs=1,files=100000,open=10000\n"
+      << "\t\t\t\tScanners reading many files with many open fds\n"
+      << "\tjvm:threads=200,jars=100,maps=100000\n"
+      << "\t\t\t\tJVM threads repeatedly mapping the same jar files\n"
+      << "\tcontainers:count=100,procs=5,files=10,conns=1\n"
+      << "\t\t\t\tShort-lived containers running a few processes\n"
+      << std::endl;
+}
+
+int main(int argc, char **argv) {
+  std::string templateFile;
+  std::string outputFile;
+  uint64_t seed = 1;
+  uint64_t startTs = DEFAULT_START_TS;
+  uint64_t interval = DEFAULT_INTERVAL_NS;
+  int64_t firstPid = DEFAULT_FIRST_PID;
+  int c;
+
+  while ((c = getopt(argc, argv, "ht:w:s:b:i:p:")) != -1) {
+    switch (c) {
+    case 't':
+      templateFile = optarg;
+      break;
+    case 'w':
+      outputFile = optarg;
+      break;
+    case 's':
+      seed = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'b':
+      startTs = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'i':
+      interval = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'p':
+      firstPid = std::strtoll(optarg, nullptr, 10);
+      break;
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (templateFile.empty() || outputFile.empty() || optind == argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  try {
+    scapgen::ScapWriter writer(outputFile, templateFile, startTs, interval);
+    scapgen::Workloads workloads(&writer, seed, firstPid);
+    for (int i = optind; i < argc; i++) {
+      workloads.run(argv[i]);
+    }
+    writer.close();
+    std::cout << "Wrote " << writer.getNumEvents() << " events to "
+              << outputFile << std::endl;
+  } catch (const std::exception &ex) {
+    std::cerr << ex.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
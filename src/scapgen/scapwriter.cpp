@@ -0,0 +1,224 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#include "scapwriter.h"
+#include <cstring>
+#include <stdexcept>
+
+using scapgen::Param;
+using scapgen::ScapWriter;
+
+// size of the packed event header: ts, tid, len, type, nparams
+#define SCAP_EVT_HEADER_LEN 26
+// size of a block header (type, total length) and of its trailer
+#define SCAP_BLOCK_HEADER_LEN 8
+#define SCAP_BLOCK_TRAILER_LEN 4
+
+namespace {
+template <typename T> void append(std::vector<char> &buf, T value) {
+  const char *p = reinterpret_cast<const char *>(&value);
+  buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+bool isEventBlock(uint32_t type) {
+  return type == SCAP_EV_BLOCK_TYPE || type == SCAP_EV_BLOCK_TYPE_INT ||
+         type == SCAP_EVF_BLOCK_TYPE || type == SCAP_EV_BLOCK_TYPE_V2 ||
+         type == SCAP_EVF_BLOCK_TYPE_V2 ||
+         type == SCAP_EV_BLOCK_TYPE_V2_LARGE ||
+         type == SCAP_EVF_BLOCK_TYPE_V2_LARGE;
+}
+} // namespace
+
+ScapWriter::ScapWriter(const std::string &path,
+                       const std::string &templatePath, uint64_t startTs,
+                       uint64_t interval)
+    : m_events(scap_get_event_info_table()), m_ts(startTs),
+      m_interval(interval), m_numEvents(0) {
+  m_out.open(path, std::ios::binary | std::ios::trunc);
+  if (!m_out.is_open()) {
+    throw std::runtime_error("Unable to open output file '" + path + "'");
+  }
+  copyMetadata(templatePath);
+}
+
+ScapWriter::~ScapWriter() { close(); }
+
+void ScapWriter::copyMetadata(const std::string &templatePath) {
+  std::ifstream in(templatePath, std::ios::binary);
+  if (!in.is_open()) {
+    throw std::runtime_error("Unable to open template file '" + templatePath +
+                             "'");
+  }
+  uint32_t header[2];
+  int numBlocks = 0;
+  while (in.read(reinterpret_cast<char *>(header), sizeof(header))) {
+    if (numBlocks == 0 && header[0] != SCAP_SHB_BLOCK_TYPE) {
+      throw std::runtime_error("Template file '" + templatePath +
+                               "' is not an uncompressed scap file");
+    }
+    if (isEventBlock(header[0])) {
+      break;
+    }
+    if (header[1] < SCAP_BLOCK_HEADER_LEN + SCAP_BLOCK_TRAILER_LEN) {
+      throw std::runtime_error("Corrupted block in template file '" +
+                               templatePath + "'");
+    }
+    m_block.resize(header[1] - SCAP_BLOCK_HEADER_LEN);
+    if (!in.read(m_block.data(), m_block.size())) {
+      throw std::runtime_error("Truncated block in template file '" +
+                               templatePath + "'");
+    }
+    m_out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    m_out.write(m_block.data(), m_block.size());
+    numBlocks++;
+  }
+  if (numBlocks == 0) {
+    throw std::runtime_error("Template file '" + templatePath +
+                             "' has no metadata blocks");
+  }
+}
+
+void ScapWriter::encodeParam(const struct ppm_param_info &info,
+                             const Param *param) {
+  int64_t n = (param != nullptr) ? param->num : 0;
+  std::size_t start = m_vals.size();
+  switch (info.type) {
+  case PT_INT8:
+  case PT_UINT8:
+  case PT_FLAGS8:
+  case PT_ENUMFLAGS8:
+  case PT_SIGTYPE:
+  case PT_L4PROTO:
+  case PT_SOCKFAMILY:
+    append(m_vals, static_cast<uint8_t>(n));
+    break;
+  case PT_INT16:
+  case PT_UINT16:
+  case PT_FLAGS16:
+  case PT_ENUMFLAGS16:
+  case PT_PORT:
+  case PT_SYSCALLID:
+    append(m_vals, static_cast<uint16_t>(n));
+    break;
+  case PT_INT32:
+  case PT_UINT32:
+  case PT_FLAGS32:
+  case PT_ENUMFLAGS32:
+  case PT_MODE:
+  case PT_UID:
+  case PT_GID:
+  case PT_BOOL:
+  case PT_SIGSET:
+  case PT_IPV4ADDR:
+    append(m_vals, static_cast<uint32_t>(n));
+    break;
+  case PT_INT64:
+  case PT_UINT64:
+  case PT_ERRNO:
+  case PT_FD:
+  case PT_PID:
+  case PT_RELTIME:
+  case PT_ABSTIME:
+  case PT_DOUBLE:
+    append(m_vals, static_cast<uint64_t>(n));
+    break;
+  case PT_CHARBUF:
+  case PT_FSPATH:
+  case PT_FSRELPATH:
+    if (param != nullptr) {
+      m_vals.insert(m_vals.end(), param->buf.begin(), param->buf.end());
+    }
+    m_vals.push_back('\0');
+    break;
+  default:
+    if (param != nullptr) {
+      m_vals.insert(m_vals.end(), param->buf.begin(), param->buf.end());
+    }
+    break;
+  }
+  m_lens.push_back(m_vals.size() - start);
+}
+
+void ScapWriter::write(ppm_event_code type, int64_t tid,
+                       std::initializer_list<Param> params) {
+  const struct ppm_event_info &info = m_events[type];
+  for (const Param &p : params) {
+    uint32_t i = 0;
+    while (i < info.nparams && strcmp(info.params[i].name, p.name) != 0) {
+      i++;
+    }
+    if (i == info.nparams) {
+      throw std::runtime_error(std::string("Event ") + info.name +
+                               " has no parameter '" + p.name + "'");
+    }
+  }
+
+  m_vals.clear();
+  m_lens.clear();
+  for (uint32_t i = 0; i < info.nparams; i++) {
+    const Param *param = nullptr;
+    for (const Param &p : params) {
+      if (strcmp(info.params[i].name, p.name) == 0) {
+        param = &p;
+        break;
+      }
+    }
+    encodeParam(info.params[i], param);
+  }
+
+  bool large = (info.flags & EF_LARGE_PAYLOAD) != 0;
+  uint32_t lenSize = large ? sizeof(uint32_t) : sizeof(uint16_t);
+  uint32_t evtLen =
+      SCAP_EVT_HEADER_LEN + info.nparams * lenSize + m_vals.size();
+  // the block holds the cpu id followed by the event, padded to 4 bytes
+  uint32_t bodyLen = sizeof(uint16_t) + evtLen;
+  uint32_t padLen = (4 - bodyLen % 4) % 4;
+  uint32_t blockLen =
+      SCAP_BLOCK_HEADER_LEN + bodyLen + padLen + SCAP_BLOCK_TRAILER_LEN;
+
+  m_block.clear();
+  append(m_block, static_cast<uint32_t>(SCAP_EV_BLOCK_TYPE_V2));
+  append(m_block, blockLen);
+  append(m_block, static_cast<uint16_t>(0));
+  append(m_block, m_ts);
+  append(m_block, static_cast<uint64_t>(tid));
+  append(m_block, evtLen);
+  append(m_block, static_cast<uint16_t>(type));
+  append(m_block, info.nparams);
+  for (uint32_t len : m_lens) {
+    if (large) {
+      append(m_block, len);
+    } else {
+      append(m_block, static_cast<uint16_t>(len));
+    }
+  }
+  m_block.insert(m_block.end(), m_vals.begin(), m_vals.end());
+  m_block.insert(m_block.end(), padLen, '\0');
+  append(m_block, blockLen);
+  m_out.write(m_block.data(), m_block.size());
+
+  m_ts += m_interval;
+  m_numEvents++;
+}
+
+void ScapWriter::close() {
+  if (m_out.is_open()) {
+    m_out.close();
+  }
+}
@@ -0,0 +1,85 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#ifndef _SF_SCAP_WRITER_
+#define _SF_SCAP_WRITER_
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
+#include <scap.h>
+#include <string>
+#include <vector>
+
+// scap savefile block types (see libscap's savefile engine)
+#define SCAP_SHB_BLOCK_TYPE 0x0A0D0D0A
+#define SCAP_EV_BLOCK_TYPE 0x205
+#define SCAP_EV_BLOCK_TYPE_INT 0x8205
+#define SCAP_EVF_BLOCK_TYPE 0x208
+#define SCAP_EV_BLOCK_TYPE_V2 0x216
+#define SCAP_EVF_BLOCK_TYPE_V2 0x217
+#define SCAP_EV_BLOCK_TYPE_V2_LARGE 0x221
+#define SCAP_EVF_BLOCK_TYPE_V2_LARGE 0x222
+
+namespace scapgen {
+
+// A named event parameter. Numeric parameters use num, while string, buffer
+// and socket parameters use buf (character buffers are NUL terminated by the
+// writer).
+struct Param {
+  const char *name;
+  int64_t num;
+  std::string buf;
+};
+
+inline Param num(const char *name, int64_t value) { return {name, value, ""}; }
+inline Param str(const char *name, std::string value) {
+  return {name, 0, std::move(value)};
+}
+
+// Writes scap savefiles. The metadata blocks (machine info, process, fd,
+// interface and user lists) are copied from a template capture, and events
+// are encoded from the libscap event table so that every parameter the
+// event declares is present with the right size. Parameters not given by
+// the caller are encoded as zero or empty.
+class ScapWriter {
+private:
+  std::ofstream m_out;
+  const struct ppm_event_info *m_events;
+  uint64_t m_ts;
+  uint64_t m_interval;
+  uint64_t m_numEvents;
+  std::vector<char> m_block;
+  std::vector<char> m_vals;
+  std::vector<uint32_t> m_lens;
+  void copyMetadata(const std::string &templatePath);
+  void encodeParam(const struct ppm_param_info &info, const Param *param);
+
+public:
+  ScapWriter(const std::string &path, const std::string &templatePath,
+             uint64_t startTs, uint64_t interval);
+  virtual ~ScapWriter();
+  void write(ppm_event_code type, int64_t tid,
+             std::initializer_list<Param> params);
+  inline uint64_t getNumEvents() { return m_numEvents; }
+  inline uint64_t getTime() { return m_ts; }
+  void close();
+};
+} // namespace scapgen
+
+#endif
@@ -0,0 +1,346 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#include "workloads.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+using scapgen::Workloads;
+
+#define SHELL_EXE "/bin/bash"
+#define INIT_PID 1
+#define FIRST_FD 3
+#define MAX_PORTS 60000
+
+namespace {
+std::string commName(const std::string &path) {
+  std::size_t pos = path.rfind('/');
+  return (pos == std::string::npos) ? path : path.substr(pos + 1);
+}
+
+std::string cgroups(const std::string &containerId) {
+  std::string cg = containerId.empty() ? "cpuset=/" : "cpuset=/docker/";
+  cg += containerId;
+  cg.push_back('\0');
+  return cg;
+}
+
+// scap ipv4 socket tuple: family, source ip and port, destination ip and port
+std::string sockTuple(uint32_t sip, uint16_t sport, uint32_t dip,
+                      uint16_t dport) {
+  std::string t(1, static_cast<char>(PPM_AF_INET));
+  uint32_t nsip = htonl(sip);
+  uint32_t ndip = htonl(dip);
+  t.append(reinterpret_cast<const char *>(&nsip), sizeof(nsip));
+  t.append(reinterpret_cast<const char *>(&sport), sizeof(sport));
+  t.append(reinterpret_cast<const char *>(&ndip), sizeof(ndip));
+  t.append(reinterpret_cast<const char *>(&dport), sizeof(dport));
+  return t;
+}
+
+// scap ipv4 socket address: family, ip and port
+std::string sockAddr(uint32_t ip, uint16_t port) {
+  std::string a(1, static_cast<char>(PPM_AF_INET));
+  uint32_t nip = htonl(ip);
+  a.append(reinterpret_cast<const char *>(&nip), sizeof(nip));
+  a.append(reinterpret_cast<const char *>(&port), sizeof(port));
+  return a;
+}
+
+uint32_t ipv4(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+  return (static_cast<uint32_t>(a) << 24) | (b << 16) | (c << 8) | d;
+}
+} // namespace
+
+Workloads::Workloads(ScapWriter *writer, uint64_t seed, int64_t firstPid)
+    : m_writer(writer), m_rng(seed), m_nextPid(firstPid), m_shellPid(0) {}
+
+Workloads::~Workloads() = default;
+
+std::string Workloads::newContainer() {
+  static const char hex[] = "0123456789abcdef";
+  std::string id(64, '0');
+  for (char &c : id) {
+    c = hex[m_rng() % 16];
+  }
+  std::string shortId = id.substr(0, 12);
+  std::ostringstream json;
+  json << "{\"container\":{\"id\":\"" << shortId
+       << "\",\"type\":0,\"name\":\"scapgen_" << shortId
+       << "\",\"image\":\"scapgen/workload:latest\",\"imageid\":\"" << id
+       << "\",\"imagerepo\":\"scapgen/workload\",\"imagetag\":\"latest\""
+       << ",\"imagedigest\":\"\",\"privileged\":false,\"Mounts\":[]"
+       << ",\"lookup_state\":1}}";
+  m_writer->write(PPME_CONTAINER_JSON_E, -1, {str("json", json.str())});
+  return id;
+}
+
+void Workloads::clone(int64_t tid, int64_t pid, int64_t ptid, int64_t res,
+                      const std::string &exe, const std::string &containerId,
+                      uint32_t flags) {
+  m_writer->write(PPME_SYSCALL_CLONE_20_X, tid,
+                  {num("res", res), str("exe", exe), str("args", ""),
+                   num("tid", tid), num("pid", pid), num("ptid", ptid),
+                   str("cwd", "/"), num("fdlimit", 1024),
+                   str("comm", commName(exe)),
+                   str("cgroups", cgroups(containerId)), num("flags", flags),
+                   num("vtid", tid), num("vpid", pid)});
+}
+
+int64_t Workloads::spawn(const std::string &exe, const std::string &args,
+                         const std::string &containerId) {
+  if (m_shellPid == 0) {
+    m_shellPid = allocPid();
+    m_writer->write(PPME_SYSCALL_CLONE_20_E, INIT_PID, {});
+    clone(m_shellPid, m_shellPid, INIT_PID, 0, SHELL_EXE, "", 0);
+  }
+  int64_t pid = allocPid();
+  m_writer->write(PPME_SYSCALL_CLONE_20_E, m_shellPid, {});
+  clone(m_shellPid, m_shellPid, INIT_PID, pid, SHELL_EXE, "", 0);
+  clone(pid, pid, m_shellPid, 0, SHELL_EXE, containerId, 0);
+  m_writer->write(PPME_SYSCALL_EXECVE_19_E, pid, {str("filename", exe)});
+  // arguments are NUL terminated, as the driver sends them
+  m_writer->write(PPME_SYSCALL_EXECVE_19_X, pid,
+                  {num("res", 0), str("exe", exe), str("args", args + '\0'),
+                   num("tid", pid), num("pid", pid), num("ptid", m_shellPid),
+                   str("cwd", "/"), num("fdlimit", 1024),
+                   str("comm", commName(exe)),
+                   str("cgroups", cgroups(containerId))});
+  return pid;
+}
+
+int64_t Workloads::spawnThread(int64_t pid, const std::string &exe,
+                               const std::string &containerId) {
+  uint32_t flags = PPM_CL_CLONE_THREAD | PPM_CL_CLONE_FILES | PPM_CL_CLONE_VM;
+  int64_t tid = allocPid();
+  m_writer->write(PPME_SYSCALL_CLONE_20_E, pid, {});
+  clone(pid, pid, m_shellPid, tid, exe, containerId, flags);
+  clone(tid, pid, m_shellPid, 0, exe, containerId, flags);
+  return tid;
+}
+
+void Workloads::exit(int64_t tid) {
+  m_writer->write(PPME_PROCEXIT_1_E, tid, {num("status", 0), num("ret", 0)});
+}
+
+void Workloads::openFile(int64_t tid, int64_t fd, const std::string &path) {
+  m_writer->write(PPME_SYSCALL_OPEN_E, tid,
+                  {str("name", path), num("flags", PPM_O_RDONLY)});
+  m_writer->write(PPME_SYSCALL_OPEN_X, tid,
+                  {num("fd", fd), str("name", path),
+                   num("flags", PPM_O_RDONLY), num("ino", fd)});
+}
+
+void Workloads::readFd(int64_t tid, int64_t fd, uint64_t size) {
+  m_writer->write(PPME_SYSCALL_READ_E, tid, {num("fd", fd), num("size", size)});
+  m_writer->write(PPME_SYSCALL_READ_X, tid, {num("res", size)});
+}
+
+void Workloads::closeFd(int64_t tid, int64_t fd) {
+  m_writer->write(PPME_SYSCALL_CLOSE_E, tid, {num("fd", fd)});
+  m_writer->write(PPME_SYSCALL_CLOSE_X, tid, {num("res", 0)});
+}
+
+void Workloads::accept(int64_t tid, int64_t fd, uint32_t cip, uint16_t cport,
+                       uint32_t sip, uint16_t sport) {
+  m_writer->write(PPME_SOCKET_ACCEPT4_5_E, tid, {num("flags", 0)});
+  m_writer->write(PPME_SOCKET_ACCEPT4_5_X, tid,
+                  {num("fd", fd),
+                   str("tuple", sockTuple(cip, cport, sip, sport)),
+                   num("queuemax", 4096)});
+}
+
+void Workloads::connect(int64_t tid, int64_t fd, uint32_t sip, uint16_t sport,
+                        uint32_t dip, uint16_t dport) {
+  m_writer->write(PPME_SOCKET_SOCKET_E, tid,
+                  {num("domain", PPM_AF_INET), num("type", SOCK_STREAM)});
+  m_writer->write(PPME_SOCKET_SOCKET_X, tid, {num("fd", fd)});
+  m_writer->write(PPME_SOCKET_CONNECT_E, tid,
+                  {num("fd", fd), str("addr", sockAddr(dip, dport))});
+  m_writer->write(PPME_SOCKET_CONNECT_X, tid,
+                  {num("res", 0),
+                   str("tuple", sockTuple(sip, sport, dip, dport)),
+                   num("fd", fd)});
+}
+
+void Workloads::sendRecv(int64_t tid, int64_t fd, uint64_t size) {
+  m_writer->write(PPME_SOCKET_RECVFROM_E, tid,
+                  {num("fd", fd), num("size", size)});
+  m_writer->write(PPME_SOCKET_RECVFROM_X, tid, {num("res", size)});
+  m_writer->write(PPME_SOCKET_SENDTO_E, tid,
+                  {num("fd", fd), num("size", size)});
+  m_writer->write(PPME_SOCKET_SENDTO_X, tid, {num("res", size)});
+}
+
+void Workloads::mmap(int64_t tid, int64_t fd, uint64_t length) {
+  m_writer->write(PPME_SYSCALL_MMAP_E, tid,
+                  {num("length", length), num("prot", PPM_PROT_READ),
+                   num("flags", PPM_MAP_SHARED), num("fd", fd)});
+  m_writer->write(PPME_SYSCALL_MMAP_X, tid, {num("res", 0x7f0000000000)});
+}
+
+// many short-lived processes forked from the same shell
+void Workloads::forkStorm(WorkloadOptions &opts) {
+  for (uint64_t i = 0; i < opts["procs"]; i++) {
+    int64_t pid = spawn("/bin/true", std::to_string(i), "");
+    if (opts["exit"] != 0) {
+      exit(pid);
+    }
+  }
+}
+
+// a server accepting connections from distinct clients, keeping up to open
+// connections alive at a time
+void Workloads::server(WorkloadOptions &opts) {
+  uint64_t open = std::max<uint64_t>(opts["open"], 1);
+  uint32_t sip = ipv4(10, 255, 0, 1);
+  uint16_t sport = opts["port"];
+  int64_t pid = spawn("/usr/sbin/nginx", "-g daemon off;", "");
+  for (uint64_t i = 0; i < opts["conns"]; i++) {
+    int64_t fd = FIRST_FD + i % open;
+    if (i >= open) {
+      closeFd(pid, fd);
+    }
+    uint32_t cip = ipv4(10, 0, 0, 0) + 1 + i / MAX_PORTS;
+    accept(pid, fd, cip, 1024 + i % MAX_PORTS, sip, sport);
+    sendRecv(pid, fd, opts["bytes"]);
+  }
+  for (uint64_t i = 0; i < std::min(open, opts["conns"]); i++) {
+    closeFd(pid, FIRST_FD + i);
+  }
+  exit(pid);
+}
+
+// scanners reading many files, keeping up to open files open at a time
+void Workloads::fileScan(WorkloadOptions &opts) {
+  uint64_t open = std::max<uint64_t>(opts["open"], 1);
+  for (uint64_t p = 0; p < opts["procs"]; p++) {
+    int64_t pid = spawn("/usr/bin/find", "/data", "");
+    std::string dir = "/data/scan/" + std::to_string(p) + "/file";
+    for (uint64_t f = 0; f < opts["files"]; f++) {
+      int64_t fd = FIRST_FD + f % open;
+      if (f >= open) {
+        closeFd(pid, fd);
+      }
+      openFile(pid, fd, dir + std::to_string(f));
+      readFd(pid, fd, 4096);
+    }
+    for (uint64_t f = 0; f < std::min(open, opts["files"]); f++) {
+      closeFd(pid, FIRST_FD + f);
+    }
+    exit(pid);
+  }
+}
+
+// a jvm whose threads repeatedly map the same set of jar files
+void Workloads::jvm(WorkloadOptions &opts) {
+  const std::string exe = "/usr/bin/java";
+  int64_t pid = spawn(exe, "/opt/app/app.jar", "");
+  uint64_t jars = std::max<uint64_t>(opts["jars"], 1);
+  for (uint64_t j = 0; j < jars; j++) {
+    openFile(pid, FIRST_FD + j,
+             "/opt/app/lib/lib" + std::to_string(j) + ".jar");
+  }
+  std::vector<int64_t> threads{pid};
+  for (uint64_t t = 0; t < opts["threads"]; t++) {
+    threads.push_back(spawnThread(pid, exe, ""));
+  }
+  for (uint64_t m = 0; m < opts["maps"]; m++) {
+    int64_t tid = threads[m_rng() % threads.size()];
+    mmap(tid, FIRST_FD + m_rng() % jars, 1 << 20);
+  }
+  for (std::size_t t = 1; t < threads.size(); t++) {
+    exit(threads[t]);
+  }
+  exit(pid);
+}
+
+// short-lived containers, each running a few processes that read some files
+// and call a service before exiting
+void Workloads::containerChurn(WorkloadOptions &opts) {
+  uint32_t svc = ipv4(10, 96, 0, 10);
+  uint32_t local = ipv4(172, 17, 0, 2);
+  uint64_t conn = 0;
+  for (uint64_t c = 0; c < opts["count"]; c++) {
+    std::string containerId = newContainer();
+    for (uint64_t p = 0; p < opts["procs"]; p++) {
+      int64_t pid = spawn("/usr/bin/python3", "/app/main.py", containerId);
+      for (uint64_t f = 0; f < opts["files"]; f++) {
+        openFile(pid, FIRST_FD, "/app/data/" + std::to_string(f) + ".json");
+        readFd(pid, FIRST_FD, 1024);
+        closeFd(pid, FIRST_FD);
+      }
+      for (uint64_t n = 0; n < opts["conns"]; n++) {
+        connect(pid, FIRST_FD, local, 32768 + conn++ % (MAX_PORTS / 2), svc,
+                443);
+        sendRecv(pid, FIRST_FD, 256);
+        closeFd(pid, FIRST_FD);
+      }
+      exit(pid);
+    }
+  }
+}
+
+void Workloads::run(const std::string &spec) {
+  std::size_t colon = spec.find(':');
+  std::string name = spec.substr(0, colon);
+  WorkloadOptions opts;
+  void (Workloads::*workload)(WorkloadOptions &) = nullptr;
+  if (name == "forkstorm") {
+    opts = {{"procs", 10000}, {"exit", 1}};
+    workload = &Workloads::forkStorm;
+  } else if (name == "server") {
+    opts = {{"conns", 100000}, {"open", 10000}, {"port", 8080}, {"bytes", 512}};
+    workload = &Workloads::server;
+  } else if (name == "filescan") {
+    opts = {{"procs", 1}, {"files", 100000}, {"open", 10000}};
+    workload = &Workloads::fileScan;
+  } else if (name == "jvm") {
+    opts = {{"threads", 200}, {"jars", 100}, {"maps", 100000}};
+    workload = &Workloads::jvm;
+  } else if (name == "containers") {
+    opts = {{"count", 100}, {"procs", 5}, {"files", 10}, {"conns", 1}};
+    workload = &Workloads::containerChurn;
+  } else {
+    throw std::runtime_error("Unknown workload '" + name + "'");
+  }
+
+  if (colon != std::string::npos) {
+    std::istringstream options(spec.substr(colon + 1));
+    std::string opt;
+    while (std::getline(options, opt, ',')) {
+      std::size_t eq = opt.find('=');
+      std::string key = opt.substr(0, eq);
+      if (eq == std::string::npos || opts.find(key) == opts.end()) {
+        throw std::runtime_error("Invalid option '" + opt +
+                                 "' for workload '" + name + "'");
+      }
+      opts[key] = std::stoull(opt.substr(eq + 1));
+    }
+  }
+
+  uint64_t start = m_writer->getNumEvents();
+  (this->*workload)(opts);
+  std::cout << "Workload " << spec << ": "
+            << m_writer->getNumEvents() - start << " events" << std::endl;
+}
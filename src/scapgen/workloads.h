@@ -0,0 +1,73 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#ifndef _SF_SCAP_WORKLOADS_
+#define _SF_SCAP_WORKLOADS_
+#include "scapwriter.h"
+#include <map>
+#include <random>
+#include <string>
+
+namespace scapgen {
+
+// Workload options parsed from "name:key=value,key=value".
+typedef std::map<std::string, uint64_t> WorkloadOptions;
+
+// Emits syscall sequences that mimic common high-volume workloads. Every
+// workload starts its processes from a fresh pid range, so workloads can be
+// chained in a single trace.
+class Workloads {
+private:
+  ScapWriter *m_writer;
+  std::mt19937_64 m_rng;
+  int64_t m_nextPid;
+  int64_t m_shellPid;
+  int64_t allocPid() { return m_nextPid++; }
+  std::string newContainer();
+  void clone(int64_t tid, int64_t pid, int64_t ptid, int64_t res,
+             const std::string &exe, const std::string &containerId,
+             uint32_t flags);
+  int64_t spawn(const std::string &exe, const std::string &args,
+                const std::string &containerId);
+  int64_t spawnThread(int64_t pid, const std::string &exe,
+                      const std::string &containerId);
+  void exit(int64_t tid);
+  void openFile(int64_t tid, int64_t fd, const std::string &path);
+  void readFd(int64_t tid, int64_t fd, uint64_t size);
+  void closeFd(int64_t tid, int64_t fd);
+  void accept(int64_t tid, int64_t fd, uint32_t cip, uint16_t cport,
+              uint32_t sip, uint16_t sport);
+  void connect(int64_t tid, int64_t fd, uint32_t sip, uint16_t sport,
+               uint32_t dip, uint16_t dport);
+  void sendRecv(int64_t tid, int64_t fd, uint64_t size);
+  void mmap(int64_t tid, int64_t fd, uint64_t length);
+  void forkStorm(WorkloadOptions &opts);
+  void server(WorkloadOptions &opts);
+  void fileScan(WorkloadOptions &opts);
+  void jvm(WorkloadOptions &opts);
+  void containerChurn(WorkloadOptions &opts);
+
+public:
+  Workloads(ScapWriter *writer, uint64_t seed, int64_t firstPid);
+  virtual ~Workloads();
+  void run(const std::string &spec);
+};
+} // namespace scapgen
+
+#endif
@@ -0,0 +1,310 @@
+/** Copyright (C) 2024 IBM Corporation.
+ *
+ * Authors:
+ * Frederico Araujo <frederico.araujo@ibm.com>
+ * Teryl Taylor <terylt@ibm.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+#include "datatypes.h"
+#include "sfbench.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Microbenchmarks for the hashers and hash table backends used by the
+// collector caches, over the key types of the process, network flow and file
+// tables. Each operation is timed over all keys, and the best run out of the
+// repetitions is reported in ns per operation. The churn benchmark keeps a
+// window of live keys while inserting and erasing, as flows and processes
+// come and go, and compares lookup misses on the churned table with a fresh
+// table of the same size, which shows the cost of dense_hash_map tombstones.
+
+#define DEFAULT_NUM_KEYS 1000000
+#define DEFAULT_REPETITIONS 5
+// fraction of the keys that are live at a time in the churn benchmark
+#define CHURN_WINDOW_DIV 10
+
+namespace {
+template <typename T> inline void doNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Result {
+  std::string key;
+  std::string backend;
+  std::size_t keySize;
+  double hashNs;
+  double insertNs;
+  double findNs;
+  double missNs;
+  double eraseNs;
+};
+
+struct ChurnResult {
+  std::string key;
+  std::string backend;
+  std::size_t live;
+  double churnNs;
+  double freshMissNs;
+  double churnedMissNs;
+  std::size_t freshBuckets;
+  std::size_t churnedBuckets;
+};
+
+double nsPerOp(uint64_t start, std::size_t ops) {
+  return static_cast<double>(sfbench::getTimeNs() - start) / ops;
+}
+
+template <typename Table, typename K>
+double missNs(Table &table, const std::vector<K> &misses) {
+  uint64_t start = sfbench::getTimeNs();
+  for (const K &k : misses) {
+    doNotOptimize(table.find(k) == table.end());
+  }
+  return nsPerOp(start, misses.size());
+}
+
+template <typename Table, typename K>
+Result bench(const std::string &name, const std::string &backend,
+             std::size_t keySize, const std::vector<K> &keys,
+             const std::vector<K> &misses, const K &emptyKey, const K &delKey,
+             int reps) {
+  Result r{name, backend, keySize, 1e12, 1e12, 1e12, 1e12, 1e12};
+  typename Table::hasher hasher;
+  for (int i = 0; i < reps; i++) {
+    uint64_t start = sfbench::getTimeNs();
+    for (const K &k : keys) {
+      doNotOptimize(hasher(k));
+    }
+    r.hashNs = std::min(r.hashNs, nsPerOp(start, keys.size()));
+
+    Table table;
+    table.set_empty_key(emptyKey);
+    table.set_deleted_key(delKey);
+    start = sfbench::getTimeNs();
+    for (std::size_t j = 0; j < keys.size(); j++) {
+      table.insert(std::make_pair(keys[j], j));
+    }
+    r.insertNs = std::min(r.insertNs, nsPerOp(start, keys.size()));
+
+    start = sfbench::getTimeNs();
+    for (const K &k : keys) {
+      doNotOptimize(table.find(k)->second);
+    }
+    r.findNs = std::min(r.findNs, nsPerOp(start, keys.size()));
+    r.missNs = std::min(r.missNs, missNs(table, misses));
+
+    start = sfbench::getTimeNs();
+    for (const K &k : keys) {
+      table.erase(k);
+    }
+    r.eraseNs = std::min(r.eraseNs, nsPerOp(start, keys.size()));
+  }
+  return r;
+}
+
+template <typename Table, typename K>
+ChurnResult churn(const std::string &name, const std::string &backend,
+                  const std::vector<K> &keys, const std::vector<K> &misses,
+                  const K &emptyKey, const K &delKey, int reps) {
+  std::size_t live = std::max<std::size_t>(keys.size() / CHURN_WINDOW_DIV, 1);
+  ChurnResult r{name, backend, live, 1e12, 1e12, 1e12, 0, 0};
+  for (int i = 0; i < reps; i++) {
+    Table fresh;
+    fresh.set_empty_key(emptyKey);
+    fresh.set_deleted_key(delKey);
+    for (std::size_t j = keys.size() - live; j < keys.size(); j++) {
+      fresh.insert(std::make_pair(keys[j], j));
+    }
+    r.freshMissNs = std::min(r.freshMissNs, missNs(fresh, misses));
+    r.freshBuckets = fresh.bucket_count();
+
+    Table table;
+    table.set_empty_key(emptyKey);
+    table.set_deleted_key(delKey);
+    for (std::size_t j = 0; j < live; j++) {
+      table.insert(std::make_pair(keys[j], j));
+    }
+    uint64_t start = sfbench::getTimeNs();
+    for (std::size_t j = live; j < keys.size(); j++) {
+      table.insert(std::make_pair(keys[j], j));
+      table.erase(keys[j - live]);
+    }
+    r.churnNs = std::min(r.churnNs, nsPerOp(start, keys.size() - live));
+    // both tables now hold the same keys
+    r.churnedMissNs = std::min(r.churnedMissNs, missNs(table, misses));
+    r.churnedBuckets = table.bucket_count();
+  }
+  return r;
+}
+
+template <typename K, typename Hash, typename Eq>
+void benchKey(const std::string &name, std::size_t keySize,
+              const std::vector<K> &keys, const std::vector<K> &misses,
+              const K &emptyKey, const K &delKey, int reps,
+              std::vector<Result> &results,
+              std::vector<ChurnResult> &churns) {
+  typedef google::dense_hash_map<K, uint64_t, Hash, Eq> DenseTable;
+  typedef sftable::FlatMap<K, uint64_t, Hash, Eq> FlatTable;
+  results.push_back(bench<DenseTable>(name, "dense", keySize, keys, misses,
+                                      emptyKey, delKey, reps));
+  results.push_back(bench<FlatTable>(name, "flat", keySize, keys, misses,
+                                     emptyKey, delKey, reps));
+  churns.push_back(
+      churn<DenseTable>(name, "dense", keys, misses, emptyKey, delKey, reps));
+  churns.push_back(
+      churn<FlatTable>(name, "flat", keys, misses, emptyKey, delKey, reps));
+}
+
+std::vector<NFKey> nfKeys(std::mt19937_64 &rng, std::size_t n) {
+  std::vector<NFKey> keys(n);
+  for (NFKey &k : keys) {
+    k.tid = 1 + rng() % 4194304;
+    k.ip1 = rng();
+    k.ip2 = rng();
+    k.fd = rng() % 65536;
+    k.port1 = rng();
+    k.port2 = rng();
+  }
+  return keys;
+}
+
+std::vector<OID> oids(std::mt19937_64 &rng, std::size_t n) {
+  std::vector<OID> keys(n);
+  for (OID &k : keys) {
+    k.hpid = 3 + rng() % 4194304;
+    k.createTS = 1700000000000000000LL + rng() % 1000000000000LL;
+  }
+  return keys;
+}
+
+std::vector<std::string> paths(std::mt19937_64 &rng, std::size_t n) {
+  std::vector<std::string> keys(n);
+  for (std::string &k : keys) {
+    std::ostringstream path;
+    path << "/usr/lib/x86_64-linux-gnu/lib" << std::hex << rng() << ".so.1";
+    k = path.str();
+  }
+  return keys;
+}
+
+void usage(const std::string &name) {
+  std::cerr << "Usage: " << name << " [options]\n"
+            << "Options:\n"
+            << "\t-h\t\t\tShow this help message and exit\n"
+            << "\t-n keys\t\t\tNumber of keys per table (default: "
+            << DEFAULT_NUM_KEYS << ")\n"
+            << "\t-r repetitions\t\tRuns per benchmark, the best is reported "
+               "(default: "
+            << DEFAULT_REPETITIONS << ")\n"
+            << "\t-s seed\t\t\tSeed for the generated keys (default: 1)\n"
+            << std::endl;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t numKeys = DEFAULT_NUM_KEYS;
+  int reps = DEFAULT_REPETITIONS;
+  uint64_t seed = 1;
+  int c;
+  while ((c = getopt(argc, argv, "hn:r:s:")) != -1) {
+    switch (c) {
+    case 'n':
+      numKeys = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'r':
+      reps = std::atoi(optarg);
+      break;
+    case 's':
+      seed = std::strtoull(optarg, nullptr, 10);
+      break;
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (numKeys == 0 || reps <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::mt19937_64 rng(seed);
+  std::vector<Result> results;
+  std::vector<ChurnResult> churns;
+
+  std::vector<NFKey> nfkeys = nfKeys(rng, numKeys);
+  std::vector<NFKey> nfmisses = nfKeys(rng, numKeys);
+  benchKey<NFKey, XXHasher<NFKey>, eqnfkey>(
+      "NFKey", sizeof(NFKey), nfkeys, nfmisses, *utils::getNFEmptyKey(),
+      *utils::getNFDelKey(), reps, results, churns);
+
+  std::vector<OID> oidkeys = oids(rng, numKeys);
+  std::vector<OID> oidmisses = oids(rng, numKeys);
+  benchKey<OID, XXHasher<OID>, eqoid>(
+      "OID", sizeof(OID), oidkeys, oidmisses, *utils::getOIDEmptyKey(),
+      *utils::getOIDDelKey(), reps, results, churns);
+
+  std::vector<OID *> oidptrs;
+  std::vector<OID *> oidptrmisses;
+  for (std::size_t i = 0; i < numKeys; i++) {
+    oidptrs.push_back(&oidkeys[i]);
+    oidptrmisses.push_back(&oidmisses[i]);
+  }
+  benchKey<OID *, XXHasher<OID *>, eqoidptr>(
+      "OID*", sizeof(OID), oidptrs, oidptrmisses, utils::getOIDEmptyKey(),
+      utils::getOIDDelKey(), reps, results, churns);
+
+  std::vector<std::string> strkeys = paths(rng, numKeys);
+  std::vector<std::string> strmisses = paths(rng, numKeys);
+  benchKey<std::string, XXHasher<std::string>, eqstr>(
+      "string", strkeys[0].size(), strkeys, strmisses, std::string("-1"),
+      std::string("-2"), reps, results, churns);
+
+  std::cout << "{\n  \"keys\": " << numKeys << ",\n  \"repetitions\": " << reps
+            << ",\n  \"tables\": [\n";
+  for (std::size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    std::cout << "    {\"key\": \"" << r.key << "\", \"backend\": \""
+              << r.backend << "\", \"key_bytes\": " << r.keySize
+              << ", \"hash_ns\": " << r.hashNs
+              << ", \"insert_ns\": " << r.insertNs
+              << ", \"find_ns\": " << r.findNs
+              << ", \"miss_ns\": " << r.missNs
+              << ", \"erase_ns\": " << r.eraseNs << "}"
+              << ((i + 1 < results.size()) ? ",\n" : "\n");
+  }
+  std::cout << "  ],\n  \"churn\": [\n";
+  for (std::size_t i = 0; i < churns.size(); i++) {
+    const ChurnResult &r = churns[i];
+    std::cout << "    {\"key\": \"" << r.key << "\", \"backend\": \""
+              << r.backend << "\", \"live\": " << r.live
+              << ", \"churn_ns\": " << r.churnNs
+              << ", \"fresh_miss_ns\": " << r.freshMissNs
+              << ", \"churned_miss_ns\": " << r.churnedMissNs
+              << ", \"fresh_buckets\": " << r.freshBuckets
+              << ", \"churned_buckets\": " << r.churnedBuckets << "}"
+              << ((i + 1 < churns.size()) ? ",\n" : "\n");
+  }
+  std::cout << "  ]\n}" << std::endl;
+  return 0;
+}
@@ -0,0 +1,105 @@
+#!/bin/bash
+#
+# Copyright (C) 2024 IBM Corporation.
+#
+# Authors:
+# Frederico Araujo <frederico.araujo@ibm.com>
+# Teryl Taylor <terylt@ibm.com>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Replays scap traces through sysporter (built with BENCH=1) and prints a JSON
+# summary with the median of each metric over ITERATIONS runs per trace.
+#
+# Usage: WDIR=<sysflow root> tests/bench.sh [trace.scap ...]
+# Env:   ITERATIONS (default 5), BENCH_OUT (default /tmp/sfbench),
+#        PERF_STAT=1 to also report hardware counters from perf stat
+
+WDIR="${WDIR:-$(cd "$(dirname "$0")/.." && pwd)}"
+TDIR="${WDIR}/tests"
+sysporter="${SYSPORTER:-${WDIR}/bin/sysporter}"
+iterations=${ITERATIONS:-5}
+out="${BENCH_OUT:-/tmp/sfbench}"
+perfEvents=cache-references,cache-misses,instructions,cycles
+
+if [ ! -x "$sysporter" ]; then
+  echo "sysporter not found at $sysporter" >&2
+  exit 1
+fi
+
+traces=("$@")
+if [ ${#traces[@]} -eq 0 ]; then
+  mapfile -t traces < <(find "$TDIR" -name '*.scap' | sort)
+fi
+
+mkdir -p "$out"
+reports=()
+for trace in "${traces[@]}"; do
+  name="$(basename "$trace" .scap)"
+  for i in $(seq 1 "$iterations"); do
+    report="${out}/${name}.${i}.json"
+    perf=()
+    if [ "${PERF_STAT:-0}" = "1" ]; then
+      perf=(perf stat -x, -e "$perfEvents" -o "${out}/${name}.${i}.perf")
+    fi
+    if ! "${perf[@]}" "$sysporter" -r "$trace" -w "${out}/${name}.sf" -e bench -j "$report" \
+      >"${out}/${name}.log" 2>&1; then
+      echo "sysporter failed on $trace (see ${out}/${name}.log)" >&2
+      exit 1
+    fi
+    reports+=("$report")
+  done
+done
+
+python3 - "${reports[@]}" <<'EOF'
+import json
+import os
+import statistics
+import sys
+
+
+def perf_counters(path):
+    counters = {}
+    if not os.path.exists(path):
+        return counters
+    with open(path) as f:
+        for line in f:
+            fields = line.strip().split(',')
+            if len(fields) > 2 and fields[0].isdigit():
+                counters[fields[2].replace('-', '_')] = int(fields[0])
+    return counters
+
+
+runs = {}
+for path in sys.argv[1:]:
+    with open(path) as f:
+        r = json.load(f)
+    r['perf'] = perf_counters(path[:-len('.json')] + '.perf')
+    runs.setdefault(r['trace'], []).append(r)
+
+metrics = ['events_per_sec', 'records_per_sec', 'peak_rss_kb',
+           'allocs_per_event', 'wall_sec']
+summary = []
+for trace, rs in runs.items():
+    s = {'trace': trace, 'iterations': len(rs),
+         'events': rs[0]['events'], 'records': rs[0]['records']}
+    for m in metrics:
+        s[m] = statistics.median(r[m] for r in rs)
+    s['stage_share'] = {k: statistics.median(r['stage_share'][k] for r in rs)
+                        for k in rs[0]['stage_share']}
+    if rs[0]['perf']:
+        s['perf'] = {k: statistics.median(r['perf'].get(k, 0) for r in rs)
+                     for k in rs[0]['perf']}
+    summary.append(s)
+print(json.dumps({'traces': summary}, indent=2))
+EOF
@@ -0,0 +1,161 @@
+#!/usr/bin/env bats
+#
+# Copyright (C) 2024 IBM Corporation.
+#
+# Authors:
+# Frederico Araujo <frederico.araujo@ibm.com>
+# Teryl Taylor <terylt@ibm.com>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Replays traces with each optional feature off and on, and checks the
+# record counts of the SysFlow and summary files. Synthetic traces are
+# generated with scapgen (SCAPGEN, skipped when not built).
+
+TDIR=${WDIR}/tests
+sfcount=${TDIR}/sfcount.py
+sysporter=${WDIR}/bin/sysporter
+scapgen=${SCAPGEN:-${WDIR}/src/scapgen/scapgen}
+template=${TDIR}/mpm-preforked/full_capture.scap
+exporter=tests
+out=/tmp/sffeatures
+
+setup() {
+  mkdir -p ${out}
+}
+
+# generates the synthetic trace <name>.scap with the given scapgen options
+gentrace() {
+  name=$1
+  shift
+  if [ ! -x "${scapgen}" ]; then
+    skip "scapgen not found at ${scapgen}"
+  fi
+  if [ ! -f ${out}/${name}.scap ]; then
+    ${scapgen} -t ${template} -w ${out}/${name}.scap "$@" > /dev/null
+  fi
+}
+
+# replays a trace into <run>.sf and <run>.summary with the given options
+replay() {
+  trace=$1
+  run=$2
+  shift 2
+  rm -f ${out}/${run}.sf ${out}/${run}.summary
+  $sysporter -r ${trace} -w ${out}/${run}.sf -S ${out}/${run}.summary \
+    -e $exporter "$@" > ${out}/${run}.log 2>&1
+}
+
+# number of SysFlow records of a run, of the given type (or of all types)
+records() {
+  $sfcount ${out}/$1.sf $2
+}
+
+# number of summary records of a run, of the given type, or the sum of the
+# given member over them
+summaries() {
+  $sfcount -s ${out}/$1.summary $2 $3
+}
+
+@test "Drop filter removes the file flows of a dropped exe" {
+  gentrace filescan filescan:files=500,open=10
+  echo "exe /usr/bin/find" > ${out}/drop.rules
+  replay ${out}/filescan.scap drop-off
+  replay ${out}/filescan.scap drop-on -x ${out}/drop.rules
+  [ $(records drop-off FileFlow) -gt 0 ]
+  [ $(records drop-on FileFlow) -lt $(records drop-off FileFlow) ]
+}
+
+@test "Process flow aggregation merges the connections of a client" {
+  gentrace server server:conns=2000,open=10
+  replay ${out}/server.scap aggr-off
+  replay ${out}/server.scap aggr-on -a process
+  [ $(records aggr-on NetworkFlow) -gt 0 ]
+  [ $(records aggr-on NetworkFlow) -lt $(records aggr-off NetworkFlow) ]
+}
+
+@test "Connection summaries fold completed network flows" {
+  gentrace server server:conns=2000,open=10
+  replay ${out}/server.scap summary-off
+  replay ${out}/server.scap summary-on -N 1000
+  [ $(records summary-on NetworkFlow) -lt $(records summary-off NetworkFlow) ]
+  [ $(summaries summary-off ConnectionSummary) -eq 0 ]
+  [ $(summaries summary-on ConnectionSummary) -gt 0 ]
+  [ $(summaries summary-on ConnectionSummary connections) -gt $(summaries summary-on ConnectionSummary) ]
+}
+
+@test "File flow coalescing merges completed file flows" {
+  trace=${TDIR}/mpm-preforked/cold_start_capture.scap
+  replay ${trace} coalesce-off
+  replay ${trace} coalesce-on -F 100
+  [ $(records coalesce-on FileFlow) -le $(records coalesce-off FileFlow) ]
+  [ $(summaries coalesce-off CoalescedFileFlow) -eq 0 ]
+  [ $(summaries coalesce-on CoalescedFileFlow) -gt 0 ]
+  [ $(summaries coalesce-on CoalescedFileFlow flows) -ge $(summaries coalesce-on CoalescedFileFlow) ]
+}
+
+@test "Mmap deduplication counts repeated maps" {
+  gentrace jvm jvm:threads=10,jars=5,maps=1000
+  replay ${out}/jvm.scap mmap-off
+  replay ${out}/jvm.scap mmap-on -I
+  [ $(records mmap-on FileFlow) -lt $(records mmap-off FileFlow) ]
+  [ $(summaries mmap-off ProcessCounts mmaps) -eq 0 ]
+  [ $(summaries mmap-on ProcessCounts mmaps) -gt 0 ]
+}
+
+@test "Fork storm summarization folds the events of children" {
+  gentrace forkstorm forkstorm:procs=2000
+  replay ${out}/forkstorm.scap fork-off
+  replay ${out}/forkstorm.scap fork-on -C 100
+  [ $(records fork-on ProcessEvent) -lt $(records fork-off ProcessEvent) ]
+  [ $(summaries fork-off ForkSummary) -eq 0 ]
+  [ $(summaries fork-on ForkSummary) -gt 0 ]
+  [ $(summaries fork-on ForkSummary clones) -gt 0 ]
+}
+
+@test "Export policies skip idle flow intervals" {
+  # one event per second, so that connections stay open over many intervals
+  gentrace slowserver -i 1000000000 server:conns=50,open=50
+  replay ${out}/slowserver.scap export-off -E export=1,expire=3600
+  replay ${out}/slowserver.scap export-on -E net=suppress,export=1,expire=3600
+  [ $(records export-on NetworkFlow) -gt 0 ]
+  [ $(records export-on NetworkFlow) -lt $(records export-off NetworkFlow) ]
+}
+
+@test "Container rollups only add summary records" {
+  gentrace containers containers:count=5
+  replay ${out}/containers.scap rollup-off
+  replay ${out}/containers.scap rollup-on -R
+  [ $(records rollup-on) -eq $(records rollup-off) ]
+  [ $(summaries rollup-off ContainerRollup) -eq 0 ]
+  [ $(summaries rollup-on ContainerRollup) -gt 0 ]
+}
+
+@test "Heavy hitters and fan-out estimates only add summary records" {
+  gentrace containers containers:count=5
+  replay ${out}/containers.scap sketch-off
+  replay ${out}/containers.scap sketch-on -H 10,records -Y
+  [ $(records sketch-on) -eq $(records sketch-off) ]
+  [ $(summaries sketch-off) -eq 0 ]
+  [ $(summaries sketch-on HeavyHitters) -gt 0 ]
+  [ $(summaries sketch-on ProcessFanOut) -gt 0 ]
+}
+
+@test "Rate limiting suppresses data events but keeps flows" {
+  gentrace server server:conns=2000,open=10
+  replay ${out}/server.scap limit-off
+  replay ${out}/server.scap limit-on -L 10
+  [ $(records limit-on NetworkFlow) -eq $(records limit-off NetworkFlow) ]
+  [ $(summaries limit-off ProcessCounts suppressed) -eq 0 ]
+  [ $(summaries limit-on ProcessCounts suppressed) -gt 0 ]
+}
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2024 IBM Corporation.
+#
+# Authors:
+# Frederico Araujo <frederico.araujo@ibm.com>
+# Teryl Taylor <terylt@ibm.com>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Prints the number of records of a SysFlow file, or of a summary file (-s),
+# of the given type (all records without a type). For summary records, a
+# member name sums the member over the records instead.
+#
+# Usage: sfcount.py <file.sf> [type]
+#        sfcount.py -s <file.summary> [type [member]]
+
+import json
+import os
+import sys
+
+
+def recordType(rec):
+    # record classes are generated from the schema, e.g., NetworkFlowClass
+    name = type(rec).__name__
+    return name[:-len('Class')] if name.endswith('Class') else name
+
+
+def countSysFlow(path, rtype):
+    from sysflow.reader import SFReader
+    count = 0
+    for tup in SFReader(path):
+        if rtype is None or recordType(tup[1]) == rtype:
+            count += 1
+    return count
+
+
+def countSummary(path, rtype, member):
+    # summary files are only created with their first record
+    if not os.path.exists(path):
+        return 0
+    count = 0
+    with open(path) as f:
+        for line in f:
+            rec = json.loads(line)
+            if rtype is not None and rec['type'] != rtype:
+                continue
+            count += rec.get(member, 0) if member else 1
+    return count
+
+
+args = sys.argv[1:]
+if len(args) > 0 and args[0] == '-s':
+    if len(args) < 2:
+        sys.exit('usage: sfcount.py -s <file.summary> [type [member]]')
+    print(countSummary(args[1], args[2] if len(args) > 2 else None,
+                       args[3] if len(args) > 3 else None))
+elif len(args) > 0:
+    print(countSysFlow(args[0], args[1] if len(args) > 1 else None))
+else:
+    sys.exit('usage: sfcount.py <file.sf> [type]')